@@ -0,0 +1,310 @@
+/*
+ * B+tree of address ranges
+ *
+ * Nodes are never merged or rebalanced on removal: an entry is simply
+ * taken out of its leaf, and a node is unlinked from the tree once it
+ * has nothing left in it.  The separator keys in the internal nodes
+ * stay valid for routing, since removing entries never moves the
+ * remaining ones to another leaf.  The driver removes every range it
+ * inserts, so the tree shrinks back to a single leaf at the end of a
+ * trace.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include "btree.h"
+
+/* Nodes in each chunk of the node pool */
+#define BT_POOL_NODES 256
+
+/* Deeper than any tree of BT_FANOUT-way nodes that fits in memory */
+#define BT_MAX_DEPTH 32
+
+struct bpool {
+    struct bpool *next;
+    bnode_t nodes[BT_POOL_NODES];
+};
+
+static bnode_t *node_alloc(btree_t *tree, bool leaf);
+static void node_release(btree_t *tree, bnode_t *node);
+static int child_index(const bnode_t *node, bkey_t key);
+static int leaf_position(const bnode_t *leaf, bkey_t key, bool after);
+
+btree_t *btree_new() {
+    btree_t *tree = malloc(sizeof(btree_t));
+    if (!tree) {
+        fprintf(stderr, "ERROR.  Couldn't create range tree\n");
+        exit(1);
+    }
+    tree->free_nodes = NULL;
+    tree->pools = NULL;
+    tree->count = 0;
+    tree->root = node_alloc(tree, true);
+    tree->head = tree->root;
+    return tree;
+}
+
+void btree_free(btree_t *tree) {
+    bpool_t *pool = tree->pools;
+    while (pool) {
+        bpool_t *next = pool->next;
+        free(pool);
+        pool = next;
+    }
+    free(tree);
+}
+
+bool btree_insert(btree_t *tree, const bentry_t *entry) {
+    bnode_t *path[BT_MAX_DEPTH];
+    int slot[BT_MAX_DEPTH];
+    int depth = 0;
+    bkey_t key = entry->key;
+
+    /* Find the leaf, remembering the way down */
+    bnode_t *n = tree->root;
+    while (!n->leaf) {
+        int i = child_index(n, key);
+        path[depth] = n;
+        slot[depth] = i;
+        depth++;
+        n = n->in.children[i];
+    }
+    int pos = leaf_position(n, key, false);
+    if (pos < n->count && n->l.entries[pos].key == key)
+        /* Already have key in tree */
+        return false;
+    tree->count++;
+
+    if (n->count < BT_LEAF_CAP) {
+        memmove(&n->l.entries[pos + 1], &n->l.entries[pos],
+                (n->count - pos) * sizeof(bentry_t));
+        n->l.entries[pos] = *entry;
+        n->count++;
+        return true;
+    }
+
+    /* Split the leaf in half and put the entry in the correct half */
+    int half = BT_LEAF_CAP / 2;
+    bnode_t *right = node_alloc(tree, true);
+    memcpy(right->l.entries, &n->l.entries[half], (BT_LEAF_CAP - half) * sizeof(bentry_t));
+    right->count = BT_LEAF_CAP - half;
+    n->count = half;
+    right->l.next = n->l.next;
+    if (right->l.next)
+        right->l.next->l.prev = right;
+    right->l.prev = n;
+    n->l.next = right;
+
+    bnode_t *target = (pos <= half) ? n : right;
+    if (target == right)
+        pos -= half;
+    memmove(&target->l.entries[pos + 1], &target->l.entries[pos],
+            (target->count - pos) * sizeof(bentry_t));
+    target->l.entries[pos] = *entry;
+    target->count++;
+
+    /* Add the new node to its parent, splitting parents as needed */
+    bkey_t sep = right->l.entries[0].key;
+    bnode_t *child = right;
+    while (depth > 0) {
+        depth--;
+        bnode_t *p = path[depth];
+        int i = slot[depth];
+
+        if (p->count < BT_FANOUT) {
+            memmove(&p->in.keys[i + 1], &p->in.keys[i], (p->count - 1 - i) * sizeof(bkey_t));
+            memmove(&p->in.children[i + 2], &p->in.children[i + 1],
+                    (p->count - 1 - i) * sizeof(bnode_t *));
+            p->in.keys[i] = sep;
+            p->in.children[i + 1] = child;
+            p->count++;
+            return true;
+        }
+
+        /* Lay out the overfull node, then deal it into two */
+        bkey_t keys[BT_FANOUT];
+        bnode_t *kids[BT_FANOUT + 1];
+        memcpy(keys, p->in.keys, i * sizeof(bkey_t));
+        keys[i] = sep;
+        memcpy(&keys[i + 1], &p->in.keys[i], (BT_FANOUT - 1 - i) * sizeof(bkey_t));
+        memcpy(kids, p->in.children, (i + 1) * sizeof(bnode_t *));
+        kids[i + 1] = child;
+        memcpy(&kids[i + 2], &p->in.children[i + 1], (BT_FANOUT - 1 - i) * sizeof(bnode_t *));
+
+        int left_kids = (BT_FANOUT + 1) / 2;
+        bnode_t *q = node_alloc(tree, false);
+        memcpy(p->in.keys, keys, (left_kids - 1) * sizeof(bkey_t));
+        memcpy(p->in.children, kids, left_kids * sizeof(bnode_t *));
+        p->count = left_kids;
+        q->count = BT_FANOUT + 1 - left_kids;
+        memcpy(q->in.keys, &keys[left_kids], (q->count - 1) * sizeof(bkey_t));
+        memcpy(q->in.children, &kids[left_kids], q->count * sizeof(bnode_t *));
+
+        sep = keys[left_kids - 1];
+        child = q;
+    }
+
+    /* The root split: grow the tree by a level */
+    bnode_t *root = node_alloc(tree, false);
+    root->count = 2;
+    root->in.keys[0] = sep;
+    root->in.children[0] = tree->root;
+    root->in.children[1] = child;
+    tree->root = root;
+    return true;
+}
+
+bool btree_remove(btree_t *tree, bkey_t key, bentry_t *entry) {
+    bnode_t *path[BT_MAX_DEPTH];
+    int slot[BT_MAX_DEPTH];
+    int depth = 0;
+
+    bnode_t *n = tree->root;
+    while (!n->leaf) {
+        int i = child_index(n, key);
+        path[depth] = n;
+        slot[depth] = i;
+        depth++;
+        n = n->in.children[i];
+    }
+    int pos = leaf_position(n, key, false);
+    if (pos >= n->count || n->l.entries[pos].key != key)
+        return false;
+
+    if (entry)
+        *entry = n->l.entries[pos];
+    memmove(&n->l.entries[pos], &n->l.entries[pos + 1],
+            (n->count - pos - 1) * sizeof(bentry_t));
+    n->count--;
+    tree->count--;
+    if (n->count > 0 || n == tree->root)
+        return true;
+
+    /* Unlink the empty leaf, and any parents it leaves empty */
+    if (n->l.prev)
+        n->l.prev->l.next = n->l.next;
+    else
+        tree->head = n->l.next;
+    if (n->l.next)
+        n->l.next->l.prev = n->l.prev;
+    node_release(tree, n);
+
+    while (depth > 0) {
+        depth--;
+        bnode_t *p = path[depth];
+        int i = slot[depth];
+        int k = (i > 0) ? i - 1 : 0;
+
+        if (p->count > 1)
+            memmove(&p->in.keys[k], &p->in.keys[k + 1], (p->count - 2 - k) * sizeof(bkey_t));
+        memmove(&p->in.children[i], &p->in.children[i + 1],
+                (p->count - 1 - i) * sizeof(bnode_t *));
+        p->count--;
+        if (p->count > 0)
+            break;
+        node_release(tree, p);
+    }
+
+    /* A root with a single child is replaced by the child */
+    while (!tree->root->leaf && tree->root->count == 1) {
+        bnode_t *old = tree->root;
+        tree->root = old->in.children[0];
+        node_release(tree, old);
+    }
+    return true;
+}
+
+void btree_neighbors(btree_t *tree, bkey_t key,
+                     const bentry_t **prev, const bentry_t **next) {
+    bnode_t *n = tree->root;
+    while (!n->leaf)
+        n = n->in.children[child_index(n, key)];
+
+    /* Every leaf but an empty root has entries, so neighbors are at hand */
+    int pos = leaf_position(n, key, true);
+    if (pos < n->count)
+        *next = &n->l.entries[pos];
+    else
+        *next = n->l.next ? &n->l.next->l.entries[0] : NULL;
+    if (pos > 0)
+        *prev = &n->l.entries[pos - 1];
+    else
+        *prev = n->l.prev ? &n->l.prev->l.entries[n->l.prev->count - 1] : NULL;
+}
+
+const bentry_t *btree_first(btree_t *tree, biter_t *it) {
+    it->leaf = tree->head;
+    it->pos = 0;
+    return (it->leaf && it->leaf->count > 0) ? &it->leaf->l.entries[0] : NULL;
+}
+
+const bentry_t *btree_next(biter_t *it) {
+    if (++it->pos >= it->leaf->count) {
+        it->leaf = it->leaf->l.next;
+        it->pos = 0;
+        if (!it->leaf)
+            return NULL;
+    }
+    return &it->leaf->l.entries[it->pos];
+}
+
+/* Take a node from the pool, refilling the pool with a new chunk if empty */
+static bnode_t *node_alloc(btree_t *tree, bool leaf) {
+    if (!tree->free_nodes) {
+        bpool_t *pool = malloc(sizeof(bpool_t));
+        if (!pool) {
+            fprintf(stderr, "ERROR.  Couldn't create range tree node\n");
+            exit(1);
+        }
+        pool->next = tree->pools;
+        tree->pools = pool;
+        for (int i = BT_POOL_NODES - 1; i >= 0; i--)
+            node_release(tree, &pool->nodes[i]);
+    }
+    bnode_t *node = tree->free_nodes;
+    tree->free_nodes = node->in.children[0];
+    node->leaf = leaf;
+    node->count = 0;
+    if (leaf) {
+        node->l.prev = NULL;
+        node->l.next = NULL;
+    }
+    return node;
+}
+
+static void node_release(btree_t *tree, bnode_t *node) {
+    node->in.children[0] = tree->free_nodes;
+    tree->free_nodes = node;
+}
+
+/* Index of the child of an internal node whose keys include key */
+static int child_index(const bnode_t *node, bkey_t key) {
+    int lo = 0, hi = node->count - 1;   /* count - 1 keys */
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (node->in.keys[mid] <= key)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/*
+ * Index of the first entry in a leaf with key >= key, or with key > key
+ * if after is set
+ */
+static int leaf_position(const bnode_t *leaf, bkey_t key, bool after) {
+    int lo = 0, hi = leaf->count;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        bkey_t k = leaf->l.entries[mid].key;
+        if (k < key || (after && k == key))
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
@@ -0,0 +1,73 @@
+/*
+ * B+tree of address ranges, keyed by the low address of each range.
+ *
+ * Used by the driver to find the neighbors of a newly allocated block
+ * and check that it does not overlap them.  Ranges are stored in the
+ * leaves themselves, and nodes come from a pool owned by the tree, so
+ * inserting and removing ranges calls malloc only when the pool runs
+ * dry.  The leaves are linked in key order for walking all ranges.
+ */
+
+typedef unsigned long bkey_t;
+
+/* A range [key, hi] and the trace index of the block it belongs to */
+typedef struct {
+    bkey_t key;
+    bkey_t hi;
+    long index;
+} bentry_t;
+
+/* Entries per leaf and children per internal node */
+#define BT_LEAF_CAP 16
+#define BT_FANOUT 32
+
+typedef struct bnode {
+    bool leaf;
+    int count;              /* entries (leaf) or children (internal node) */
+    union {
+        struct {
+            bentry_t entries[BT_LEAF_CAP];
+            struct bnode *prev, *next;
+        } l;
+        struct {
+            /* children[i] holds keys in [keys[i-1], keys[i]) */
+            bkey_t keys[BT_FANOUT - 1];
+            struct bnode *children[BT_FANOUT];
+        } in;
+    };
+} bnode_t;
+
+typedef struct bpool bpool_t;
+
+typedef struct {
+    bnode_t *root;
+    bnode_t *head;          /* leftmost leaf */
+    size_t count;           /* number of entries */
+    bnode_t *free_nodes;    /* nodes returned to the pool */
+    bpool_t *pools;         /* chunks of nodes owned by the tree */
+} btree_t;
+
+/* Position of an entry, for walking the ranges in order */
+typedef struct {
+    bnode_t *leaf;
+    int pos;
+} biter_t;
+
+btree_t *btree_new();
+
+/* Free the tree and all of its nodes */
+void btree_free(btree_t *tree);
+
+/* Insertion function returns false if already have key in tree */
+bool btree_insert(btree_t *tree, const bentry_t *entry);
+
+/* Remove the entry with the given key, copying it to *entry if found */
+bool btree_remove(btree_t *tree, bkey_t key, bentry_t *entry);
+
+/* Find the entries with the largest key <= key and the smallest key > key */
+void btree_neighbors(btree_t *tree, bkey_t key,
+                     const bentry_t **prev, const bentry_t **next);
+
+/* Walk the entries in key order; both return NULL after the last one */
+const bentry_t *btree_first(btree_t *tree, biter_t *it);
+const bentry_t *btree_next(biter_t *it);
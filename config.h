@@ -55,6 +55,19 @@
   "syn-string.rep", \
   "syn-struct.rep"
 
+/*
+ * The stress-pattern traces from gentrace -p, run instead of the
+ * default ones with mdriver -b ("make bench-traces" regenerates them).
+ */
+#define BENCH_TRACEFILES \
+  "bench-lifo.rep", \
+  "bench-fifo.rep", \
+  "bench-sawtooth.rep", \
+  "bench-prodcons.rep", \
+  "bench-realloc.rep", \
+  "bench-classes.rep", \
+  "bench-frag.rep"
+
 /*
 #define DEFAULT_TRACEFILES \
   "bdd-aa4.rep", \
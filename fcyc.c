@@ -199,6 +199,50 @@ double fsec(test_funct f, void *args)
     return result;  
 }
 
+/* Time reps calls of f, each after an untimed call of prep */
+static double time_prepped(test_funct prep, test_funct f, void *args, long reps)
+{
+    long r;
+    double sec = 0.0;
+    for (r = 0; r < reps; r++) {
+        prep(args);
+        start_timer();
+        f(args);
+        sec += get_timer();
+    }
+    return sec;
+}
+
+double fsec_prep(test_funct prep, test_funct f, void *args)
+{
+    double result;
+    /* Increase reps until get meaningful times */
+    long reps = min_reps;
+    double sec = 0.0;
+    init_min_time();
+    while (sec < min_time) {
+        if (clear_cache)
+            clear();
+        sec = time_prepped(prep, f, args, reps);
+        if (sec < min_time)
+            reps += reps;
+    }
+    init_sampler();
+    do {
+        if (clear_cache)
+            clear();
+        sec = time_prepped(prep, f, args, reps)/reps;
+        if (sec > 0.0)
+            add_sample(sec);
+    } while (!has_converged() && samplecount < maxsamples);
+    result = values[0];
+#if !KEEP_VALS
+    free(values); 
+    values = NULL;
+#endif
+    return result;  
+}
+
 
 /***********************************************************/
 /* Set the various parameters used by measurement routines */
@@ -271,4 +315,3 @@ void set_fcyc_epsilon(double epsilon_arg)
 
 
 
-
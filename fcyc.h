@@ -14,6 +14,10 @@ double fcyc(test_funct f, void* args);
 /* Compute number of cycles used by function f on given set of parameters */
 double fsec(test_funct f, void* args);
 
+/* Compute number of seconds used by function f, calling prep untimed
+   before each call of f so that f can use up the state prep builds */
+double fsec_prep(test_funct prep, test_funct f, void* args);
+
 /***********************************************************/
 /* Set the various parameters used by measurement routines */
 
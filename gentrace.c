@@ -0,0 +1,811 @@
+/*
+ * gentrace.c - Synthetic trace generator for the malloc lab driver
+ *
+ * Generates .rep trace files (see traces/README) from a mixture of
+ * arrays, strings and structs whose sizes follow truncated power-law
+ * distributions, with configurable object lifetimes and realloc
+ * growth.  This is the same recipe the bundled syn-*.rep traces were
+ * made with, but with every knob exposed so that traces of any length
+ * can be produced.
+ *
+ * With -p, the mixture is replaced by one of a family of stress
+ * patterns (LIFO and FIFO churn, sawtooth growth, producer-consumer
+ * queues, realloc doubling, size-class interleaving and fragmentation),
+ * which are what the bench-*.rep traces were made with.
+ *
+ * The header of a trace (num_ids, num_ops, max_alloc) is only known
+ * once the whole trace has been generated, so the generator runs
+ * twice with the same seed: the first pass only computes the header,
+ * the second pass writes the requests.  Only the live objects are
+ * ever held in memory, so arbitrarily long traces can be streamed.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <getopt.h>
+
+/* Default parameters (chosen to resemble the bundled syn-mix trace) */
+#define DEF_OPS        80000
+#define DEF_SEED       361
+#define DEF_ALPHA      1.5
+#define DEF_MIN_SIZE   1
+#define DEF_MAX_SIZE   (1 << 16)
+#define DEF_LIFETIME   1000.0
+#define DEF_GROWTH     2.0
+#define DEF_MAX_GROW   8
+#define DEF_WORKING    1000
+
+/* Element sizes used for arrays and the sizes of typical structs */
+static const size_t elem_sizes[] = {1, 2, 4, 8, 16};
+static const size_t struct_sizes[] = {8, 16, 24, 32, 40, 48, 56, 64, 96, 128};
+#define NELEMS(a) (sizeof(a) / sizeof((a)[0]))
+
+/* Kinds of objects in the mixture */
+typedef enum { ARRAY, STRING, STRUCT, NKINDS } kind_t;
+
+/* Lifetime distributions, measured in number of allocations */
+typedef enum { LIFE_EXP, LIFE_PARETO, LIFE_UNIFORM } life_t;
+
+/* Access patterns: the mixture, or one of the stress patterns (-p) */
+typedef enum { PAT_MIX, PAT_LIFO, PAT_FIFO, PAT_SAWTOOTH, PAT_PRODCONS,
+               PAT_REALLOC, PAT_CLASSES, PAT_FRAG, NPATTERNS } pattern_t;
+static const char *pattern_names[NPATTERNS] = {
+    "mix", "lifo", "fifo", "sawtooth", "prodcons", "realloc", "classes", "frag"
+};
+
+/* All of the generator parameters */
+typedef struct {
+    long ops;                /* approximate number of requests */
+    uint64_t seed;           /* seed for the random number generator */
+    int weight;              /* weight written to the trace header */
+    double mix[NKINDS];      /* relative frequency of each kind of object */
+    double alpha;            /* power-law exponent for sizes */
+    size_t min_size;         /* smallest request size */
+    size_t max_size;         /* largest request size */
+    life_t life;             /* lifetime distribution */
+    double life_mean;        /* mean (or max for uniform) lifetime */
+    double realloc_prob;     /* probability that an array grows */
+    double growth;           /* growth factor on each realloc */
+    int max_grow;            /* max number of reallocs per object */
+    pattern_t pattern;       /* access pattern */
+    size_t working;          /* objects live at the peak of a stress pattern */
+} params_t;
+
+/*
+ * A pending event for a live object: either its next realloc or its
+ * free.  Events are kept in a min-heap ordered by time (in allocations).
+ */
+typedef struct {
+    uint64_t time;           /* when the event fires */
+    uint64_t death;          /* when the object is freed */
+    long id;                 /* trace id of the object */
+    size_t size;             /* current size of the object */
+    int grow_left;           /* number of reallocs still to come */
+} event_t;
+
+typedef struct {
+    event_t *events;
+    size_t count;
+    size_t capacity;
+} heap_t;
+
+/* Statistics gathered while generating, used to fill in the header */
+typedef struct {
+    long num_ids;
+    long num_ops;
+    long live_objs;          /* objects allocated and not yet freed (-p only) */
+    size_t live_bytes;
+    size_t max_bytes;
+} tstats_t;
+
+static void generate_pattern(const params_t *p, FILE *out, tstats_t *st);
+static void usage(char *prog);
+static void app_error(const char *fmt, ...)
+    __attribute__((format(printf, 1,2), noreturn));
+
+/*****************************************************************
+ * Random number generation.  A private generator is used so that
+ * both passes see exactly the same sequence.
+ ****************************************************************/
+
+static uint64_t rng_state;
+
+static void rng_seed(uint64_t seed) {
+    rng_state = seed ? seed : 0x9E3779B97F4A7C15ull;
+}
+
+/* splitmix64 */
+static uint64_t rng_next(void) {
+    uint64_t z = (rng_state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+/* Uniform double in [0, 1) */
+static double rng_unit(void) {
+    return (rng_next() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/* Uniform integer in [0, n) */
+static size_t rng_below(size_t n) {
+    return (size_t) (rng_unit() * n);
+}
+
+/*
+ * rng_powerlaw - Sample from a power law with density proportional to
+ *     x^-alpha, truncated to [lo, hi], by inverting the CDF.
+ */
+static double rng_powerlaw(double lo, double hi, double alpha) {
+    double u = rng_unit();
+    if (fabs(alpha - 1.0) < 1e-9)
+        return lo * pow(hi / lo, u);
+    double e = 1.0 - alpha;
+    double a = pow(lo, e);
+    double b = pow(hi, e);
+    return pow(a + u * (b - a), 1.0 / e);
+}
+
+/*****************************************************************
+ * Object sizes and lifetimes
+ ****************************************************************/
+
+static size_t clamp_size(const params_t *p, double size) {
+    if (size < (double) p->min_size)
+        return p->min_size;
+    if (size > (double) p->max_size)
+        return p->max_size;
+    return (size_t) size;
+}
+
+static kind_t choose_kind(const params_t *p) {
+    double total = p->mix[ARRAY] + p->mix[STRING] + p->mix[STRUCT];
+    double u = rng_unit() * total;
+    if (u < p->mix[ARRAY])
+        return ARRAY;
+    if (u < p->mix[ARRAY] + p->mix[STRING])
+        return STRING;
+    return STRUCT;
+}
+
+/*
+ * choose_size - Arrays are a power-law number of elements of a random
+ *     element size, strings a power-law length plus terminator, and
+ *     structs one of a handful of common struct sizes.
+ */
+static size_t choose_size(const params_t *p, kind_t kind) {
+    double hi = (double) p->max_size;
+    switch (kind) {
+    case ARRAY: {
+        size_t elem = elem_sizes[rng_below(NELEMS(elem_sizes))];
+        double count = rng_powerlaw(1.0, hi / elem + 1.0, p->alpha);
+        return clamp_size(p, floor(count) * elem);
+    }
+    case STRING:
+        return clamp_size(p, floor(rng_powerlaw(1.0, hi, p->alpha)) + 1);
+    default:
+        return clamp_size(p, struct_sizes[rng_below(NELEMS(struct_sizes))]);
+    }
+}
+
+static uint64_t choose_lifetime(const params_t *p) {
+    double life;
+    switch (p->life) {
+    case LIFE_EXP:
+        life = -p->life_mean * log(1.0 - rng_unit());
+        break;
+    case LIFE_PARETO:
+        /* Pareto with shape 2 has mean 2 * scale */
+        life = (p->life_mean / 2.0) / sqrt(1.0 - rng_unit());
+        break;
+    default:
+        life = rng_unit() * p->life_mean;
+        break;
+    }
+    return (uint64_t) life + 1;
+}
+
+/*****************************************************************
+ * Event heap
+ ****************************************************************/
+
+static void heap_push(heap_t *h, const event_t *e) {
+    if (h->count == h->capacity) {
+        h->capacity = h->capacity ? 2 * h->capacity : 1024;
+        h->events = realloc(h->events, h->capacity * sizeof(event_t));
+        if (h->events == NULL)
+            app_error("realloc failed in heap_push\n");
+    }
+    size_t i = h->count++;
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (h->events[parent].time <= e->time)
+            break;
+        h->events[i] = h->events[parent];
+        i = parent;
+    }
+    h->events[i] = *e;
+}
+
+static event_t heap_pop(heap_t *h) {
+    event_t top = h->events[0];
+    event_t last = h->events[--h->count];
+    size_t i = 0;
+    for (;;) {
+        size_t child = 2 * i + 1;
+        if (child >= h->count)
+            break;
+        if (child + 1 < h->count &&
+            h->events[child + 1].time < h->events[child].time)
+            child++;
+        if (last.time <= h->events[child].time)
+            break;
+        h->events[i] = h->events[child];
+        i = child;
+    }
+    if (h->count > 0)
+        h->events[i] = last;
+    return top;
+}
+
+/*****************************************************************
+ * Trace generation
+ ****************************************************************/
+
+/* Emit a single request, or just count it if out is NULL */
+static void emit(FILE *out, tstats_t *st, char type, long id, size_t size) {
+    st->num_ops++;
+    if (out == NULL)
+        return;
+    if (type == 'f')
+        fprintf(out, "f %ld\n", id);
+    else
+        fprintf(out, "%c %ld %zu\n", type, id, size);
+}
+
+/*
+ * generate - Run the generator once.  Allocations advance the clock;
+ *     any event due at the current time is issued before the next
+ *     allocation.  Once the trace is long enough, every live object is
+ *     freed so that the trace ends with an empty heap.
+ */
+static void generate(const params_t *p, FILE *out, tstats_t *st) {
+    heap_t heap = {NULL, 0, 0};
+    uint64_t clock = 0;
+
+    rng_seed(p->seed);
+    memset(st, 0, sizeof(*st));
+    if (p->pattern != PAT_MIX) {
+        generate_pattern(p, out, st);
+        return;
+    }
+
+    /* Leave room to free every live object, plus one more malloc/free pair */
+    while (st->num_ops + (long) heap.count + 2 <= p->ops) {
+        if (heap.count > 0 && heap.events[0].time <= clock) {
+            event_t e = heap_pop(&heap);
+            if (e.grow_left == 0) {
+                emit(out, st, 'f', e.id, 0);
+                st->live_bytes -= e.size;
+                continue;
+            }
+            size_t newsize = clamp_size(p, ceil(e.size * p->growth));
+            emit(out, st, 'r', e.id, newsize);
+            st->live_bytes += newsize - e.size;
+            e.size = newsize;
+            e.grow_left--;
+            e.time += (e.death - e.time) / (e.grow_left + 1);
+            heap_push(&heap, &e);
+        } else {
+            kind_t kind = choose_kind(p);
+            event_t e;
+            e.id = st->num_ids++;
+            e.size = choose_size(p, kind);
+            e.death = clock + choose_lifetime(p);
+            e.grow_left = 0;
+            if (kind == ARRAY && p->max_grow > 0 && rng_unit() < p->realloc_prob)
+                e.grow_left = 1 + rng_below(p->max_grow);
+            e.time = e.grow_left ? clock + (e.death - clock) / (e.grow_left + 1)
+                                 : e.death;
+            emit(out, st, 'a', e.id, e.size);
+            st->live_bytes += e.size;
+            heap_push(&heap, &e);
+            clock++;
+        }
+        if (st->live_bytes > st->max_bytes)
+            st->max_bytes = st->live_bytes;
+    }
+
+    /* Drain: free everything still live, in order of death */
+    while (heap.count > 0) {
+        event_t e = heap_pop(&heap);
+        emit(out, st, 'f', e.id, 0);
+        st->live_bytes -= e.size;
+    }
+    free(heap.events);
+}
+
+/*****************************************************************
+ * Stress patterns (-p).  Each keeps its live objects in pools, and
+ * stops once the requests so far plus a free for everything still
+ * live would pass the number of requests asked for.
+ ****************************************************************/
+
+/* A live object of a stress pattern */
+typedef struct {
+    long id;
+    size_t size;
+} obj_t;
+
+/* Live objects in the order they were added, taken from either end or anywhere */
+typedef struct {
+    obj_t *objs;
+    size_t head;             /* index of the oldest object */
+    size_t tail;             /* one past the newest object */
+    size_t capacity;
+} pool_t;
+
+/* Pools a pattern can use, all drained oldest first at the end */
+#define NPOOLS 3
+
+static size_t pool_count(const pool_t *q) {
+    return q->tail - q->head;
+}
+
+static void pool_push(pool_t *q, obj_t o) {
+    if (q->tail == q->capacity) {
+        /* Slide the objects down to the start, growing if they fill half */
+        size_t count = pool_count(q);
+        if (count >= q->capacity / 2) {
+            q->capacity = q->capacity ? 2 * q->capacity : 1024;
+            q->objs = realloc(q->objs, q->capacity * sizeof(obj_t));
+            if (q->objs == NULL)
+                app_error("realloc failed in pool_push\n");
+        }
+        memmove(q->objs, q->objs + q->head, count * sizeof(obj_t));
+        q->head = 0;
+        q->tail = count;
+    }
+    q->objs[q->tail++] = o;
+}
+
+static obj_t pool_oldest(pool_t *q) {
+    return q->objs[q->head++];
+}
+
+static obj_t pool_newest(pool_t *q) {
+    return q->objs[--q->tail];
+}
+
+/* Take out the i'th oldest object, moving the newest into its place */
+static obj_t pool_take(pool_t *q, size_t i) {
+    obj_t o = q->objs[q->head + i];
+    q->objs[q->head + i] = q->objs[--q->tail];
+    return o;
+}
+
+/* Whether n more requests, and a free for everything live, still fit */
+static bool room_for(const params_t *p, const tstats_t *st, long n) {
+    return st->num_ops + st->live_objs + n <= p->ops;
+}
+
+static void obj_alloc(FILE *out, tstats_t *st, pool_t *q, size_t size) {
+    obj_t o = {st->num_ids++, size};
+    emit(out, st, 'a', o.id, size);
+    st->live_objs++;
+    st->live_bytes += size;
+    if (st->live_bytes > st->max_bytes)
+        st->max_bytes = st->live_bytes;
+    pool_push(q, o);
+}
+
+static void obj_realloc(FILE *out, tstats_t *st, obj_t *o, size_t size) {
+    emit(out, st, 'r', o->id, size);
+    st->live_bytes += size - o->size;
+    if (st->live_bytes > st->max_bytes)
+        st->max_bytes = st->live_bytes;
+    o->size = size;
+}
+
+static void obj_free(FILE *out, tstats_t *st, obj_t o) {
+    emit(out, st, 'f', o.id, 0);
+    st->live_objs--;
+    st->live_bytes -= o.size;
+}
+
+/* A power-law size in the size range */
+static size_t pattern_size(const params_t *p) {
+    return clamp_size(p, floor(rng_powerlaw((double) p->min_size,
+                                            (double) p->max_size + 1.0, p->alpha)));
+}
+
+/*
+ * gen_lifo - LIFO churn: a stack of objects grows and shrinks by bursts
+ *     of up to 64, never past the working set, so the block freed last
+ *     is always the next one a request can reuse.
+ */
+static void gen_lifo(const params_t *p, FILE *out, tstats_t *st, pool_t *pools) {
+    pool_t *stack = &pools[0];
+    for (;;) {
+        size_t burst = 1 + rng_below(64);
+        if (pool_count(stack) < burst ||
+            (pool_count(stack) + burst <= p->working && rng_below(2))) {
+            if (!room_for(p, st, 2 * burst))
+                return;
+            for (size_t k = 0; k < burst; k++)
+                obj_alloc(out, st, stack, pattern_size(p));
+        } else {
+            for (size_t k = 0; k < burst; k++)
+                obj_free(out, st, pool_newest(stack));
+        }
+    }
+}
+
+/*
+ * gen_fifo - FIFO churn: each object is freed once the working set of
+ *     newer objects has been allocated after it, so frees trail the
+ *     allocations through the heap and the holes they leave seldom fit
+ *     the next request exactly.
+ */
+static void gen_fifo(const params_t *p, FILE *out, tstats_t *st, pool_t *pools) {
+    pool_t *queue = &pools[0];
+    while (room_for(p, st, 3)) {
+        obj_alloc(out, st, queue, pattern_size(p));
+        if (pool_count(queue) > p->working)
+            obj_free(out, st, pool_oldest(queue));
+    }
+}
+
+/*
+ * gen_sawtooth - Sawtooth growth and release: the live set grows to the
+ *     working set, then a random 90% of it is freed, and again, so each
+ *     tooth has to be built in the holes between the survivors of the
+ *     teeth before it.
+ */
+static void gen_sawtooth(const params_t *p, FILE *out, tstats_t *st, pool_t *pools) {
+    pool_t *live = &pools[0];
+    for (;;) {
+        while (pool_count(live) < p->working) {
+            if (!room_for(p, st, 2))
+                return;
+            obj_alloc(out, st, live, pattern_size(p));
+        }
+        while (pool_count(live) > p->working / 10)
+            obj_free(out, st, pool_take(live, rng_below(pool_count(live))));
+    }
+}
+
+/*
+ * gen_prodcons - Producer-consumer: two producers queue bursts of small
+ *     (16-128 byte) and large (512-4096 byte) messages, which a consumer
+ *     frees in the order they were queued.  One message in a hundred is
+ *     kept well after it is consumed, pinning the space around it.
+ */
+static void gen_prodcons(const params_t *p, FILE *out, tstats_t *st, pool_t *pools) {
+    pool_t *queue = &pools[0], *kept = &pools[1];
+    for (;;) {
+        size_t burst = 1 + rng_below(16);
+        if (pool_count(queue) + burst <= p->working && rng_below(2)) {
+            if (!room_for(p, st, 2 * burst))
+                return;
+            bool large = rng_below(2);
+            for (size_t k = 0; k < burst; k++)
+                obj_alloc(out, st, queue, large ? clamp_size(p, 512 + rng_below(3585))
+                                                : clamp_size(p, 16 + rng_below(113)));
+        } else {
+            for (size_t k = 0; k < burst && pool_count(queue) > 0; k++) {
+                obj_t o = pool_oldest(queue);
+                if (rng_below(100) == 0)
+                    pool_push(kept, o);
+                else
+                    obj_free(out, st, o);
+            }
+            if (pool_count(kept) > p->working / 10)
+                obj_free(out, st, pool_take(kept, rng_below(pool_count(kept))));
+        }
+    }
+}
+
+/*
+ * gen_realloc - Realloc doubling: sixteen vectors each double with
+ *     realloc from the smallest size to the largest, then are freed and
+ *     started again, while a working set of other objects churns
+ *     around them, so growing in place is seldom possible.
+ */
+static void gen_realloc(const params_t *p, FILE *out, tstats_t *st, pool_t *pools) {
+    pool_t *others = &pools[0], *vectors = &pools[1];
+    const size_t nvectors = 16;
+
+    if (!room_for(p, st, 2 * nvectors))
+        return;
+    for (size_t v = 0; v < nvectors; v++)
+        obj_alloc(out, st, vectors, p->min_size);
+
+    while (room_for(p, st, 4)) {
+        if (pool_count(others) < p->working)
+            obj_alloc(out, st, others, pattern_size(p));
+        else
+            obj_free(out, st, pool_take(others, rng_below(pool_count(others))));
+
+        size_t v = rng_below(nvectors);
+        obj_t *o = &vectors->objs[vectors->head + v];
+        if (o->size >= p->max_size) {
+            obj_free(out, st, pool_take(vectors, v));
+            obj_alloc(out, st, vectors, p->min_size);
+        } else {
+            obj_realloc(out, st, o, clamp_size(p, 2.0 * o->size));
+        }
+    }
+}
+
+/*
+ * gen_classes - Many size classes interleaved: requests cycle through 48
+ *     sizes spaced evenly on a log scale across the size range, and once
+ *     the working set is live a random object is freed for each one, so
+ *     every class is in use at once.
+ */
+static void gen_classes(const params_t *p, FILE *out, tstats_t *st, pool_t *pools) {
+    pool_t *live = &pools[0];
+    const int nclasses = 48;
+    double ratio = (double) p->max_size / p->min_size;
+
+    for (int c = 0; room_for(p, st, 3); c = (c + 1) % nclasses) {
+        obj_alloc(out, st, live,
+                  clamp_size(p, round(p->min_size * pow(ratio, c / (nclasses - 1.0)))));
+        if (pool_count(live) > p->working)
+            obj_free(out, st, pool_take(live, rng_below(pool_count(live))));
+    }
+}
+
+/*
+ * gen_frag - Worst-case fragmentation: each round allocates twice the
+ *     working set of one size and frees every other one, frees the
+ *     survivors of the round before, and doubles the size.  The holes a
+ *     round leaves are too small for the next round's requests until
+ *     their neighbors are freed a round later.
+ */
+static void gen_frag(const params_t *p, FILE *out, tstats_t *st, pool_t *pools) {
+    pool_t *survivors = &pools[0], *holes = &pools[1], *last = &pools[2];
+    size_t size = p->min_size;
+
+    while (room_for(p, st, 4 * p->working + pool_count(survivors))) {
+        for (size_t k = 0; k < p->working; k++) {
+            obj_alloc(out, st, survivors, size);
+            obj_alloc(out, st, holes, size);
+        }
+        while (pool_count(holes) > 0)
+            obj_free(out, st, pool_oldest(holes));
+        while (pool_count(last) > 0)
+            obj_free(out, st, pool_oldest(last));
+
+        /* This round's survivors are the ones freed after the next round */
+        pool_t tmp = *last;
+        *last = *survivors;
+        *survivors = tmp;
+
+        size = 2 * size + 16;
+        if (size > p->max_size)
+            size = p->min_size;
+    }
+}
+
+/*
+ * generate_pattern - Run one of the stress patterns, then free every
+ *     object still live, oldest first.
+ */
+static void generate_pattern(const params_t *p, FILE *out, tstats_t *st) {
+    pool_t pools[NPOOLS];
+    memset(pools, 0, sizeof(pools));
+
+    switch (p->pattern) {
+    case PAT_LIFO:
+        gen_lifo(p, out, st, pools);
+        break;
+    case PAT_FIFO:
+        gen_fifo(p, out, st, pools);
+        break;
+    case PAT_SAWTOOTH:
+        gen_sawtooth(p, out, st, pools);
+        break;
+    case PAT_PRODCONS:
+        gen_prodcons(p, out, st, pools);
+        break;
+    case PAT_REALLOC:
+        gen_realloc(p, out, st, pools);
+        break;
+    case PAT_CLASSES:
+        gen_classes(p, out, st, pools);
+        break;
+    default:
+        gen_frag(p, out, st, pools);
+        break;
+    }
+
+    for (int i = 0; i < NPOOLS; i++) {
+        while (pool_count(&pools[i]) > 0)
+            obj_free(out, st, pool_oldest(&pools[i]));
+        free(pools[i].objs);
+    }
+}
+
+/*****************************************************************
+ * Command line handling
+ ****************************************************************/
+
+static void parse_mix(params_t *p, const char *arg) {
+    if (sscanf(arg, "%lf:%lf:%lf", &p->mix[ARRAY], &p->mix[STRING],
+               &p->mix[STRUCT]) != 3 ||
+        p->mix[ARRAY] < 0 || p->mix[STRING] < 0 || p->mix[STRUCT] < 0 ||
+        p->mix[ARRAY] + p->mix[STRING] + p->mix[STRUCT] <= 0)
+        app_error("Bad mixture '%s', expected <arrays>:<strings>:<structs>\n", arg);
+}
+
+static void parse_sizes(params_t *p, const char *arg) {
+    if (sscanf(arg, "%zu:%zu", &p->min_size, &p->max_size) != 2 ||
+        p->min_size == 0 || p->min_size > p->max_size)
+        app_error("Bad size range '%s', expected <min>:<max>\n", arg);
+}
+
+static void parse_life(params_t *p, const char *arg) {
+    char name[16];
+    if (sscanf(arg, "%15[a-z]:%lf", name, &p->life_mean) != 2 || p->life_mean <= 0)
+        app_error("Bad lifetime '%s', expected <dist>:<mean>\n", arg);
+    if (strcmp(name, "exp") == 0)
+        p->life = LIFE_EXP;
+    else if (strcmp(name, "pareto") == 0)
+        p->life = LIFE_PARETO;
+    else if (strcmp(name, "uniform") == 0)
+        p->life = LIFE_UNIFORM;
+    else
+        app_error("Unknown lifetime distribution '%s'\n", name);
+}
+
+static void parse_pattern(params_t *p, const char *arg) {
+    for (int i = 0; i < NPATTERNS; i++) {
+        if (strcmp(arg, pattern_names[i]) == 0) {
+            p->pattern = i;
+            return;
+        }
+    }
+    app_error("Unknown pattern '%s'\n", arg);
+}
+
+int main(int argc, char **argv)
+{
+    params_t p = {
+        .ops = DEF_OPS,
+        .seed = DEF_SEED,
+        .weight = 1,
+        .mix = {1.0, 1.0, 1.0},
+        .alpha = DEF_ALPHA,
+        .min_size = DEF_MIN_SIZE,
+        .max_size = DEF_MAX_SIZE,
+        .life = LIFE_EXP,
+        .life_mean = DEF_LIFETIME,
+        .realloc_prob = 0.0,
+        .growth = DEF_GROWTH,
+        .max_grow = DEF_MAX_GROW,
+        .pattern = PAT_MIX,
+        .working = DEF_WORKING,
+    };
+    char *outname = NULL;
+    tstats_t st;
+    int c;
+
+    while ((c = getopt(argc, argv, "n:s:w:m:a:S:l:r:g:G:p:W:o:h")) != EOF) {
+        switch (c) {
+        case 'n':
+            p.ops = atol(optarg);
+            break;
+        case 's':
+            p.seed = strtoull(optarg, NULL, 0);
+            break;
+        case 'w':
+            p.weight = atoi(optarg);
+            if (p.weight < 0 || p.weight > 3)
+                app_error("weight can only be in {0, 1, 2, 3}\n");
+            break;
+        case 'm':
+            parse_mix(&p, optarg);
+            break;
+        case 'a':
+            p.alpha = atof(optarg);
+            break;
+        case 'S':
+            parse_sizes(&p, optarg);
+            break;
+        case 'l':
+            parse_life(&p, optarg);
+            break;
+        case 'r':
+            p.realloc_prob = atof(optarg);
+            break;
+        case 'g':
+            p.growth = atof(optarg);
+            if (p.growth < 1.0)
+                app_error("growth factor must be at least 1\n");
+            break;
+        case 'G':
+            p.max_grow = atoi(optarg);
+            break;
+        case 'p':
+            parse_pattern(&p, optarg);
+            break;
+        case 'W':
+            p.working = strtoul(optarg, NULL, 0);
+            if (p.working == 0)
+                app_error("working set must be at least 1 object\n");
+            break;
+        case 'o':
+            outname = optarg;
+            break;
+        case 'h':
+            usage(argv[0]);
+            exit(0);
+        default:
+            usage(argv[0]);
+            exit(1);
+        }
+    }
+    if (p.ops < 2)
+        app_error("need at least 2 operations\n");
+
+    /* Pass 1: compute the header */
+    generate(&p, NULL, &st);
+
+    /* Pass 2: write the trace */
+    FILE *out = stdout;
+    if (outname && (out = fopen(outname, "w")) == NULL)
+        app_error("Could not open %s for writing\n", outname);
+    fprintf(out, "%d\n%ld\n%ld\n%zu\n", p.weight, st.num_ids, st.num_ops, st.max_bytes);
+    generate(&p, out, &st);
+    if (out != stdout)
+        fclose(out);
+
+    fprintf(stderr, "%ld ids, %ld ops, %zu peak bytes\n",
+            st.num_ids, st.num_ops, st.max_bytes);
+    return 0;
+}
+
+/*
+ * app_error - Report an arbitrary application error
+ */
+static void app_error(const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+    exit(1);
+}
+
+/*
+ * usage - Explain the command line arguments
+ */
+static void usage(char *prog)
+{
+    fprintf(stderr, "Usage: %s [-h] [-n <ops>] [-s <seed>] [-o <file>] [options]\n", prog);
+    fprintf(stderr, "Options\n");
+    fprintf(stderr, "\t-n <ops>      Approximate number of requests (default %d).\n", DEF_OPS);
+    fprintf(stderr, "\t-s <seed>     Random seed (default %d).\n", DEF_SEED);
+    fprintf(stderr, "\t-w <w>        Trace weight written to the header (default 1).\n");
+    fprintf(stderr, "\t-m <a>:<s>:<t> Relative mix of arrays, strings and structs (default 1:1:1).\n");
+    fprintf(stderr, "\t-a <alpha>    Power-law exponent for sizes (default %.1f).\n", DEF_ALPHA);
+    fprintf(stderr, "\t-S <min>:<max> Range of request sizes (default %d:%d).\n",
+            DEF_MIN_SIZE, DEF_MAX_SIZE);
+    fprintf(stderr, "\t-l <dist>:<m> Lifetime in allocations: exp, pareto or uniform,\n"
+                    "\t              with mean (max for uniform) m (default exp:%.0f).\n",
+            DEF_LIFETIME);
+    fprintf(stderr, "\t-r <prob>     Probability that an array is grown with realloc (default 0).\n");
+    fprintf(stderr, "\t-g <factor>   Growth factor on each realloc (default %.1f).\n", DEF_GROWTH);
+    fprintf(stderr, "\t-G <n>        Max number of reallocs per array (default %d).\n", DEF_MAX_GROW);
+    fprintf(stderr, "\t-p <pattern>  Stress pattern instead of the mixture: lifo, fifo,\n"
+                    "\t              sawtooth, prodcons, realloc, classes or frag.\n");
+    fprintf(stderr, "\t-W <n>        Objects live at the peak of a pattern (default %d).\n",
+            DEF_WORKING);
+    fprintf(stderr, "\t-o <file>     Write the trace to <file> instead of stdout.\n");
+    fprintf(stderr, "\t-h            Print this message.\n");
+}
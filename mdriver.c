@@ -21,12 +21,19 @@
 #include <stdbool.h>
 #include <math.h>
 #include <getopt.h>
+#include <pthread.h>
+#include <dlfcn.h>
+#include <malloc.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
 
 #include "mm.h"
 #include "memlib.h"
 #include "fcyc.h"
+#include "clock.h"
 #include "config.h"
-#include "stree.h"
+#include "btree.h"
+#include "shadow.h"
 
 /**********************
  * Constants and macros
@@ -59,24 +66,14 @@ typedef enum { WNONE, WALL, WUTIL, WPERF } weight_t;
  */
 
 /*
- * Records the extent of each block's payload.
- * Organized as doubly linked list
- */
-typedef struct range_t {
-    char *lo;              /* low payload address */
-    char *hi;              /* high payload address */
-    long index;            /* same index as free; for debugging */
-    struct range_t *next;
-    struct range_t *prev;
-} range_t;
-
-/*
- * All information about set of ranges represented as doubly-linked
- * list of ranges, plus a splay tree keyed by lo addresses
+ * All information about set of ranges: the extent of each block's
+ * payload, and its index, in a B+tree keyed by lo addresses.  With -H,
+ * overlaps are found in a shadow bitmap of the heap instead, and the
+ * tree is only kept up for the DBG_EXPENSIVE checks that walk it.
  */
 typedef struct {
-    range_t *list;
-    tree_t *lo_tree;
+    btree_t *lo_tree;
+    shadow_t *shadow;   /* NULL unless -H */
 } range_set_t;
 
 /* Characterizes a single trace operation (allocator request) */
@@ -86,6 +83,23 @@ typedef struct {
     size_t size;                        /* byte size of alloc/realloc request */
 } traceop_t;
 
+/*
+ * The ops of an in-memory trace as parallel arrays, which read_trace
+ * builds for the replay kernel that times them: a byte for each op's
+ * type, a 32-bit block index and a size.  That is 13 bytes an op rather
+ * than the 24 of a traceop_t, and the indices that the kernel looks
+ * ahead through to prefetch block slots are packed together.  index has
+ * REPLAY_AHEAD more entries of -1 past the end, so it can look ahead
+ * from any op.
+ */
+#define REPLAY_AHEAD 8
+
+typedef struct {
+    unsigned char *type;
+    int32_t *index;
+    size_t *size;
+} oparrays_t;
+
 /* Holds the information for one trace file */
 typedef struct {
     char filename[MAXLINE];
@@ -94,11 +108,62 @@ typedef struct {
     int num_ops;          /* number of distinct requests */
     weight_t weight;      /* weight for this trace */
     traceop_t *ops;       /* array of requests */
+    oparrays_t arrays;    /* the same requests for the replay kernel (not -S) */
     char **blocks;        /* array of ptrs returned by malloc/realloc... */
     size_t *block_sizes;  /* ... and a corresponding array of payload sizes */
     int *block_rand_base; /* index into random_data, if debug is on */
+    int *block_arenas;    /* arena slot each payload came from, under -R */
+    struct stream *stream;/* non-NULL if ops are streamed from the file (-S) */
+    int op_base;          /* opnum of the first op in the current batch */
+    bool ops_done;        /* in-memory trace: have all ops been handed out? */
 } trace_t;
 
+/*
+ * Streaming replay (-S).  Rather than reading the whole trace into
+ * memory, a reader thread parses ops into two fixed-size chunks that
+ * it fills alternately while the main thread replays the other one.
+ * The reader also recycles block ids: each id is mapped to the lowest
+ * free slot when it is allocated and the slot is released when it is
+ * freed, so trace->blocks and friends only grow to the peak number of
+ * live blocks rather than to num_ids.
+ */
+#define STREAM_CHUNK_OPS (1<<16)
+
+typedef struct {
+    traceop_t ops[STREAM_CHUNK_OPS];
+    int num_ops;          /* number of ops in the chunk */
+    int num_slots;        /* slots needed by all ops up to the end of the chunk */
+    bool full;            /* ready to be replayed */
+} chunk_t;
+
+/* Entry in the reader's table mapping live trace ids to slots */
+typedef struct {
+    long id;              /* -1 if the entry is empty */
+    int slot;
+} slotmap_t;
+
+typedef struct stream {
+    FILE *file;
+    long data_start;      /* file offset of the first op */
+    pthread_t reader;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    chunk_t *chunks;      /* two chunks, filled alternately */
+    int fill;             /* chunk the reader fills next */
+    int drain;            /* chunk the replay reads next */
+    bool holding;         /* replay is still using chunks[drain] */
+    bool done;            /* reader has reached the end of the trace */
+    bool stop;            /* replay asks the reader to quit */
+    /* The following are only touched by the reader thread */
+    slotmap_t *map;       /* open-addressing table of live ids */
+    size_t map_mask;      /* capacity - 1 */
+    size_t map_count;
+    int *free_slots;      /* stack of released slots */
+    int num_free;
+    int free_capacity;
+    int num_slots;        /* slots handed out so far */
+} stream_t;
+
 /*
  * Holds the params to the xxx_speed functions, which are timed by fcyc.
  * This struct is necessary because fcyc accepts only a pointer array
@@ -109,6 +174,35 @@ typedef struct {
     range_set_t *ranges;
 } speed_t;
 
+/*
+ * An mm malloc package under test: the one linked into the driver, or
+ * one loaded from a shared object with -L.  The driver only calls the
+ * package through one of these.
+ */
+typedef struct {
+    const char *name;
+    void *handle;                   /* from dlopen, NULL if linked in */
+    bool (*init)(void);
+    void *(*malloc)(size_t size);
+    void (*free)(void *ptr);
+    void *(*realloc)(void *ptr, size_t size);
+    void *(*calloc)(size_t nmemb, size_t size);
+    bool (*checkheap)(int lineno);
+    /* Optional: NULL if the package doesn't export them */
+    bool (*checkheap_incremental)(int lineno);
+    size_t (*free_stats)(size_t *class_size, size_t *free_bytes,
+                         size_t max_classes, size_t *largest);
+    void *(*memalign)(size_t alignment, size_t size);
+    void (*free_sized)(void *ptr, size_t size);
+    size_t (*usable_size)(void *ptr);
+    size_t (*malloc_batch)(size_t size, size_t n, void **ptrs);
+    void (*free_batch)(void **ptrs, size_t n);
+    struct arena *(*arena_create)(size_t chunk_size);
+    void *(*arena_alloc)(struct arena *arena, size_t size);
+    void (*arena_reset)(struct arena *arena);
+    void (*arena_destroy)(struct arena *arena);
+} package_t;
+
 /* Summarizes the important stats for some malloc function on some trace */
 typedef struct {
     /* set in read_trace */
@@ -124,6 +218,13 @@ typedef struct {
     /* defined only for the student malloc package */
     double util;       /* space utilization for this trace (always 0 for libc) */
 
+    /* defined only with -l */
+    long rss_kb;       /* growth in peak RSS over one replay, in KB; -1 if unknown */
+
+    /* defined only with -M */
+    long faults;       /* page faults taken from mem_init to the end of the trace */
+    long timed_faults; /* the part of those taken while timing the trace */
+
     /* Note: secs and util are only defined if valid is true */
 } stats_t;
 
@@ -140,7 +241,8 @@ typedef struct {
  * at a "random" place (a hash of the index), and copy random data
  * into it.  With DBG_CHEAP, we check that the data survived when we
  * realloc and when we free.  With DBG_EXPENSIVE, we check every block
- * every operation.
+ * every operation, or with incremental checking (-I) only the blocks
+ * next to the one each operation touched, and every block at the end.
  * randint_t should be a byte, in case students return unaligned memory.
  *******************/
 #define RANDOM_DATA_LEN (1<<16)
@@ -162,10 +264,50 @@ int verbose = REF_ONLY ? 0 : 1;  /* global flag for verbose output */
 static int errors = 0;           /* number of errs found when running student malloc */
 static bool onetime_flag = false;
 static bool tab_mode = false;     /* Print output as tab-separated fields */
+static bool stream_mode = false; /* Stream traces from disk (-S) */
+static int frag_interval = 0;    /* Sample fragmentation every K ops (-g) */
+static bool incremental = false; /* Check only what each op touched (-I) */
+static bool shadow_mode = false; /* Find overlaps in a shadow bitmap (-H) */
+static bool fault_mode = false;  /* Count page faults per trace (-M) */
+static size_t payload_align = 0; /* Allocate with memalign to this (-a) */
+static bool sized_free = false;  /* Free with mm_free_sized (-z) */
+static bool batch_mode = false;  /* Batch runs of allocs and frees (-B) */
+static int arena_objs = 0;       /* Allocate from arenas of this many payloads (-R) */
+static int touch_percent = 0;    /* Write and read this % of each payload (-w) */
 /* If set, use sparse memory emulation */
 static bool sparse_mode = SPARSE_MODE;
 static size_t maxfill = SPARSE_MODE ? MAXFILL_SPARSE : MAXFILL;
 
+/* The package being run: the linked-in one unless -L loaded others */
+static package_t linked_mm = {
+    "mm", NULL, mm_init, mm_malloc, mm_free, mm_realloc, mm_calloc,
+    mm_checkheap, mm_checkheap_incremental, mm_free_stats, mm_memalign,
+    mm_free_sized, mm_usable_size, mm_malloc_batch, mm_free_batch,
+    mm_arena_create, mm_arena_alloc, mm_arena_reset, mm_arena_destroy
+};
+static package_t *mm = &linked_mm;
+
+/* libc malloc, for the replay kernel under -l */
+static package_t libc_mm = {
+    .name = "libc", .malloc = malloc, .free = free, .realloc = realloc
+};
+
+/*
+ * The empty package, which allocates nothing.  Replaying a trace on it
+ * times the driver's own part of a replay, without any allocator.
+ */
+static char empty_payload[1];
+static void *empty_malloc(size_t size) { return empty_payload; }
+static void empty_free(void *ptr) { }
+static void *empty_realloc(void *ptr, size_t size) { return empty_payload; }
+
+static package_t empty_mm = {
+    .name = "empty", .malloc = empty_malloc, .free = empty_free,
+    .realloc = empty_realloc
+};
+static package_t *plugins = NULL;
+static int num_plugins = 0;
+
 /* by default, no timeouts */
 static int set_timeout = 0;
 
@@ -179,6 +321,11 @@ static char *default_tracefiles[] = {
     DEFAULT_TRACEFILES, NULL
 };
 
+/* The filenames of the stress-pattern tracefiles (-b) */
+static char *bench_tracefiles[] = {
+    BENCH_TRACEFILES, NULL
+};
+
 /* Store names of trace files as array of char *'s */
 static int num_global_tracefiles = 0;
 static char **global_tracefiles = NULL;
@@ -198,36 +345,90 @@ static sum_stats_t global_mm_sum_stats;
 /* This function enables generating the set of trace files */
 static void add_tracefile(char *trace);
 
+/* Load an mm malloc package from a shared object (-L) */
+static void load_plugin(const char *path);
+
 /* these functions manipulate range sets */
 static range_set_t *new_range_set();
 static bool add_range(range_set_t *ranges, char *lo, size_t size,
                       const trace_t *trace, int opnum, int index);
-static void remove_range(range_set_t *ranges, char *lo);
+static void remove_range(range_set_t *ranges, char *lo, size_t size);
 static void free_range_set(range_set_t *ranges);
 
 /* These functions implement the debugging code */
 static void init_random_data(void);
 static bool check_index(const trace_t *trace, int opnum, int index);
+static bool check_neighbors(const trace_t *trace, range_set_t *ranges,
+                            int opnum, char *lo);
+static bool check_all(const trace_t *trace, range_set_t *ranges, int opnum);
 static void randomize_block(trace_t *trace, int index);
 
 /* These functions read, allocate, and free storage for traces */
 static trace_t *read_trace(stats_t *stats, const char *tracedir,
                            const char *filename);
+static trace_t *open_trace(stats_t *stats, const char *tracedir,
+                           const char *filename);
 static void reinit_trace(trace_t *trace);
 static void free_trace(trace_t *trace);
+static void close_stream(struct stream *st);
+
+/* These functions hand out the ops of a trace, in batches if streaming */
+static void rewind_ops(trace_t *trace);
+static traceop_t *next_ops(trace_t *trace, int *count);
+static double time_stream(test_funct f, void *args);
 
 /* Routines for evaluating the correctness and speed of libc malloc */
 static bool eval_libc_valid(trace_t *trace);
 static void eval_libc_speed(void *ptr);
 
+/* The replay kernel, and timing it less the driver's part (empty replay) */
+static bool use_replay(const trace_t *trace);
+static void replay(trace_t *trace, const package_t *pkg);
+static void eval_empty_speed(void *ptr);
+static double time_replay(test_funct f, speed_t *params);
+
+/* Measures the resident memory a replay adds (-l) */
+static long rss_growth(test_funct f, void *args);
+
+/* Counts page faults and chooses how the heap is mapped (-M) */
+static long page_faults(void);
+static int parse_map_options(char *opts);
+
 /* Routines for evaluating correctnes, space utilization, and speed
    of the student's malloc package in mm.c */
 static bool eval_mm_valid(trace_t *trace, range_set_t *ranges);
 static double eval_mm_util(trace_t *trace, int tracenum);
+static FILE *open_frag_file(const trace_t *trace);
+static void sample_frag(FILE *f, long opnum, size_t live_bytes);
 static void eval_mm_speed(void *ptr);
 
+/* Allocate a payload with malloc, with memalign under -a, or from an arena under -R */
+static void *mm_alloc(trace_t *trace, int index, size_t size);
+static void *libc_alloc(size_t size);
+
+/* Free a payload with free, with free_sized under -z, or to its arena under -R */
+static void mm_release(trace_t *trace, int index, void *p, size_t size);
+static size_t payload_extent(void *p, size_t size);
+
+/* Resize a payload with realloc, or by copying it to an arena under -R */
+static void *mm_resize(trace_t *trace, int index, size_t size);
+
+/* Hand runs of like ops to mm_malloc_batch and mm_free_batch under -B */
+static int batch_run(const traceop_t *ops, int i, int count);
+static bool mm_alloc_batch(trace_t *trace, const traceop_t *ops, size_t size, int n);
+
+/* Allocate from, and reset or destroy, the arenas of -R */
+static void *arena_payload(trace_t *trace, int index, size_t size);
+static void arena_release(int slot);
+static bool next_arena(void);
+static void forget_arenas(void);
+static void destroy_arenas(void);
+
 /* Various helper routines */
 static void printresults(int n, stats_t *stats, sum_stats_t *sumstats);
+static void print_comparison(int n, stats_t **stats);
+static void print_libc_comparison(int n, stats_t *mm_stats, stats_t *libc_stats);
+static void print_faults(int n, stats_t *stats);
 static void usage(char *prog);
 static void malloc_error(const trace_t *trace, int opnum, const char *fmt, ...)
     __attribute__((format(printf, 3,4)));
@@ -266,13 +467,14 @@ static void run_tests(int num_tracefiles, const char *tracedir,
         /* initialize simulated memory system in memlib.c *
          * start each trace with a clean system */
         mem_init(sparse_mode);
-        range_set_t *ranges = new_range_set();
+        range_set_t *volatile ranges = new_range_set();
+        long faults = page_faults();
 
 
         // NOTE: If times out, then it will reread the trace file
 
-        trace_t *trace;
-        trace = read_trace(&mm_stats[i], tracedir, tracefiles[i]);
+        trace_t *volatile trace;
+        trace = open_trace(&mm_stats[i], tracedir, tracefiles[i]);
         strcpy(mm_stats[i].filename, trace->filename);
         mm_stats[i].ops = trace->num_ops;
 
@@ -282,9 +484,10 @@ static void run_tests(int num_tracefiles, const char *tracedir,
         } else {
             if (verbose > 1)
                 printf("Checking mm_malloc for correctness, ");
-            mm_stats[i].valid =
-                /* Do 2 tests, since may fail to reinitialize properly */
-                eval_mm_valid(trace, ranges) && eval_mm_valid(trace, ranges);
+            /* Do 2 tests, since may fail to reinitialize properly.
+               A streamed trace is long enough that once will do. */
+            mm_stats[i].valid = eval_mm_valid(trace, ranges) &&
+                (trace->stream || eval_mm_valid(trace, ranges));
 
             if (onetime_flag) {
                 free_trace(trace);
@@ -299,9 +502,17 @@ static void run_tests(int num_tracefiles, const char *tracedir,
             speed_params->ranges = ranges;
             if (verbose > 1)
                 printf("and performance.\n");
-            mm_stats[i].secs = sparse_mode ? 1.0 : fsec(eval_mm_speed, speed_params);
+            long timed_faults = page_faults();
+            if (sparse_mode)
+                mm_stats[i].secs = 1.0;
+            else if (trace->stream)
+                mm_stats[i].secs = time_stream(eval_mm_speed, speed_params);
+            else
+                mm_stats[i].secs = time_replay(eval_mm_speed, speed_params);
             mm_stats[i].tput = mm_stats[i].ops / (mm_stats[i].secs * 1000.0);
+            mm_stats[i].timed_faults = page_faults() - timed_faults;
         }
+        mm_stats[i].faults = page_faults() - faults;
 
         free_trace(trace);
         free_range_set(ranges);
@@ -321,10 +532,12 @@ int main(int argc, char **argv)
     num_global_tracefiles = 0;    /* the number of traces in that array */
 
     stats_t *libc_stats = NULL;/* libc stats for each trace */
+    long *mm_rss_kb = NULL;    /* RSS growth of mm for each trace, with -l */
     stats_t *mm_stats = NULL;  /* mm (i.e. student) stats for each trace */
     speed_t speed_params;      /* input parameters to the xx_speed routines */
 
     bool run_libc = false;     /* If set, run libc malloc (set by -l) */
+    bool bench_traces = false; /* If set, run the bench-*.rep traces (set by -b) */
     bool autograder = false;   /* if set then called by autograder (-A) */
     bool checkpoint = false;
 
@@ -348,7 +561,7 @@ int main(int argc, char **argv)
     /*
      * Read and interpret the command line arguments
      */
-    while ((c = getopt(argc, argv, "d:f:c:s:t:v:hpOVAlDT")) != EOF) {
+    while ((c = getopt(argc, argv, "a:d:f:c:g:L:M:R:s:t:v:w:hpOVABblDHISTz")) != EOF) {
         switch (c) {
 
         case 'A': /* Hidden Autolab driver argument */
@@ -397,6 +610,54 @@ int main(int argc, char **argv)
             debug_mode = DBG_EXPENSIVE;
             break;
 
+        case 'L': /* Load an mm malloc package from a shared object */
+            load_plugin(optarg);
+            break;
+
+        case 'M': /* Map the heap with options, and count page faults */
+            mem_set_options(parse_map_options(optarg));
+            fault_mode = true;
+            break;
+
+        case 'a': /* Allocate with memalign, and check the alignment */
+            payload_align = strtoul(optarg, NULL, 0);
+            if (payload_align < ALIGNMENT || (payload_align & (payload_align - 1)) != 0)
+                app_error("-a needs a power of two of at least %d\n", ALIGNMENT);
+            break;
+
+        case 'w': /* Write and read part of each payload while timing */
+            touch_percent = atoi(optarg);
+            if (touch_percent < 1 || touch_percent > 100)
+                app_error("-w needs a percentage from 1 to 100\n");
+            break;
+
+        case 'z': /* Free with mm_free_sized, and check mm_usable_size */
+            sized_free = true;
+            break;
+
+        case 'b': /* Run the stress-pattern traces instead of the defaults */
+            bench_traces = true;
+            break;
+
+        case 'B': /* Batch runs of allocs and frees */
+            batch_mode = true;
+            break;
+
+        case 'R': /* Allocate from arenas, resetting each once it's all freed */
+            arena_objs = atoi(optarg);
+            if (arena_objs <= 0)
+                app_error("-R needs a positive number of payloads\n");
+            break;
+
+        case 'H': /* Find overlapping payloads with a shadow bitmap */
+            shadow_mode = true;
+            break;
+
+        case 'I': /* Like -D, but check only what each op touched */
+            debug_mode = DBG_EXPENSIVE;
+            incremental = true;
+            break;
+
         case 's':
             set_timeout = atoi(optarg);
             break;
@@ -405,6 +666,16 @@ int main(int argc, char **argv)
             tab_mode = true;
             break;
 
+        case 'S': /* Stream traces from disk rather than reading them in */
+            stream_mode = true;
+            break;
+
+        case 'g': /* Write a fragmentation time series for each trace */
+            frag_interval = atoi(optarg);
+            if (frag_interval <= 0)
+                app_error("-g needs a positive number of ops\n");
+            break;
+
         case 'h': /* Print this message */
             usage(argv[0]);
             exit(0);
@@ -418,20 +689,57 @@ int main(int argc, char **argv)
 
     if (num_global_tracefiles == 0) {
         int i;
-        for (i = 0; default_tracefiles[i]; i++)
-            add_tracefile(default_tracefiles[i]);
+        char **tracefiles = bench_traces ? bench_tracefiles : default_tracefiles;
+        for (i = 0; tracefiles[i]; i++)
+            add_tracefile(tracefiles[i]);
     }
 
     if (debug_mode != DBG_NONE) {
         init_random_data();
     }
 
+    if (shadow_mode && sparse_mode)
+        app_error("-H needs a dense heap\n");
+    if (payload_align && sized_free)
+        app_error("-a and -z don't mix: memalign payloads are freed with free\n");
+    if (payload_align && batch_mode)
+        app_error("-a and -B don't mix: mm_malloc_batch doesn't align\n");
+    if (arena_objs && (payload_align || sized_free || batch_mode))
+        app_error("-R doesn't mix with -a, -z or -B: arena payloads are only allocated one way\n");
+    if (touch_percent && (payload_align || sized_free || batch_mode || arena_objs || stream_mode))
+        app_error("-w only works with the replay kernel, not with -a, -z, -B, -R or -S\n");
+
+    for (i = 0; i < num_plugins; i++) {
+        if (frag_interval > 0 && plugins[i].free_stats == NULL)
+            app_error("-g needs mm_free_stats, which %s doesn't export\n",
+                      plugins[i].name);
+        if (payload_align && plugins[i].memalign == NULL)
+            app_error("-a needs mm_memalign, which %s doesn't export\n",
+                      plugins[i].name);
+        if (sized_free && (plugins[i].free_sized == NULL || plugins[i].usable_size == NULL))
+            app_error("-z needs mm_free_sized and mm_usable_size, which %s doesn't export\n",
+                      plugins[i].name);
+        if (batch_mode && (plugins[i].malloc_batch == NULL || plugins[i].free_batch == NULL))
+            app_error("-B needs mm_malloc_batch and mm_free_batch, which %s doesn't export\n",
+                      plugins[i].name);
+        if (arena_objs && (plugins[i].arena_create == NULL || plugins[i].arena_alloc == NULL ||
+                           plugins[i].arena_reset == NULL || plugins[i].arena_destroy == NULL))
+            app_error("-R needs the mm_arena functions, which %s doesn't export\n",
+                      plugins[i].name);
+    }
+
     /* Initialize the timeout */
     if (set_timeout > 0) {
         signal(SIGALRM, timeout_handler);
         alarm(set_timeout);
     }
 
+    /* With no -L, run the package linked into the driver */
+    if (num_plugins == 0) {
+        plugins = &linked_mm;
+        num_plugins = 1;
+    }
+
     /*
      * Optionally run and evaluate the libc malloc package
      */
@@ -441,21 +749,46 @@ int main(int argc, char **argv)
 
         /* Allocate libc stats array, with one stats_t struct per tracefile */
         libc_stats = (stats_t *)calloc(num_global_tracefiles, sizeof(stats_t));
-        if (libc_stats == NULL)
+        mm_rss_kb = (long *)calloc(num_global_tracefiles, sizeof(long));
+        if (libc_stats == NULL || mm_rss_kb == NULL)
             unix_error("libc_stats calloc in main failed");
 
         /* Evaluate the libc malloc package using the K-best scheme */
         for (i=0; i < num_global_tracefiles; i++) {
-            trace_t *trace = read_trace(&libc_stats[i], tracedir, global_tracefiles[i]);
+            trace_t *trace = open_trace(&libc_stats[i], tracedir, global_tracefiles[i]);
 
             if (verbose > 1)
                 printf("Checking libc malloc for correctness, ");
             libc_stats[i].valid = eval_libc_valid(trace);
+            libc_stats[i].rss_kb = -1;
+            mm_rss_kb[i] = -1;
             if (libc_stats[i].valid) {
                 speed_params.trace = trace;
                 if (verbose > 1)
                     printf("and performance.\n");
-                libc_stats[i].secs = fsec(eval_libc_speed, &speed_params);
+                libc_stats[i].secs = trace->stream ?
+                    time_stream(eval_libc_speed, &speed_params) :
+                    time_replay(eval_libc_speed, &speed_params);
+                libc_stats[i].tput = libc_stats[i].ops / (libc_stats[i].secs * 1000.0);
+                if (!trace->stream) {
+#ifdef __GLIBC__
+                    /* Hand the pages freed by the replays back to the system */
+                    malloc_trim(0);
+#endif
+                    libc_stats[i].rss_kb = rss_growth(eval_libc_speed, &speed_params);
+
+                    /*
+                     * Measure the mm package on the same trace now, while
+                     * the driver is small: mem_sbrk grows the real break
+                     * as well, and after the mm runs a fork may not fit
+                     */
+                    if (!sparse_mode) {
+                        mm = &plugins[0];
+                        mem_init(sparse_mode);
+                        mm_rss_kb[i] = rss_growth(eval_mm_speed, &speed_params);
+                        mem_deinit();
+                    }
+                }
             }
             free_trace(trace);
         }
@@ -474,13 +807,40 @@ int main(int argc, char **argv)
     if (verbose > 1)
         printf("\nTesting mm malloc\n");
 
-    /* Allocate the mm stats array, with one stats_t struct per tracefile */
-    mm_stats = (stats_t *)calloc(num_global_tracefiles, sizeof(stats_t));
-    if (mm_stats == NULL)
-        unix_error("mm_stats calloc in main failed");
+    /* Run each package in turn, on the same traces and heap addresses */
+    stats_t **plugin_stats = (stats_t **)calloc(num_plugins, sizeof(stats_t *));
+    if (plugin_stats == NULL)
+        unix_error("plugin_stats calloc in main failed");
+    for (i = 0; i < num_plugins; i++) {
+        mm = &plugins[i];
+        if (verbose > 1 && num_plugins > 1)
+            printf("\nTesting %s\n", mm->name);
+
+        /* Allocate the mm stats array, with one stats_t struct per tracefile */
+        plugin_stats[i] = (stats_t *)calloc(num_global_tracefiles, sizeof(stats_t));
+        if (plugin_stats[i] == NULL)
+            unix_error("mm_stats calloc in main failed");
+
+        run_tests(num_global_tracefiles, tracedir, global_tracefiles,
+                  plugin_stats[i], &speed_params);
+
+        if (verbose && num_plugins > 1 && !onetime_flag) {
+            printf("\nResults for %s:\n", mm->name);
+            /* Only the first package is compared with libc */
+            sum_stats_t sums;
+            printresults(num_global_tracefiles, plugin_stats[i],
+                         i == 0 ? &global_mm_sum_stats : &sums);
+        }
+    }
 
-    run_tests(num_global_tracefiles, tracedir, global_tracefiles, mm_stats,
-              &speed_params);
+    /* The rest of the report and the score are for the first package */
+    mm = &plugins[0];
+    mm_stats = plugin_stats[0];
+    if (num_plugins > 1 && !onetime_flag) {
+        printf("\nSide by side:\n");
+        print_comparison(num_global_tracefiles, plugin_stats);
+        printf("\nScoring %s\n", mm->name);
+    }
 
 
     /* Display the mm results in a compact table */
@@ -493,20 +853,28 @@ int main(int argc, char **argv)
             } else {
                 printf(" => incorrect.\n\n");
             }
-        } else {
-            printf("\nResults for mm malloc:\n");
+        } else if (num_plugins == 1) {
+            if (touch_percent)
+                printf("\nResults for mm malloc, touching %d%% of each payload:\n",
+                       touch_percent);
+            else
+                printf("\nResults for mm malloc:\n");
             printresults(num_global_tracefiles, mm_stats, &global_mm_sum_stats);
             printf("\n");
         }
     }
 
     /* Optionally compare the performance of mm and libc */
-    if (run_libc) {
-        printf("Comparison with libc malloc: mm/libc = %.0f Kops / %.0f Kops = %.2f\n",
-               (float)global_mm_sum_stats.tput, (float)global_libc_sum_stats.tput,
-               (float)(global_mm_sum_stats.tput/global_libc_sum_stats.tput));
+    if (run_libc && !onetime_flag) {
+        for (i = 0; i < num_global_tracefiles; i++)
+            mm_stats[i].rss_kb = mm_rss_kb[i];
+        print_libc_comparison(num_global_tracefiles, mm_stats, libc_stats);
     }
 
+    /* Optionally report the page faults of mm */
+    if (fault_mode && !onetime_flag)
+        print_faults(num_global_tracefiles, mm_stats);
+
     /*
      * Accumulate the aggregate statistics for the student's mm package
      */
@@ -655,6 +1023,54 @@ static void add_tracefile(char *trace) {
     global_tracefiles[num_global_tracefiles++] = strdup(trace);
 }
 
+/*
+ * load_plugin - Load an mm malloc package built as a shared object
+ *     ("make plugins").  The object's calls to mem_sbrk and friends
+ *     resolve to the driver's memlib, so every package runs on the same
+ *     simulated heap at the same addresses.
+ */
+static void load_plugin(const char *path) {
+    package_t *pkg;
+    void *handle;
+    const char *base;
+
+    /* dlopen only looks in the current directory for names with a '/' */
+    char name[MAXLINE];
+    snprintf(name, sizeof(name), "%s%s", strchr(path, '/') ? "" : "./", path);
+    if ((handle = dlopen(name, RTLD_NOW | RTLD_LOCAL)) == NULL)
+        app_error("Could not load %s: %s\n", path, dlerror());
+
+    plugins = realloc(plugins, (num_plugins+1) * sizeof(package_t));
+    if (plugins == NULL)
+        unix_error("realloc failed in load_plugin");
+    pkg = &plugins[num_plugins++];
+
+    base = strrchr(path, '/');
+    pkg->name = strdup(base ? base + 1 : path);
+    pkg->handle = handle;
+
+    /* The functions every package has, then the ones the driver can do without */
+    if ((pkg->init = (bool (*)(void)) dlsym(handle, "mm_init")) == NULL ||
+        (pkg->malloc = (void *(*)(size_t)) dlsym(handle, "mm_malloc")) == NULL ||
+        (pkg->free = (void (*)(void *)) dlsym(handle, "mm_free")) == NULL ||
+        (pkg->realloc = (void *(*)(void *, size_t)) dlsym(handle, "mm_realloc")) == NULL ||
+        (pkg->calloc = (void *(*)(size_t, size_t)) dlsym(handle, "mm_calloc")) == NULL ||
+        (pkg->checkheap = (bool (*)(int)) dlsym(handle, "mm_checkheap")) == NULL)
+        app_error("%s is not an mm malloc package: %s\n", path, dlerror());
+    pkg->checkheap_incremental = (bool (*)(int)) dlsym(handle, "mm_checkheap_incremental");
+    pkg->free_stats = (size_t (*)(size_t *, size_t *, size_t, size_t *))
+        dlsym(handle, "mm_free_stats");
+    pkg->memalign = (void *(*)(size_t, size_t)) dlsym(handle, "mm_memalign");
+    pkg->free_sized = (void (*)(void *, size_t)) dlsym(handle, "mm_free_sized");
+    pkg->usable_size = (size_t (*)(void *)) dlsym(handle, "mm_usable_size");
+    pkg->malloc_batch = (size_t (*)(size_t, size_t, void **)) dlsym(handle, "mm_malloc_batch");
+    pkg->free_batch = (void (*)(void **, size_t)) dlsym(handle, "mm_free_batch");
+    pkg->arena_create = (struct arena *(*)(size_t)) dlsym(handle, "mm_arena_create");
+    pkg->arena_alloc = (void *(*)(struct arena *, size_t)) dlsym(handle, "mm_arena_alloc");
+    pkg->arena_reset = (void (*)(struct arena *)) dlsym(handle, "mm_arena_reset");
+    pkg->arena_destroy = (void (*)(struct arena *)) dlsym(handle, "mm_arena_destroy");
+}
+
 
 
 /*****************************************************************
@@ -668,8 +1084,8 @@ static void add_tracefile(char *trace) {
  */
 static range_set_t *new_range_set() {
     range_set_t *ranges = (range_set_t *) malloc(sizeof(range_set_t));
-    ranges->list = NULL;
-    ranges->lo_tree = tree_new();
+    ranges->lo_tree = btree_new();
+    ranges->shadow = shadow_mode ? shadow_new(mem_heap_lo(), MAX_DENSE_HEAP) : NULL;
     return ranges;
 }
 
@@ -677,7 +1093,7 @@ static range_set_t *new_range_set() {
  * add_range - As directed by request opnum in trace tracenum,
  *     we've just called the student's mm_malloc to allocate a block of
  *     size bytes at addr lo. After checking the block for correctness,
- *     we create a range struct for this block and add it to the range list.
+ *     we add its range to the range set.
  */
 static bool add_range(range_set_t *ranges, char *lo, size_t size,
                       const trace_t *trace, int opnum, int index) {
@@ -705,61 +1121,58 @@ static bool add_range(range_set_t *ranges, char *lo, size_t size,
        just assume the overlap will be caught by writing random bits. */
     if (debug_mode == DBG_NONE) return 1;
 
-    /* Look in the tree for the predecessor block */
-    range_t *prev = tree_find_nearest(ranges->lo_tree, (long unsigned) lo);
-    range_t *next = prev ? prev->next : NULL;
+    bentry_t range = { (bkey_t) lo, (bkey_t) hi, index };
+
+    /* A live granule in the new payload belongs to another payload */
+    if (ranges->shadow) {
+        char *other = shadow_first_live(ranges->shadow, lo, size);
+        if (other) {
+            malloc_error(trace, opnum,
+                         "Payload (%p:%p) overlaps another payload at %p\n",
+                         lo, hi, other);
+            return false;
+        }
+        shadow_mark(ranges->shadow, lo, size);
+        if (debug_mode == DBG_EXPENSIVE)
+            btree_insert(ranges->lo_tree, &range);
+        return true;
+    }
+
+    /* Look in the tree for the predecessor and successor blocks */
+    const bentry_t *prev, *next;
+    btree_neighbors(ranges->lo_tree, (bkey_t) lo, &prev, &next);
     /* See if it overlaps previous or next blocks */
-    if (prev && lo <= prev->hi) {
+    if (prev && (bkey_t) lo <= prev->hi) {
         malloc_error(trace, opnum,
                      "Payload (%p:%p) overlaps another payload (%p:%p)\n",
-                     lo, hi, prev->lo, prev->hi);
+                     lo, hi, (void *) prev->key, (void *) prev->hi);
         return false;
     }
-    if (next && hi >= next->lo) {
+    if (next && (bkey_t) hi >= next->key) {
         malloc_error(trace, opnum,
                      "Payload (%p:%p) overlaps another payload (%p:%p)\n",
-                     lo, hi, next->lo, next->hi);
+                     lo, hi, (void *) next->key, (void *) next->hi);
         return false;
     }
-    /*
-     * Everything looks OK, so remember the extent of this block
-     * by creating a range struct and adding it the range list.
-     */
-    range_t *p;
-    if ((p = (range_t *)malloc(sizeof(range_t))) == NULL)
-        unix_error("malloc error in add_range");
-    p->prev = prev;
-    if (prev)
-        prev->next = p;
-    else
-        ranges->list = p;
-    p->next = next;
-    if (next)
-        next->prev = p;
-    p->lo = lo;
-    p->hi = hi;
-    p->index = index;
-    tree_insert(ranges->lo_tree, (long unsigned) lo, (void *) p);
+    /* Everything looks OK, so remember the extent of this block */
+    btree_insert(ranges->lo_tree, &range);
     return true;
 }
 
 /*
- * remove_range - Free the range record of block whose payload starts at lo
+ * remove_range - Forget the range of the size-byte block whose payload
+ *     starts at lo
  */
-static void remove_range(range_set_t *ranges, char *lo)
+static void remove_range(range_set_t *ranges, char *lo, size_t size)
 {
-    range_t *p = (range_t *) tree_remove(ranges->lo_tree, (long unsigned) lo);
-    if (!p)
-        return;
-    range_t *prev = p->prev;
-    range_t *next = p->next;
-    if (prev)
-        prev->next = next;
-    else
-        ranges->list = next;
-    if (next)
-        next->prev = prev;
-    free(p);
+    if (debug_mode == DBG_NONE)
+        return; /* add_range recorded nothing */
+    if (ranges->shadow) {
+        shadow_clear(ranges->shadow, lo, size);
+        if (debug_mode != DBG_EXPENSIVE)
+            return;
+    }
+    btree_remove(ranges->lo_tree, (bkey_t) lo, NULL);
 }
 
 /*
@@ -767,7 +1180,9 @@ static void remove_range(range_set_t *ranges, char *lo)
  */
 static void free_range_set(range_set_t *ranges)
 {
-    tree_free(ranges->lo_tree, free);
+    btree_free(ranges->lo_tree);
+    if (ranges->shadow)
+        shadow_free(ranges->shadow);
     free(ranges);
 }
 
@@ -788,7 +1203,7 @@ static void init_random_data(void) {
 
 static void randomize_block(trace_t *traces, int index) {
     size_t size, fsize;
-    size_t i;
+    size_t i, n, off;
     randint_t *block;
     int base;
 
@@ -805,21 +1220,22 @@ static void randomize_block(trace_t *traces, int index) {
         fsize = maxfill;
     base = traces->block_rand_base[index];
 
-    // NOTE: It's expensive to do this one byte at a time.
-
     // NOTE: It would be nice to also fill in at end of block, but
     // this gets messy with REALLOC
 
-    for(i = 0; i < fsize; i++) {
-        mem_write(&block[i],
-                  random_data[(base + i) % RANDOM_DATA_LEN],
-                  sizeof(randint_t));
+    /* Copy in segments, wrapping around the end of random_data */
+    off = base % RANDOM_DATA_LEN;
+    for(i = 0; i < fsize; i += n, off = 0) {
+        n = fsize - i;
+        if (n > RANDOM_DATA_LEN - off)
+            n = RANDOM_DATA_LEN - off;
+        mem_write_bytes(&block[i], &random_data[off], n * sizeof(randint_t));
     }
 }
 
 static bool check_index(const trace_t *trace, int opnum, int index) {
     size_t size, fsize;
-    size_t i;
+    size_t i, n, off;
     randint_t *block;
     int base;
     int ngarbled = 0;
@@ -840,11 +1256,23 @@ static bool check_index(const trace_t *trace, int opnum, int index) {
 
     base = trace->block_rand_base[index];
 
-    // NOTE: It's expensive to do this one byte at a time.
-    for(i = 0; i < fsize; i++) {
-        if (mem_read(&block[i], sizeof(randint_t)) != random_data[(base + i) % RANDOM_DATA_LEN]) {
-            if (firstgarbled == -1) firstgarbled = i;
-            ngarbled++;
+    /* Compare in segments, as randomize_block wrote them, until a
+       garbled byte turns up */
+    off = base % RANDOM_DATA_LEN;
+    for(i = 0; i < fsize && firstgarbled == -1; i += n, off = 0) {
+        n = fsize - i;
+        if (n > RANDOM_DATA_LEN - off)
+            n = RANDOM_DATA_LEN - off;
+        size_t m = mem_mismatch(&block[i], &random_data[off], n * sizeof(randint_t));
+        if (m < n * sizeof(randint_t))
+            firstgarbled = i + m / sizeof(randint_t);
+    }
+
+    /* Only a bad block is worth counting one byte at a time */
+    if (firstgarbled != -1) {
+        for(i = firstgarbled; i < fsize; i++) {
+            if (mem_read(&block[i], sizeof(randint_t)) != random_data[(base + i) % RANDOM_DATA_LEN])
+                ngarbled++;
         }
     }
     if (ngarbled != 0) {
@@ -856,6 +1284,42 @@ static bool check_index(const trace_t *trace, int opnum, int index) {
     return true;
 }
 
+/*
+ * check_neighbors - With incremental checking, check the data of the
+ *     blocks on either side of address lo, which is not in the range set.
+ *     These are the blocks that splitting or coalescing the block at lo
+ *     could have overwritten.
+ */
+static bool check_neighbors(const trace_t *trace, range_set_t *ranges,
+                            int opnum, char *lo) {
+    const bentry_t *prev, *next;
+    bool ok = true;
+
+    if (debug_mode != DBG_EXPENSIVE || !incremental) return true;
+
+    btree_neighbors(ranges->lo_tree, (bkey_t) lo, &prev, &next);
+    if (prev && !check_index(trace, opnum, prev->index))
+        ok = false;
+    if (next && !check_index(trace, opnum, next->index))
+        ok = false;
+    return ok;
+}
+
+/*
+ * check_all - Check the data of every allocated block
+ */
+static bool check_all(const trace_t *trace, range_set_t *ranges, int opnum) {
+    const bentry_t *r;
+    biter_t it;
+    bool ok = true;
+
+    for (r = btree_first(ranges->lo_tree, &it); r; r = btree_next(&it)) {
+        if (!check_index(trace, opnum, r->index))
+            ok = false;
+    }
+    return ok;
+}
+
 /**********************************************
  * The following routines manipulate tracefiles
  *********************************************/
@@ -904,6 +1368,15 @@ static trace_t *read_trace(stats_t *stats, const char *tracedir,
          (traceop_t *)malloc(trace->num_ops * sizeof(traceop_t))) == NULL)
         unix_error("malloc 2 failed in read_trace");
 
+    /* ... and again as parallel arrays for the replay kernel */
+    trace->arrays.type = malloc(trace->num_ops * sizeof(*trace->arrays.type));
+    trace->arrays.index = malloc((trace->num_ops + REPLAY_AHEAD) *
+                                 sizeof(*trace->arrays.index));
+    trace->arrays.size = malloc(trace->num_ops * sizeof(*trace->arrays.size));
+    if (trace->arrays.type == NULL || trace->arrays.index == NULL ||
+        trace->arrays.size == NULL)
+        unix_error("malloc 2 failed in read_trace");
+
     /* We'll keep an array of pointers to the allocated blocks here... */
     if ((trace->blocks =
          (char **)calloc(trace->num_ids, sizeof(char *))) == NULL)
@@ -919,6 +1392,11 @@ static trace_t *read_trace(stats_t *stats, const char *tracedir,
          calloc(trace->num_ids, sizeof(*trace->block_rand_base))) == NULL)
         unix_error("malloc 5 failed in read_trace");
 
+    /* and, under -R, the arena each block came from */
+    if ((trace->block_arenas =
+         calloc(trace->num_ids, sizeof(*trace->block_arenas))) == NULL)
+        unix_error("malloc 6 failed in read_trace");
+
 
     /* read every request line in the trace file */
     index = 0;
@@ -955,11 +1433,23 @@ static trace_t *read_trace(stats_t *stats, const char *tracedir,
     assert(max_index == trace->num_ids - 1);
     assert(trace->num_ops == op_index);
 
+    for (op_index = 0; op_index < trace->num_ops; op_index++) {
+        trace->arrays.type[op_index] = trace->ops[op_index].type;
+        trace->arrays.index[op_index] = trace->ops[op_index].index;
+        trace->arrays.size[op_index] = trace->ops[op_index].type == FREE ?
+            0 : trace->ops[op_index].size;
+    }
+    for (; op_index < trace->num_ops + REPLAY_AHEAD; op_index++)
+        trace->arrays.index[op_index] = -1;
+
     /* fill in the stats */
     strcpy(stats->filename, trace->filename);
     stats->weight = trace->weight;
     stats->ops = trace->num_ops;
 
+    trace->stream = NULL;
+    trace->op_base = 0;
+    trace->ops_done = false;
     return trace;
 }
 
@@ -974,259 +1464,1012 @@ static void reinit_trace(trace_t *trace)
 }
 
 /*
- * free_trace - Free the trace record and the four arrays it points
- *              to, all of which were allocated in read_trace().
+ * free_trace - Free the trace record and the arrays it points to,
+ *              all of which were allocated in read_trace().
  */
 static void free_trace(trace_t *trace)
 {
-    free(trace->ops);         /* free the three arrays... */
+    if (trace->stream)
+        close_stream(trace->stream);
+    free(trace->ops);         /* free the arrays... */
+    free(trace->arrays.type);
+    free(trace->arrays.index);
+    free(trace->arrays.size);
     free(trace->blocks);
     free(trace->block_sizes);
     free(trace->block_rand_base);
+    free(trace->block_arenas);
     free(trace);              /* and the trace record itself... */
 }
 
 /**********************************************************************
- * The following functions evaluate the correctness, space utilization,
- * and throughput of the libc and mm malloc packages.
- **********************************************************************/
+ * The following routines stream a trace from disk in chunks (-S)
+ *********************************************************************/
 
 /*
- * eval_mm_valid - Check the mm malloc package for correctness
+ * read_op - Parse one request from a streamed trace.  Returns false at
+ *     the end of the file.  Uses getc_unlocked since the reader thread
+ *     must keep ahead of the replay.
  */
-static bool eval_mm_valid(trace_t *trace, range_set_t *ranges)
+static bool read_op(FILE *f, char *type, long *id, size_t *size)
 {
-    int i;
-    int index;
-    size_t size;
-    char *newp;
-    char *oldp;
-    char *p;
-    bool allCheck = true;
-
-    /* Reset the heap and free any records in the range list */
-    mem_reset_brk();
-    reinit_trace(trace);
-
-    /* Call the mm package's init function */
-    if (!mm_init()) {
-        malloc_error(trace, 0, "mm_init failed.");
+    int c;
+    do {
+        c = getc_unlocked(f);
+    } while (c == ' ' || c == '\n' || c == '\r' || c == '\t');
+    if (c == EOF)
         return false;
-    }
-
-    /* Interpret each operation in the trace in order */
-    for (i = 0;  i < trace->num_ops;  i++) {
-        index = trace->ops[i].index;
-        size = trace->ops[i].size;
-
-        if (debug_mode == DBG_EXPENSIVE) {
-            range_t *r;
-
-            /* Let the students check their own heap */
-            if (!mm_checkheap(0)) {
-                malloc_error(trace, i, "mm_checkheap returned false\n");
-                return false;
-            };
-
-            /* Now check that all our allocated blocks have the right data */
-            r = ranges->list;
-            while (r) {
-                if (!check_index(trace, i, r->index))
-                {
-                    allCheck = false;
-                }
-                r = r->next;
-            }
+    *type = c;
+
+    long v = 0;
+    int fields = (c == 'f') ? 1 : 2;
+    for (int k = 0; k < fields; k++) {
+        do {
+            c = getc_unlocked(f);
+        } while (c == ' ' || c == '\t');
+        bool neg = (c == '-');
+        if (neg)
+            c = getc_unlocked(f);
+        if (c < '0' || c > '9')
+            app_error("Bogus request (%c) in streamed tracefile\n", *type);
+        v = 0;
+        while (c >= '0' && c <= '9') {
+            v = 10 * v + (c - '0');
+            c = getc_unlocked(f);
         }
+        if (neg)
+            v = -v;
+        if (k == 0)
+            *id = v;
+        else
+            *size = v;
+    }
+    return true;
+}
 
-        switch (trace->ops[i].type) {
-
-        case ALLOC: /* mm_malloc */
-
-            /* Call the student's malloc */
-            if ((p = mm_malloc(size)) == NULL) {
-                malloc_error(trace, i, "mm_malloc failed.");
-                return false;
-            }
+static size_t hash_id(long id) {
+    uint64_t h = (uint64_t) id * 0x9E3779B97F4A7C15ull;
+    return (size_t) (h ^ (h >> 29));
+}
 
-            /*
-             * Test the range of the new block for correctness and add it
-             * to the range list if OK. The block must be  be aligned properly,
-             * and must not overlap any currently allocated block.
-             */
-            if (add_range(ranges, p, size, trace, i, index) == 0)
-                return false;
+static slotmap_t *slotmap_find(stream_t *st, long id) {
+    size_t i = hash_id(id) & st->map_mask;
+    while (st->map[i].id != -1) {
+        if (st->map[i].id == id)
+            return &st->map[i];
+        i = (i + 1) & st->map_mask;
+    }
+    return NULL;
+}
 
-            /* Remember region */
-            trace->blocks[index] = p;
-            trace->block_sizes[index] = size;
+static void slotmap_insert(stream_t *st, long id, int slot) {
+    if (2 * (st->map_count + 1) > st->map_mask + 1) {
+        /* Grow the table and rehash the live ids */
+        slotmap_t *old = st->map;
+        size_t old_capacity = st->map_mask + 1;
+        st->map_mask = 2 * old_capacity - 1;
+        if ((st->map = malloc(2 * old_capacity * sizeof(slotmap_t))) == NULL)
+            unix_error("malloc failed in slotmap_insert");
+        for (size_t i = 0; i <= st->map_mask; i++)
+            st->map[i].id = -1;
+        st->map_count = 0;
+        for (size_t i = 0; i < old_capacity; i++)
+            if (old[i].id != -1)
+                slotmap_insert(st, old[i].id, old[i].slot);
+        free(old);
+    }
+    size_t i = hash_id(id) & st->map_mask;
+    while (st->map[i].id != -1)
+        i = (i + 1) & st->map_mask;
+    st->map[i].id = id;
+    st->map[i].slot = slot;
+    st->map_count++;
+}
 
-            /* Set to random data, for debugging. */
-            randomize_block(trace, index);
+/* Remove an entry, shifting later entries back to keep probe chains intact */
+static void slotmap_remove(stream_t *st, slotmap_t *e) {
+    size_t i = e - st->map;
+    size_t j = i;
+    for (;;) {
+        j = (j + 1) & st->map_mask;
+        if (st->map[j].id == -1)
             break;
+        size_t home = hash_id(st->map[j].id) & st->map_mask;
+        if ((j > i && (home <= i || home > j)) ||
+            (j < i && (home <= i && home > j))) {
+            st->map[i] = st->map[j];
+            i = j;
+        }
+    }
+    st->map[i].id = -1;
+    st->map_count--;
+}
 
-        case REALLOC: /* mm_realloc */
-            if (!check_index(trace, i, index))
-            {
-                allCheck = false;
-            }
-
-            /* Call the student's realloc */
-            oldp = trace->blocks[index];
-            newp = mm_realloc(oldp, size);
-            if ( (newp == NULL) && (size != 0) ) {
-                malloc_error(trace, i, "mm_realloc failed.");
-                return false;
-            }
-            if ( (newp != NULL) && (size == 0) ) {
-                malloc_error(trace, i, "mm_realloc with size 0 returned "
-                             "non-NULL.");
-                return false;
-            }
-
-            /* Remove the old region from the range list */
-            remove_range(ranges, oldp);
-
-            /* Check new block for correctness and add it to range list */
-            if (size > 0) {
-                if (add_range(ranges, newp, size, trace, i, index) == 0)
-                    return false;
-            }
-
-
-            /* Move the region from where it was.
-             * Check up to min(size, oldsize) for correct copying. */
-            trace->blocks[index] = newp;
-            if (size < trace->block_sizes[index]) {
-                trace->block_sizes[index] = size;
-            }
-            // NOTE: Might help to pass old size here to check bytes at each end of allocation
+/* Map a trace id to a slot, taking a free slot if the id is new */
+static int acquire_slot(stream_t *st, long id) {
+    slotmap_t *e = slotmap_find(st, id);
+    if (e)
+        return e->slot;
+    int slot = st->num_free > 0 ? st->free_slots[--st->num_free] : st->num_slots++;
+    slotmap_insert(st, id, slot);
+    return slot;
+}
 
-            if (!check_index(trace, i, index))
-            {
-                allCheck = false;
-            }
-            trace->block_sizes[index] = size;
+static int release_slot(stream_t *st, long id) {
+    slotmap_t *e = slotmap_find(st, id);
+    if (e == NULL)
+        app_error("free of unallocated id %ld in streamed tracefile\n", id);
+    int slot = e->slot;
+    slotmap_remove(st, e);
+    if (st->num_free == st->free_capacity) {
+        st->free_capacity = st->free_capacity ? 2 * st->free_capacity : 1024;
+        st->free_slots = realloc(st->free_slots, st->free_capacity * sizeof(int));
+        if (st->free_slots == NULL)
+            unix_error("realloc failed in release_slot");
+    }
+    st->free_slots[st->num_free++] = slot;
+    return slot;
+}
 
-            /* Set to random data, for debugging. */
-            randomize_block(trace, index);
+/*
+ * fill_chunk - Parse up to STREAM_CHUNK_OPS ops into chunk, translating
+ *     trace ids into recycled slots.  Returns false at the end of the file.
+ */
+static bool fill_chunk(stream_t *st, chunk_t *chunk)
+{
+    char type;
+    long id = 0;
+    size_t size = 0;
+    int n = 0;
+
+    while (n < STREAM_CHUNK_OPS && read_op(st->file, &type, &id, &size)) {
+        traceop_t *op = &chunk->ops[n++];
+        switch (type) {
+        case 'a':
+            op->type = ALLOC;
+            op->index = acquire_slot(st, id);
+            op->size = size;
             break;
-
-        case FREE: /* mm_free */
-            if (!check_index(trace, i, index))
-            {
-                allCheck = false;
-            }
-
-            /* Remove region from list and call student's free function */
-            if (index == -1) {
-                p = 0;
-            } else {
-                p = trace->blocks[index];
-                remove_range(ranges, p);
-            }
-            mm_free(p);
+        case 'r':
+            op->type = REALLOC;
+            op->index = acquire_slot(st, id);
+            op->size = size;
+            /* realloc to 0 frees the block */
+            if (size == 0)
+                release_slot(st, id);
+            break;
+        case 'f':
+            op->type = FREE;
+            /* id -1 is the null pointer */
+            op->index = (id == -1) ? -1 : release_slot(st, id);
+            op->size = 0;
             break;
-
         default:
-            app_error("Nonexistent request type in eval_mm_valid");
+            app_error("Bogus type character (%c) in streamed tracefile\n", type);
         }
     }
-    /* As far as we know, this is a valid malloc package */
-    return allCheck;
+    chunk->num_ops = n;
+    chunk->num_slots = st->num_slots;
+    return n == STREAM_CHUNK_OPS;
 }
 
-/*
- * eval_mm_util - Evaluate the space utilization of the student's package
- *   The idea is to remember the high water mark "hwm" of the heap for
- *   an optimal allocator, i.e., no gaps and no internal fragmentation.
- *   Utilization is the ratio hwm/heapsize, where heapsize is the
- *   size of the heap in bytes after running the student's malloc
- *   package on the trace. Note that our implementation of mem_sbrk()
- *   doesn't allow the students to decrement the brk pointer, so brk
- *   is always the high water mark of the heap.
- *
- *   A higher number is better: 1 is optimal.
- */
-static double eval_mm_util(trace_t *trace, int tracenum)
+static void *stream_reader(void *arg)
 {
-    int i;
-    int index;
-    size_t size, newsize, oldsize;
-    size_t max_total_size = 0;
-    size_t total_size = 0;
-    char *p;
-    char *newp, *oldp;
+    stream_t *st = (stream_t *) arg;
+    bool more = true;
+
+    while (more) {
+        chunk_t *chunk = &st->chunks[st->fill];
+
+        /* Wait for the replay to be done with this chunk */
+        pthread_mutex_lock(&st->lock);
+        while (chunk->full && !st->stop)
+            pthread_cond_wait(&st->cond, &st->lock);
+        bool stop = st->stop;
+        pthread_mutex_unlock(&st->lock);
+        if (stop)
+            break;
 
-    reinit_trace(trace);
+        more = fill_chunk(st, chunk);
 
-    /* initialize the heap and the mm malloc package */
-    mem_reset_brk();
-    if (!mm_init())
-        app_error("trace %d: mm_init failed in eval_mm_util", tracenum);
+        pthread_mutex_lock(&st->lock);
+        chunk->full = true;
+        st->done = !more;
+        pthread_cond_broadcast(&st->cond);
+        pthread_mutex_unlock(&st->lock);
+        st->fill ^= 1;
+    }
+    return NULL;
+}
 
-    for (i = 0;  i < trace->num_ops;  i++) {
-        switch (trace->ops[i].type) {
+/* Stop the reader thread, if one is running */
+static void stop_reader(stream_t *st)
+{
+    pthread_mutex_lock(&st->lock);
+    st->stop = true;
+    pthread_cond_broadcast(&st->cond);
+    pthread_mutex_unlock(&st->lock);
+    pthread_join(st->reader, NULL);
+}
 
-        case ALLOC: /* mm_alloc */
-            index = trace->ops[i].index;
-            size = trace->ops[i].size;
+/*
+ * restart_stream - Go back to the first op and start a new reader
+ *     thread with an empty id table.
+ */
+static void restart_stream(stream_t *st)
+{
+    stop_reader(st);
+    if (fseek(st->file, st->data_start, SEEK_SET) != 0)
+        unix_error("fseek failed in restart_stream");
+    for (size_t i = 0; i <= st->map_mask; i++)
+        st->map[i].id = -1;
+    st->map_count = 0;
+    st->num_free = 0;
+    st->num_slots = 0;
+    st->chunks[0].full = st->chunks[1].full = false;
+    st->fill = st->drain = 0;
+    st->holding = st->done = st->stop = false;
+    if (pthread_create(&st->reader, NULL, stream_reader, st) != 0)
+        unix_error("pthread_create failed in restart_stream");
+}
 
-            if ((p = mm_malloc(size)) == NULL) {
-                app_error("trace %d: mm_malloc failed in eval_mm_util",
-                          tracenum);
-            }
+static void close_stream(stream_t *st)
+{
+    stop_reader(st);
+    fclose(st->file);
+    pthread_mutex_destroy(&st->lock);
+    pthread_cond_destroy(&st->cond);
+    free(st->chunks);
+    free(st->map);
+    free(st->free_slots);
+    free(st);
+}
 
-            /* Remember region and size */
-            trace->blocks[index] = p;
-            trace->block_sizes[index] = size;
+/*
+ * grow_blocks - Make room for num_slots blocks in the trace arrays,
+ *     which start out small and grow to the peak number of live blocks.
+ */
+static void grow_blocks(trace_t *trace, int num_slots)
+{
+    int old = trace->num_ids;
+    int n = old ? old : 1024;
+    while (n < num_slots)
+        n *= 2;
+    if ((trace->blocks = realloc(trace->blocks, n * sizeof(*trace->blocks))) == NULL ||
+        (trace->block_sizes = realloc(trace->block_sizes, n * sizeof(*trace->block_sizes))) == NULL ||
+        (trace->block_rand_base = realloc(trace->block_rand_base,
+                                          n * sizeof(*trace->block_rand_base))) == NULL ||
+        (trace->block_arenas = realloc(trace->block_arenas,
+                                       n * sizeof(*trace->block_arenas))) == NULL)
+        unix_error("realloc failed in grow_blocks");
+    memset(trace->blocks + old, 0, (n - old) * sizeof(*trace->blocks));
+    memset(trace->block_sizes + old, 0, (n - old) * sizeof(*trace->block_sizes));
+    trace->num_ids = n;
+}
 
-            total_size += size;
-            break;
+/*
+ * open_stream - Read the header of a trace and start streaming its ops.
+ *     Nothing but the header is read here; num_ids in the returned trace
+ *     is the size of the block arrays, not the number of ids in the file.
+ */
+static trace_t *open_stream(stats_t *stats, const char *tracedir,
+                            const char *filename)
+{
+    trace_t *trace;
+    stream_t *st;
+    int iweight, num_ids;
 
-        case REALLOC: /* mm_realloc */
-            index = trace->ops[i].index;
-            newsize = trace->ops[i].size;
-            oldsize = trace->block_sizes[index];
+    if (verbose > 1)
+        printf("Streaming tracefile: %s\n", filename);
 
-            oldp = trace->blocks[index];
-            if ((newp = mm_realloc(oldp,newsize)) == NULL && newsize != 0) {
-                app_error("trace %d: mm_realloc failed in eval_mm_util",
-                          tracenum);
-            }
+    if ((trace = (trace_t *) calloc(1, sizeof(trace_t))) == NULL ||
+        (st = (stream_t *) calloc(1, sizeof(stream_t))) == NULL ||
+        (st->chunks = (chunk_t *) calloc(2, sizeof(chunk_t))) == NULL)
+        unix_error("calloc failed in open_stream");
 
-            /* Remember region and size */
-            trace->blocks[index] = newp;
-            trace->block_sizes[index] = newsize;
+    strcpy(trace->filename, tracedir);
+    strcat(trace->filename, filename);
+    if ((st->file = fopen(trace->filename, "r")) == NULL)
+        unix_error("Could not open %s in open_stream", trace->filename);
+    if (fscanf(st->file, "%d %d %d %zd", &iweight, &num_ids,
+               &trace->num_ops, &trace->data_bytes) != 4)
+        app_error("%s: bad trace header\n", trace->filename);
+    if (iweight < 0 || iweight > 3)
+        app_error("%s: weight can only be in {0, 1, 2 3}", trace->filename);
+    trace->weight = iweight;
+    st->data_start = ftell(st->file);
 
-            total_size += (newsize - oldsize);
-            break;
+    st->map_mask = 1023;
+    if ((st->map = malloc((st->map_mask + 1) * sizeof(slotmap_t))) == NULL)
+        unix_error("malloc failed in open_stream");
+    for (size_t i = 0; i <= st->map_mask; i++)
+        st->map[i].id = -1;
+    pthread_mutex_init(&st->lock, NULL);
+    pthread_cond_init(&st->cond, NULL);
+    if (pthread_create(&st->reader, NULL, stream_reader, st) != 0)
+        unix_error("pthread_create failed in open_stream");
 
-        case FREE: /* mm_free */
-            index = trace->ops[i].index;
-            if (index < 0) {
-                size = 0;
-                p = 0;
-            } else {
-                size = trace->block_sizes[index];
-                p = trace->blocks[index];
-            }
+    trace->stream = st;
+    grow_blocks(trace, 1);
 
-            mm_free(p);
+    strcpy(stats->filename, trace->filename);
+    stats->weight = trace->weight;
+    stats->ops = trace->num_ops;
+    return trace;
+}
 
-            total_size -= size;
-            break;
+/*
+ * open_trace - Read a trace into memory, or start streaming it with -S
+ */
+static trace_t *open_trace(stats_t *stats, const char *tracedir,
+                           const char *filename)
+{
+    if (stream_mode)
+        return open_stream(stats, tracedir, filename);
+    return read_trace(stats, tracedir, filename);
+}
 
-        default:
-            app_error("trace %d: Nonexistent request type in eval_mm_util",
-                      tracenum);
-        }
+/*
+ * rewind_ops - Get ready to hand out the ops of a trace from the start
+ */
+static void rewind_ops(trace_t *trace)
+{
+    if (trace->stream)
+        restart_stream(trace->stream);
+    trace->ops_done = false;
+    trace->op_base = 0;
+}
 
-        /* update the high-water mark */
-        max_total_size = (total_size > max_total_size) ?
-            total_size : max_total_size;
+/*
+ * next_ops - Return the next batch of ops in the trace and store its
+ *     length in count, or return NULL when there are no more ops.  An
+ *     in-memory trace is a single batch.
+ */
+static traceop_t *next_ops(trace_t *trace, int *count)
+{
+    stream_t *st = trace->stream;
+
+    if (st == NULL) {
+        if (trace->ops_done)
+            return NULL;
+        trace->ops_done = true;
+        *count = trace->num_ops;
+        return trace->ops;
     }
 
+    pthread_mutex_lock(&st->lock);
+    if (st->holding) {
+        /* Give the previous chunk back to the reader */
+        trace->op_base += st->chunks[st->drain].num_ops;
+        st->chunks[st->drain].full = false;
+        st->drain ^= 1;
+        st->holding = false;
+        pthread_cond_broadcast(&st->cond);
+    }
+    chunk_t *chunk = &st->chunks[st->drain];
+    while (!chunk->full && !st->done)
+        pthread_cond_wait(&st->cond, &st->lock);
+    bool have = chunk->full && chunk->num_ops > 0;
+    st->holding = chunk->full;
+    pthread_mutex_unlock(&st->lock);
+
+    if (!have)
+        return NULL;
+    if (chunk->num_slots > trace->num_ids)
+        grow_blocks(trace, chunk->num_slots);
+    *count = chunk->num_ops;
+    return chunk->ops;
+}
+
+/*
+ * time_stream - Time a single run of f on a streamed trace.  Streamed
+ *     traces are too long for the repeated K-best measurements of fsec.
+ *     The timer measures this thread's CPU time, so time spent blocked
+ *     waiting for the reader thread is not counted.
+ */
+static double time_stream(test_funct f, void *args)
+{
+    start_timer();
+    f(args);
+    double secs = get_timer();
+    return secs > 0 ? secs : timer_resolution;
+}
+
+/**********************************************************************
+ * The following functions evaluate the correctness, space utilization,
+ * and throughput of the libc and mm malloc packages.
+ **********************************************************************/
+
+/*
+ * mm_alloc - The package's malloc, its memalign with -a, or an arena
+ *     alloc with -R, for the block with the given index
+ */
+static void *mm_alloc(trace_t *trace, int index, size_t size)
+{
+    if (payload_align)
+        return mm->memalign(payload_align, size);
+    if (arena_objs)
+        return arena_payload(trace, index, size);
+    return mm->malloc(size);
+}
+
+/*
+ * mm_release - The package's free, its free_sized with -z, or with -R
+ *     handing the block back to its arena
+ */
+static void mm_release(trace_t *trace, int index, void *p, size_t size)
+{
+    if (sized_free)
+        mm->free_sized(p, size);
+    else if (arena_objs) {
+        if (index >= 0)
+            arena_release(trace->block_arenas[index]);
+    } else
+        mm->free(p);
+}
+
+/*
+ * mm_resize - The package's realloc, or with -R a new arena payload
+ *     that the old one is copied to before it is handed back
+ */
+static void *mm_resize(trace_t *trace, int index, size_t size)
+{
+    char *oldp = trace->blocks[index];
+    size_t oldsize = trace->block_sizes[index];
+    int old_arena = trace->block_arenas[index];
+    char *newp = NULL;
+
+    if (!arena_objs)
+        return mm->realloc(oldp, size);
+    if (size > 0) {
+        if ((newp = arena_payload(trace, index, size)) == NULL)
+            return NULL;
+        if (oldp != NULL)
+            memcpy(newp, oldp, size < oldsize ? size : oldsize);
+    }
+    if (oldp != NULL)
+        arena_release(old_arena);
+    return newp;
+}
+
+/*
+ * Arenas (-R).  Allocs go to the newest arena until it has handed out
+ * arena_objs payloads.  Its payloads can't be freed one at a time, so a
+ * free only counts them down, and once they are all gone the arena is
+ * reset for a later run of allocs, or destroyed if MAX_IDLE_ARENAS are
+ * waiting already.  Any arenas left at the end of a trace are destroyed.
+ */
+#define MAX_IDLE_ARENAS 4
+
+typedef struct {
+    struct arena *arena;  /* NULL if the slot is spare and has none */
+    int allocs;           /* payloads handed out since it was reset */
+    int live;             /* the ones of those not freed yet */
+} arena_slot_t;
+
+static arena_slot_t *arena_slots;
+static int *spare_slots;      /* slots of reset arenas, or of none */
+static int num_arena_slots;
+static int num_spare_slots;
+static int idle_arenas;       /* reset arenas among the spare slots */
+static int cur_arena = -1;    /* slot allocs go to, -1 for the next spare */
+
+/*
+ * arena_payload - Allocate a payload for the block with the given index
+ *     from the newest arena, moving on to a spare one once it is full
+ */
+static void *arena_payload(trace_t *trace, int index, size_t size)
+{
+    arena_slot_t *slot;
+    void *p;
+
+    if (cur_arena < 0 && !next_arena())
+        return NULL;
+    slot = &arena_slots[cur_arena];
+    if ((p = mm->arena_alloc(slot->arena, size)) == NULL)
+        return NULL;
+    trace->block_arenas[index] = cur_arena;
+    slot->live++;
+    if (++slot->allocs == arena_objs)
+        cur_arena = -1;
+    return p;
+}
+
+/*
+ * arena_release - Count down the live payloads of the arena in a slot,
+ *     and reset or destroy it once they are all freed and it is full
+ */
+static void arena_release(int s)
+{
+    arena_slot_t *slot = &arena_slots[s];
+
+    if (--slot->live > 0 || s == cur_arena)
+        return;
+    if (idle_arenas < MAX_IDLE_ARENAS) {
+        mm->arena_reset(slot->arena);
+        idle_arenas++;
+    } else {
+        mm->arena_destroy(slot->arena);
+        slot->arena = NULL;
+    }
+    slot->allocs = 0;
+    spare_slots[num_spare_slots++] = s;
+}
+
+/*
+ * next_arena - Make a spare slot the one allocs go to, creating its
+ *     arena if it has none, or a new slot if there are no spares
+ */
+static bool next_arena(void)
+{
+    int s;
+
+    if (num_spare_slots == 0) {
+        s = num_arena_slots++;
+        if ((arena_slots = realloc(arena_slots, num_arena_slots * sizeof(*arena_slots))) == NULL ||
+            (spare_slots = realloc(spare_slots, num_arena_slots * sizeof(*spare_slots))) == NULL)
+            unix_error("realloc failed in next_arena");
+        arena_slots[s].arena = NULL;
+    } else
+        s = spare_slots[--num_spare_slots];
+
+    if (arena_slots[s].arena != NULL)
+        idle_arenas--;
+    else if ((arena_slots[s].arena = mm->arena_create(0)) == NULL)
+        return false;
+    arena_slots[s].allocs = 0;
+    arena_slots[s].live = 0;
+    cur_arena = s;
+    return true;
+}
+
+/*
+ * forget_arenas - Drop the slots of the last trace, whose arenas went
+ *     with the heap when it was reset
+ */
+static void forget_arenas(void)
+{
+    num_arena_slots = 0;
+    num_spare_slots = 0;
+    idle_arenas = 0;
+    cur_arena = -1;
+}
+
+/*
+ * destroy_arenas - Destroy the arenas still left at the end of a trace,
+ *     along with any payloads the trace didn't free
+ */
+static void destroy_arenas(void)
+{
+    int s;
+
+    for (s = 0; s < num_arena_slots; s++)
+        if (arena_slots[s].arena != NULL)
+            mm->arena_destroy(arena_slots[s].arena);
+    forget_arenas();
+}
+
+/*
+ * payload_extent - The bytes of an allocated payload that no other
+ *     payload may overlap: with -z, all that mm_usable_size says can be
+ *     used, after checking that it covers the size asked for
+ */
+static size_t payload_extent(void *p, size_t size)
+{
+    size_t usable;
+
+    if (!sized_free)
+        return size;
+    if ((usable = mm->usable_size(p)) < size)
+        return 0;
+    return usable;
+}
+
+/* Most ops handed to the package as one batch (-B) */
+#define MAX_BATCH 256
+
+static void *batch_ptrs[MAX_BATCH];
+
+/*
+ * batch_run - The number of ops from ops[i] on that -B hands to the
+ *     package as one batch: a run of allocs of the same size, or of
+ *     frees of allocated payloads.  1 without -B.
+ */
+static int batch_run(const traceop_t *ops, int i, int count)
+{
+    int n = 1;
+
+    if (!batch_mode || ops[i].type == REALLOC || ops[i].index < 0)
+        return 1;
+    while (i + n < count && n < MAX_BATCH && ops[i + n].type == ops[i].type &&
+           (ops[i].type == ALLOC ? ops[i + n].size == ops[i].size
+                                 : ops[i + n].index >= 0))
+        n++;
+    return n;
+}
+
+/*
+ * mm_alloc_batch - Allocate n payloads of the same size into batch_ptrs,
+ *     with the package's malloc_batch if there is more than one
+ */
+static bool mm_alloc_batch(trace_t *trace, const traceop_t *ops, size_t size, int n)
+{
+    if (n == 1)
+        return (batch_ptrs[0] = mm_alloc(trace, ops[0].index, size)) != NULL;
+    return mm->malloc_batch(size, n, batch_ptrs) == (size_t) n;
+}
+
+/*
+ * libc_alloc - libc's malloc, or its posix_memalign with -a
+ */
+static void *libc_alloc(size_t size)
+{
+    void *p;
+
+    if (!payload_align)
+        return malloc(size);
+    return posix_memalign(&p, payload_align, size) == 0 ? p : NULL;
+}
+
+/*
+ * eval_mm_valid - Check the mm malloc package for correctness
+ */
+static bool eval_mm_valid(trace_t *trace, range_set_t *ranges)
+{
+    int i;
+    traceop_t *ops;
+    int count;
+    int index;
+    int n, j;           /* ops in the batch under -B, and which one */
+    size_t size;
+    size_t extent;      /* bytes of the payload no other may overlap */
+    char *newp;
+    char *oldp;
+    char *p;
+    bool allCheck = true;
+
+    /* Reset the heap and free any records in the range list */
+    mem_reset_brk();
+    reinit_trace(trace);
+    if (ranges->shadow)
+        shadow_reset(ranges->shadow);
+
+    /* Call the mm package's init function */
+    if (!mm->init()) {
+        malloc_error(trace, 0, "mm_init failed.");
+        return false;
+    }
+    forget_arenas();
+
+    /* Interpret each operation in the trace in order */
+    rewind_ops(trace);
+    while ((ops = next_ops(trace, &count)) != NULL) {
+        for (i = 0;  i < count;  i++) {
+            int opnum = trace->op_base + i;
+            index = ops[i].index;
+            size = ops[i].size;
+
+            if (debug_mode == DBG_EXPENSIVE && incremental) {
+                /* Let the students check what changed in their heap */
+                if (!(mm->checkheap_incremental ? mm->checkheap_incremental(0)
+                                                : mm->checkheap(0))) {
+                    malloc_error(trace, opnum, "mm_checkheap_incremental returned false\n");
+                    return false;
+                }
+            } else if (debug_mode == DBG_EXPENSIVE) {
+                /* Let the students check their own heap */
+                if (!mm->checkheap(0)) {
+                    malloc_error(trace, opnum, "mm_checkheap returned false\n");
+                    return false;
+                };
+
+                /* Now check that all our allocated blocks have the right data */
+                if (!check_all(trace, ranges, opnum))
+                {
+                    allCheck = false;
+                }
+            }
+
+            switch (ops[i].type) {
+
+            case ALLOC: /* mm_malloc, or mm_malloc_batch for a run of them */
+
+                /* Call the student's malloc */
+                n = batch_run(ops, i, count);
+                if (!mm_alloc_batch(trace, &ops[i], size, n)) {
+                    malloc_error(trace, opnum, n > 1 ? "mm_malloc_batch failed."
+                                                     : "mm_malloc failed.");
+                    return false;
+                }
+
+                for (j = 0; j < n; j++) {
+                    opnum = trace->op_base + i + j;
+                    index = ops[i + j].index;
+                    p = batch_ptrs[j];
+
+                    /* With -a, to the alignment asked of memalign */
+                    if (payload_align && ((unsigned long) p) % payload_align != 0) {
+                        malloc_error(trace, opnum,
+                                     "Payload address (%p) not aligned to %zu bytes",
+                                     p, payload_align);
+                        return false;
+                    }
+
+                    /* Placing the new block may have overwritten its neighbors */
+                    if (!check_neighbors(trace, ranges, opnum, p))
+                    {
+                        allCheck = false;
+                    }
+
+                    /*
+                     * Test the range of the new block for correctness and add it
+                     * to the range list if OK. The block must be  be aligned properly,
+                     * and must not overlap any currently allocated block.
+                     */
+                    if ((extent = payload_extent(p, size)) == 0) {
+                        malloc_error(trace, opnum, "mm_usable_size is less than %zu", size);
+                        return false;
+                    }
+                    if (add_range(ranges, p, extent, trace, opnum, index) == 0)
+                        return false;
+
+                    /* Remember region */
+                    trace->blocks[index] = p;
+                    trace->block_sizes[index] = size;
+
+                    /* Set to random data, for debugging. */
+                    randomize_block(trace, index);
+                }
+                i += n - 1;
+                break;
+
+            case REALLOC: /* mm_realloc */
+                if (!check_index(trace, opnum, index))
+                {
+                    allCheck = false;
+                }
+
+                /* Call the student's realloc */
+                oldp = trace->blocks[index];
+                extent = payload_extent(oldp, trace->block_sizes[index]);
+                newp = mm_resize(trace, index, size);
+                if ( (newp == NULL) && (size != 0) ) {
+                    malloc_error(trace, opnum, "mm_realloc failed.");
+                    return false;
+                }
+                if ( (newp != NULL) && (size == 0) ) {
+                    malloc_error(trace, opnum, "mm_realloc with size 0 returned "
+                                 "non-NULL.");
+                    return false;
+                }
+
+                /* Remove the old region from the range list */
+                remove_range(ranges, oldp, extent);
+                if (!check_neighbors(trace, ranges, opnum, oldp) ||
+                    (newp != NULL && newp != oldp &&
+                     !check_neighbors(trace, ranges, opnum, newp)))
+                {
+                    allCheck = false;
+                }
+
+                /* Check new block for correctness and add it to range list */
+                if (size > 0) {
+                    if ((extent = payload_extent(newp, size)) == 0) {
+                        malloc_error(trace, opnum, "mm_usable_size is less than %zu", size);
+                        return false;
+                    }
+                    if (add_range(ranges, newp, extent, trace, opnum, index) == 0)
+                        return false;
+                }
+
+
+                /* Move the region from where it was.
+                 * Check up to min(size, oldsize) for correct copying. */
+                trace->blocks[index] = newp;
+                if (size < trace->block_sizes[index]) {
+                    trace->block_sizes[index] = size;
+                }
+                // NOTE: Might help to pass old size here to check bytes at each end of allocation
+
+                if (!check_index(trace, opnum, index))
+                {
+                    allCheck = false;
+                }
+                trace->block_sizes[index] = size;
+
+                /* Set to random data, for debugging. */
+                randomize_block(trace, index);
+                break;
+
+            case FREE: /* mm_free, or mm_free_batch for a run of them */
+                n = batch_run(ops, i, count);
+                for (j = 0; j < n; j++) {
+                    opnum = trace->op_base + i + j;
+                    index = ops[i + j].index;
+                    if (!check_index(trace, opnum, index))
+                    {
+                        allCheck = false;
+                    }
+
+                    /* Remove region from list */
+                    if (index == -1) {
+                        p = 0;
+                        size = 0;
+                    } else {
+                        p = trace->blocks[index];
+                        size = trace->block_sizes[index];
+                        remove_range(ranges, p, payload_extent(p, size));
+                    }
+                    batch_ptrs[j] = p;
+                }
+
+                /* Call student's free function */
+                if (n == 1)
+                    mm_release(trace, index, p, size);
+                else
+                    mm->free_batch(batch_ptrs, n);
+
+                /* Coalescing the freed blocks may have overwritten their neighbors */
+                for (j = 0; j < n; j++) {
+                    if (batch_ptrs[j] != NULL &&
+                        !check_neighbors(trace, ranges, trace->op_base + i + j, batch_ptrs[j]))
+                    {
+                        allCheck = false;
+                    }
+                }
+                i += n - 1;
+                break;
+
+            default:
+                app_error("Nonexistent request type in eval_mm_valid");
+            }
+        }
+    }
+
+    /* Catch anything the incremental checks could not see */
+    if (debug_mode == DBG_EXPENSIVE && incremental) {
+        int opnum = trace->num_ops;
+        if (!mm->checkheap(0)) {
+            malloc_error(trace, opnum, "mm_checkheap returned false\n");
+            return false;
+        }
+        if (!check_all(trace, ranges, opnum))
+            allCheck = false;
+    }
+
+    if (arena_objs)
+        destroy_arenas();
+
+    /* As far as we know, this is a valid malloc package */
+    return allCheck;
+}
+
+/*
+ * eval_mm_util - Evaluate the space utilization of the student's package
+ *   The idea is to remember the high water mark "hwm" of the heap for
+ *   an optimal allocator, i.e., no gaps and no internal fragmentation.
+ *   Utilization is the ratio hwm/heapsize, where heapsize is the
+ *   size of the heap in bytes after running the student's malloc
+ *   package on the trace. Note that our implementation of mem_sbrk()
+ *   doesn't allow the students to decrement the brk pointer, so brk
+ *   is always the high water mark of the heap.
+ *
+ *   A higher number is better: 1 is optimal.
+ */
+static double eval_mm_util(trace_t *trace, int tracenum)
+{
+    int i;
+    traceop_t *ops;
+    int count;
+    int index;
+    int n, j;
+    size_t size, newsize, oldsize;
+    size_t max_total_size = 0;
+    size_t total_size = 0;
+    char *p;
+    char *newp;
+    FILE *frag = NULL;
+
+    reinit_trace(trace);
+
+    /* initialize the heap and the mm malloc package */
+    mem_reset_brk();
+    if (!mm->init())
+        app_error("trace %d: mm_init failed in eval_mm_util", tracenum);
+    forget_arenas();
+    if (frag_interval > 0)
+        frag = open_frag_file(trace);
+
+    rewind_ops(trace);
+    while ((ops = next_ops(trace, &count)) != NULL) {
+        for (i = 0;  i < count;  i += n) {
+            n = batch_run(ops, i, count);
+            switch (ops[i].type) {
+
+            case ALLOC: /* mm_alloc, or mm_malloc_batch for a run of them */
+                size = ops[i].size;
+
+                if (!mm_alloc_batch(trace, &ops[i], size, n)) {
+                    app_error("trace %d: mm_malloc failed in eval_mm_util",
+                              tracenum);
+                }
+
+                /* Remember regions and sizes */
+                for (j = 0; j < n; j++) {
+                    index = ops[i + j].index;
+                    trace->blocks[index] = batch_ptrs[j];
+                    trace->block_sizes[index] = size;
+                }
+
+                total_size += n * size;
+                break;
+
+            case REALLOC: /* mm_realloc */
+                index = ops[i].index;
+                newsize = ops[i].size;
+                oldsize = trace->block_sizes[index];
+
+                if ((newp = mm_resize(trace, index, newsize)) == NULL && newsize != 0) {
+                    app_error("trace %d: mm_realloc failed in eval_mm_util",
+                              tracenum);
+                }
+
+                /* Remember region and size */
+                trace->blocks[index] = newp;
+                trace->block_sizes[index] = newsize;
+
+                total_size += (newsize - oldsize);
+                break;
+
+            case FREE: /* mm_free, or mm_free_batch for a run of them */
+                if (n > 1) {
+                    for (j = 0; j < n; j++) {
+                        index = ops[i + j].index;
+                        batch_ptrs[j] = trace->blocks[index];
+                        total_size -= trace->block_sizes[index];
+                    }
+                    mm->free_batch(batch_ptrs, n);
+                    break;
+                }
+
+                index = ops[i].index;
+                if (index < 0) {
+                    size = 0;
+                    p = 0;
+                } else {
+                    size = trace->block_sizes[index];
+                    p = trace->blocks[index];
+                }
+
+                mm_release(trace, index, p, size);
+
+                total_size -= size;
+                break;
+
+            default:
+                app_error("trace %d: Nonexistent request type in eval_mm_util",
+                          tracenum);
+            }
+
+            /* update the high-water mark */
+            max_total_size = (total_size > max_total_size) ?
+                total_size : max_total_size;
+
+            /* A batch may carry the op count past a multiple of the interval */
+            if (frag && (trace->op_base + i + n) / frag_interval !=
+                        (trace->op_base + i) / frag_interval)
+                sample_frag(frag, trace->op_base + i + n, total_size);
+        }
+    }
+
+    if (frag) {
+        if (trace->num_ops % frag_interval != 0)
+            sample_frag(frag, trace->num_ops, total_size);
+        fclose(frag);
+    }
+    if (arena_objs)
+        destroy_arenas();
+
 #if !REF_ONLY
     printf(".");
 #endif
@@ -1234,6 +2477,63 @@ static double eval_mm_util(trace_t *trace, int tracenum)
     return ((double)max_total_size / (double)mem_heapsize());
 }
 
+/* Most size classes an allocator can report to sample_frag */
+#define MAX_FRAG_CLASSES 32
+
+/*
+ * open_frag_file - Create the fragmentation time series for a trace.
+ *     It goes in the current directory, named after the trace with
+ *     .rep replaced by .frag, as tab-separated columns.  Each size
+ *     class's column is named after the smallest block size in it.
+ */
+static FILE *open_frag_file(const trace_t *trace)
+{
+    char name[MAXLINE];
+    size_t class_size[MAX_FRAG_CLASSES], free_bytes[MAX_FRAG_CLASSES];
+    size_t largest;
+    FILE *f;
+
+    const char *base = strrchr(trace->filename, '/');
+    strcpy(name, base ? base + 1 : trace->filename);
+    char *ext = strrchr(name, '.');
+    if (ext && strcmp(ext, ".rep") == 0)
+        *ext = '\0';
+    strcat(name, ".frag");
+    if ((f = fopen(name, "w")) == NULL)
+        unix_error("Could not open %s in open_frag_file", name);
+
+    size_t nclasses = mm->free_stats(class_size, free_bytes, MAX_FRAG_CLASSES, &largest);
+    fprintf(f, "op\tlive\theap\tutil\tfree\tlargest\textfrag");
+    for (size_t c = 0; c < nclasses; c++)
+        fprintf(f, "\tfree_%zu", class_size[c]);
+    fprintf(f, "\n");
+    return f;
+}
+
+/*
+ * sample_frag - Append one row to the fragmentation time series: live
+ *     payload bytes, heap size, free bytes in total and per size class,
+ *     the largest free block, and the external fragmentation index
+ *     1 - largest/free (0 when the free space is one block).
+ */
+static void sample_frag(FILE *f, long opnum, size_t live_bytes)
+{
+    size_t class_size[MAX_FRAG_CLASSES], free_bytes[MAX_FRAG_CLASSES];
+    size_t largest, total_free = 0;
+    size_t heap = mem_heapsize();
+
+    size_t nclasses = mm->free_stats(class_size, free_bytes, MAX_FRAG_CLASSES, &largest);
+    for (size_t c = 0; c < nclasses; c++)
+        total_free += free_bytes[c];
+
+    fprintf(f, "%ld\t%zu\t%zu\t%.4f\t%zu\t%zu\t%.4f", opnum, live_bytes, heap,
+            heap ? (double) live_bytes / heap : 0.0, total_free, largest,
+            total_free ? 1.0 - (double) largest / total_free : 0.0);
+    for (size_t c = 0; c < nclasses; c++)
+        fprintf(f, "\t%zu", free_bytes[c]);
+    fprintf(f, "\n");
+}
+
 
 /*
  * eval_mm_speed - This is the function that is used by fcyc()
@@ -1241,51 +2541,219 @@ static double eval_mm_util(trace_t *trace, int tracenum)
  */
 static void eval_mm_speed(void *ptr)
 {
-    int i, index;
+    int i, index, n, j;
+    traceop_t *ops;
+    int count;
     size_t size, newsize;
-    char *p, *newp, *oldp, *block;
+    char *p, *newp, *block;
     trace_t *trace = ((speed_t *)ptr)->trace;
     reinit_trace(trace);
 
     /* Reset the heap and initialize the mm package */
     mem_reset_brk();
-    if (!mm_init())
+    if (!mm->init())
         app_error("mm_init failed in eval_mm_speed");
+    forget_arenas();
+
+    if (use_replay(trace)) {
+        replay(trace, mm);
+        return;
+    }
 
     /* Interpret each trace request */
-    for (i = 0;  i < trace->num_ops;  i++)
-        switch (trace->ops[i].type) {
-
-        case ALLOC: /* mm_malloc */
-            index = trace->ops[i].index;
-            size = trace->ops[i].size;
-            if ((p = mm_malloc(size)) == NULL)
-                app_error("mm_malloc error in eval_mm_speed");
-            trace->blocks[index] = p;
-            break;
+    rewind_ops(trace);
+    while ((ops = next_ops(trace, &count)) != NULL) {
+        for (i = 0;  i < count;  i++) {
+            switch (ops[i].type) {
+
+            case ALLOC: /* mm_malloc */
+                index = ops[i].index;
+                size = ops[i].size;
+                if (batch_mode && (n = batch_run(ops, i, count)) > 1) {
+                    if (mm->malloc_batch(size, n, batch_ptrs) != (size_t) n)
+                        app_error("mm_malloc_batch error in eval_mm_speed");
+                    for (j = 0; j < n; j++) {
+                        trace->blocks[ops[i + j].index] = batch_ptrs[j];
+                        if (sized_free)
+                            trace->block_sizes[ops[i + j].index] = size;
+                    }
+                    i += n - 1;
+                    break;
+                }
+                if ((p = mm_alloc(trace, index, size)) == NULL)
+                    app_error("mm_malloc error in eval_mm_speed");
+                trace->blocks[index] = p;
+                if (sized_free || arena_objs)
+                    trace->block_sizes[index] = size;
+                break;
+
+            case REALLOC: /* mm_realloc */
+                index = ops[i].index;
+                newsize = ops[i].size;
+                if ((newp = mm_resize(trace, index, newsize)) == NULL && newsize != 0)
+                    app_error("mm_realloc error in eval_mm_speed");
+                trace->blocks[index] = newp;
+                if (sized_free || arena_objs)
+                    trace->block_sizes[index] = newsize;
+                break;
+
+            case FREE: /* mm_free */
+                index = ops[i].index;
+                if (batch_mode && (n = batch_run(ops, i, count)) > 1) {
+                    for (j = 0; j < n; j++)
+                        batch_ptrs[j] = trace->blocks[ops[i + j].index];
+                    mm->free_batch(batch_ptrs, n);
+                    i += n - 1;
+                    break;
+                }
+                if (index < 0) {
+                    block = 0;
+                    size = 0;
+                } else {
+                    block = trace->blocks[index];
+                    size = sized_free ? trace->block_sizes[index] : 0;
+                }
+                mm_release(trace, index, block, size);
+                break;
+
+            default:
+                app_error("Nonexistent request type in eval_mm_speed");
+            }
+        }
+    }
+    if (arena_objs)
+        destroy_arenas();
+}
 
-        case REALLOC: /* mm_realloc */
-            index = trace->ops[i].index;
-            newsize = trace->ops[i].size;
-            oldp = trace->blocks[index];
-            if ((newp = mm_realloc(oldp,newsize)) == NULL && newsize != 0)
-                app_error("mm_realloc error in eval_mm_speed");
-            trace->blocks[index] = newp;
+/*
+ * use_replay - Whether the replay kernel can time the trace: it must be
+ *     in memory, and the kernel only makes plain malloc, realloc and
+ *     free calls, so -a, -z, -B and -R are left to the interpreters.
+ */
+static bool use_replay(const trace_t *trace)
+{
+    return trace->arrays.type != NULL && !payload_align && !sized_free &&
+        !batch_mode && !arena_objs;
+}
+
+/* Keeps the reads of -w from being optimized out */
+static volatile unsigned long touch_sink;
+
+/*
+ * touch_bytes - How many bytes at the start of a payload of size bytes
+ *     -w writes and reads: touch_percent of it, rounded up
+ */
+static size_t touch_bytes(size_t size)
+{
+    return (size * touch_percent + 99) / 100;
+}
+
+/*
+ * read_payload - Read the bytes -w wrote at the start of a payload, as a
+ *     program would before it frees the payload, and return their sum
+ */
+static unsigned long read_payload(const unsigned char *p, size_t size)
+{
+    unsigned long sum = 0;
+    size_t n = touch_bytes(size), i;
+
+    for (i = 0; i < n; i++)
+        sum += p[i];
+    return sum;
+}
+
+/*
+ * replay - The replay kernel.  Run the ops of an in-memory trace on a
+ *     package straight from the trace's parallel arrays, prefetching
+ *     the block slot of the op REPLAY_AHEAD ops on, so that what the
+ *     driver does between calls costs as little as it can.  With -w,
+ *     write the first touch_percent of each payload once it is
+ *     allocated and read it back before it is freed.  Where each
+ *     block lands then shows in the time, as cache and TLB misses.
+ *     The empty package's payloads are never touched.
+ */
+static void replay(trace_t *trace, const package_t *pkg)
+{
+    const unsigned char *type = trace->arrays.type;
+    const int32_t *index = trace->arrays.index;
+    const size_t *size = trace->arrays.size;
+    char **blocks = trace->blocks;
+    size_t *block_sizes = trace->block_sizes;
+    void *(*pkg_malloc)(size_t) = pkg->malloc;
+    void *(*pkg_realloc)(void *, size_t) = pkg->realloc;
+    void (*pkg_free)(void *) = pkg->free;
+    bool touch = touch_percent > 0 && pkg != &empty_mm;
+    unsigned long sum = 0;
+    int num_ops = trace->num_ops;
+    int i;
+
+    for (i = 0; i < num_ops; i++) {
+        int32_t ahead = index[i + REPLAY_AHEAD];
+        if (ahead >= 0)
+            __builtin_prefetch(&blocks[ahead], 1);
+
+        switch (type[i]) {
+        case ALLOC:
+            if ((blocks[index[i]] = pkg_malloc(size[i])) == NULL)
+                app_error("%s malloc failed in replay", pkg->name);
+            if (touch) {
+                block_sizes[index[i]] = size[i];
+                memset(blocks[index[i]], (int) i, touch_bytes(size[i]));
+            }
             break;
 
-        case FREE: /* mm_free */
-            index = trace->ops[i].index;
-            if (index < 0) {
-                block = 0;
-            } else {
-                block = trace->blocks[index];
+        case REALLOC:
+            if ((blocks[index[i]] = pkg_realloc(blocks[index[i]], size[i])) == NULL
+                && size[i] != 0)
+                app_error("%s realloc failed in replay", pkg->name);
+            if (touch) {
+                /* A realloc to 0 may free the block and leave it NULL */
+                block_sizes[index[i]] = size[i];
+                if (blocks[index[i]] != NULL)
+                    memset(blocks[index[i]], (int) i, touch_bytes(size[i]));
             }
-            mm_free(block);
             break;
 
-        default:
-            app_error("Nonexistent request type in eval_mm_speed");
+        case FREE:
+            if (touch && index[i] >= 0)
+                sum += read_payload((unsigned char *) blocks[index[i]],
+                                    block_sizes[index[i]]);
+            pkg_free(index[i] >= 0 ? blocks[index[i]] : NULL);
+            break;
         }
+    }
+    touch_sink += sum;
+}
+
+/*
+ * eval_empty_speed - Replay a trace on the empty package, for the time
+ *     the driver's part of eval_mm_speed and eval_libc_speed takes.
+ */
+static void eval_empty_speed(void *ptr)
+{
+    trace_t *trace = ((speed_t *)ptr)->trace;
+
+    reinit_trace(trace);
+    replay(trace, &empty_mm);
+}
+
+/*
+ * time_replay - Time f on an in-memory trace with fsec.  When the replay
+ *     kernel runs the trace, take away the time of an empty replay, so
+ *     that the throughput is the allocator's and not the driver's.
+ */
+static double time_replay(test_funct f, speed_t *params)
+{
+    double secs = fsec(f, params);
+
+    if (use_replay(params->trace)) {
+        double empty = fsec(eval_empty_speed, params);
+        if (verbose > 1)
+            printf("Empty replay of %s: %.3f of %.3f ms\n",
+                   params->trace->filename, empty * 1e3, secs * 1e3);
+        secs -= empty;
+    }
+    return secs > timer_resolution ? secs : timer_resolution;
 }
 
 /*
@@ -1297,42 +2765,48 @@ static void eval_mm_speed(void *ptr)
 static bool eval_libc_valid(trace_t *trace)
 {
     int i;
+    traceop_t *ops;
+    int count;
     size_t newsize;
     char *p, *newp, *oldp;
 
     reinit_trace(trace);
 
-    for (i = 0;  i < trace->num_ops;  i++) {
-        switch (trace->ops[i].type) {
+    rewind_ops(trace);
+    while ((ops = next_ops(trace, &count)) != NULL) {
+        for (i = 0;  i < count;  i++) {
+            int opnum = trace->op_base + i;
+            switch (ops[i].type) {
 
-        case ALLOC: /* malloc */
-            if ((p = malloc(trace->ops[i].size)) == NULL) {
-                malloc_error(trace, i, "libc malloc failed");
-                unix_error("System message");
-            }
-            trace->blocks[trace->ops[i].index] = p;
-            break;
+            case ALLOC: /* malloc */
+                if ((p = libc_alloc(ops[i].size)) == NULL) {
+                    malloc_error(trace, opnum, "libc malloc failed");
+                    unix_error("System message");
+                }
+                trace->blocks[ops[i].index] = p;
+                break;
 
-        case REALLOC: /* realloc */
-            newsize = trace->ops[i].size;
-            oldp = trace->blocks[trace->ops[i].index];
-            if ((newp = realloc(oldp, newsize)) == NULL && newsize != 0) {
-                malloc_error(trace, i, "libc realloc failed");
-                unix_error("System message");
-            }
-            trace->blocks[trace->ops[i].index] = newp;
-            break;
+            case REALLOC: /* realloc */
+                newsize = ops[i].size;
+                oldp = trace->blocks[ops[i].index];
+                if ((newp = realloc(oldp, newsize)) == NULL && newsize != 0) {
+                    malloc_error(trace, opnum, "libc realloc failed");
+                    unix_error("System message");
+                }
+                trace->blocks[ops[i].index] = newp;
+                break;
 
-        case FREE: /* free */
-            if (trace->ops[i].index >= 0) {
-                free(trace->blocks[trace->ops[i].index]);
-            } else {
-                free(0);
-            }
-            break;
+            case FREE: /* free */
+                if (ops[i].index >= 0) {
+                    free(trace->blocks[ops[i].index]);
+                } else {
+                    free(0);
+                }
+                break;
 
-        default:
-            app_error("invalid operation type  in eval_libc_valid");
+            default:
+                app_error("invalid operation type  in eval_libc_valid");
+            }
         }
     }
 
@@ -1347,6 +2821,8 @@ static bool eval_libc_valid(trace_t *trace)
 static void eval_libc_speed(void *ptr)
 {
     int i;
+    traceop_t *ops;
+    int count;
     int index;
     size_t size, newsize;
     char *p, *newp, *oldp, *block;
@@ -1354,39 +2830,122 @@ static void eval_libc_speed(void *ptr)
 
     reinit_trace(trace);
 
-    for (i = 0;  i < trace->num_ops;  i++) {
-        switch (trace->ops[i].type) {
-        case ALLOC: /* malloc */
-            index = trace->ops[i].index;
-            size = trace->ops[i].size;
-            if ((p = malloc(size)) == NULL)
-                unix_error("malloc failed in eval_libc_speed");
-            trace->blocks[index] = p;
-            break;
+    if (use_replay(trace)) {
+        replay(trace, &libc_mm);
+        return;
+    }
 
-        case REALLOC: /* realloc */
-            index = trace->ops[i].index;
-            newsize = trace->ops[i].size;
-            oldp = trace->blocks[index];
-            if ((newp = realloc(oldp, newsize)) == NULL && newsize != 0)
-                unix_error("realloc failed in eval_libc_speed\n");
+    rewind_ops(trace);
+    while ((ops = next_ops(trace, &count)) != NULL) {
+        for (i = 0;  i < count;  i++) {
+            switch (ops[i].type) {
+            case ALLOC: /* malloc */
+                index = ops[i].index;
+                size = ops[i].size;
+                if ((p = libc_alloc(size)) == NULL)
+                    unix_error("malloc failed in eval_libc_speed");
+                trace->blocks[index] = p;
+                break;
 
-            trace->blocks[index] = newp;
-            break;
+            case REALLOC: /* realloc */
+                index = ops[i].index;
+                newsize = ops[i].size;
+                oldp = trace->blocks[index];
+                if ((newp = realloc(oldp, newsize)) == NULL && newsize != 0)
+                    unix_error("realloc failed in eval_libc_speed\n");
 
-        case FREE: /* free */
-            index = trace->ops[i].index;
-            if (index >= 0) {
-                block = trace->blocks[index];
-                free(block);
-            } else {
-                free(0);
+                trace->blocks[index] = newp;
+                break;
+
+            case FREE: /* free */
+                index = ops[i].index;
+                if (index >= 0) {
+                    block = trace->blocks[index];
+                    free(block);
+                } else {
+                    free(0);
+                }
+                break;
             }
-            break;
         }
     }
 }
 
+/*
+ * rss_growth - Run f once in a child process and return how far the
+ *    child's peak resident set grew above its size at the fork, in KB,
+ *    or -1 if the child didn't finish.  A forked child starts with its
+ *    peak at its current size, so the growth is the memory the
+ *    allocator touched during the replay, not what the driver holds.
+ */
+static long rss_growth(test_funct f, void *args)
+{
+    int fds[2];
+    long growth = -1;
+    int status;
+    pid_t pid;
+
+    if (pipe(fds) < 0)
+        unix_error("pipe failed in rss_growth");
+    fflush(stdout);
+    if ((pid = fork()) < 0)
+        unix_error("fork failed in rss_growth");
+
+    if (pid == 0) {
+        struct rusage before, after;
+        close(fds[0]);
+        /* Touch the driver's block arrays before taking the baseline */
+        reinit_trace(((speed_t *)args)->trace);
+        getrusage(RUSAGE_SELF, &before);
+        f(args);
+        getrusage(RUSAGE_SELF, &after);
+        growth = after.ru_maxrss - before.ru_maxrss;
+        if (write(fds[1], &growth, sizeof(growth)) != sizeof(growth))
+            _exit(1);
+        _exit(0);
+    }
+
+    close(fds[1]);
+    if (read(fds[0], &growth, sizeof(growth)) != sizeof(growth))
+        growth = -1;
+    close(fds[0]);
+    if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        growth = -1;
+    return growth;
+}
+
+/*
+ * page_faults - Return the number of page faults the driver has taken,
+ *    minor and major.  The count covers the whole process, so it also
+ *    has the faults of the driver's own trace and range arrays.
+ */
+static long page_faults(void)
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_minflt + usage.ru_majflt;
+}
+
+/*
+ * parse_map_options - Turn a comma-separated list of prefault, thp and
+ *    none into memlib's MEM_* options
+ */
+static int parse_map_options(char *opts)
+{
+    int options = 0;
+    char *opt;
+
+    for (opt = strtok(opts, ","); opt != NULL; opt = strtok(NULL, ",")) {
+        if (strcmp(opt, "prefault") == 0)
+            options |= MEM_PREFAULT;
+        else if (strcmp(opt, "thp") == 0)
+            options |= MEM_THP;
+        else if (strcmp(opt, "none") != 0)
+            app_error("-M takes prefault, thp or none, not %s\n", opt);
+    }
+    return options;
+}
+
 /*************************************
  * Some miscellaneous helper routines
  ************************************/
@@ -1564,6 +3123,127 @@ static void printresults(int n, stats_t *stats, sum_stats_t *sumstats)
     }
 }
 
+/*
+ * print_comparison - Print the utilization and throughput of each
+ *     package loaded with -L side by side, one row per trace, and the
+ *     average utilization and geometric mean throughput at the bottom.
+ */
+static void print_comparison(int n, stats_t **stats)
+{
+    int i, p;
+
+    printf("%-24s", "");
+    for (p = 0; p < num_plugins; p++)
+        printf("  %16.16s", plugins[p].name);
+    printf("\n%-24s", "trace");
+    for (p = 0; p < num_plugins; p++)
+        printf("  %7s %8s", "util", "Kops");
+    printf("\n");
+
+    for (i = 0; i < n; i++) {
+        const char *base = strrchr(stats[0][i].filename, '/');
+        printf("%-24.24s", base ? base + 1 : stats[0][i].filename);
+        for (p = 0; p < num_plugins; p++) {
+            const stats_t *st = &stats[p][i];
+            if (st->valid)
+                printf("  %6.1f%% %8.0f", st->util * 100.0, sparse_mode ? 0.0 : st->tput);
+            else
+                printf("  %7s %8s", "no", "-");
+        }
+        printf("\n");
+    }
+
+    printf("%-24s", "Avg");
+    for (p = 0; p < num_plugins; p++) {
+        double util = 0, log_tput = 0;
+        int util_weight = 0, perf_weight = 0;
+        bool all_valid = true;
+        for (i = 0; i < n; i++) {
+            const stats_t *st = &stats[p][i];
+            all_valid = all_valid && st->valid;
+            if (!st->valid)
+                continue;
+            if (st->weight == WALL || st->weight == WUTIL) {
+                util += st->util;
+                util_weight++;
+            }
+            if (st->weight == WALL || st->weight == WPERF) {
+                log_tput += log(st->tput);
+                perf_weight++;
+            }
+        }
+        if (!all_valid)
+            printf("  %7s %8s", "-", "-");
+        else
+            printf("  %6.1f%% %8.0f",
+                   util_weight ? 100.0 * util / util_weight : 0.0,
+                   (perf_weight && !sparse_mode) ? exp(log_tput / perf_weight) : 0.0);
+    }
+    printf("\n");
+}
+
+/*
+ * print_libc_comparison - Print the throughput of mm against libc malloc
+ *     for each trace, with the growth in resident memory of one replay
+ *     under each, and the geometric mean of the throughput ratios.
+ */
+static void print_libc_comparison(int n, stats_t *mm_stats, stats_t *libc_stats)
+{
+    double log_ratio = 0;
+    int num_ratios = 0;
+    int i;
+
+    printf("\nComparison with libc malloc:\n");
+    printf("%-24s  %8s %9s %8s  %10s %11s\n",
+           "trace", "mm Kops", "libc Kops", "mm/libc", "mm RSS KB", "libc RSS KB");
+    for (i = 0; i < n; i++) {
+        const stats_t *ms = &mm_stats[i], *ls = &libc_stats[i];
+        const char *base = strrchr(ms->filename, '/');
+        printf("%-24.24s", base ? base + 1 : ms->filename);
+        if (ms->valid && ls->valid && !sparse_mode) {
+            double ratio = ms->tput / ls->tput;
+            printf("  %8.0f %9.0f %8.2f", ms->tput, ls->tput, ratio);
+            log_ratio += log(ratio);
+            num_ratios++;
+        } else {
+            printf("  %8s %9s %8s", "-", "-", "-");
+        }
+        if (ms->rss_kb >= 0)
+            printf("  %10ld", ms->rss_kb);
+        else
+            printf("  %10s", "-");
+        if (ls->rss_kb >= 0)
+            printf(" %11ld\n", ls->rss_kb);
+        else
+            printf(" %11s\n", "-");
+    }
+    if (num_ratios > 0)
+        printf("%-24s  %8s %9s %8.2f\n", "Geom mean", "", "", exp(log_ratio / num_ratios));
+    printf("\n");
+}
+
+/*
+ * print_faults - Print the page faults taken on each trace, in all and
+ *     while it was timed, with the timed faults per op.
+ */
+static void print_faults(int n, stats_t *stats)
+{
+    int i;
+
+    printf("\nPage faults:\n");
+    printf("%-24s  %8s %8s %10s\n", "trace", "total", "timed", "timed/Kop");
+    for (i = 0; i < n; i++) {
+        const stats_t *st = &stats[i];
+        const char *base = strrchr(st->filename, '/');
+        printf("%-24.24s  %8ld", base ? base + 1 : st->filename, st->faults);
+        if (st->valid)
+            printf(" %8ld %10.2f\n", st->timed_faults, 1000.0 * st->timed_faults / st->ops);
+        else
+            printf(" %8s %10s\n", "-", "-");
+    }
+    printf("\n");
+}
+
 /*
  * app_error - Report an arbitrary application error
  */
@@ -1685,18 +3365,30 @@ static char *gen_file_name(char *template, char *buf, int maxlen) {
  */
 static void usage(char *prog)
 {
-    fprintf(stderr, "Usage: %s [-hlVdD] [-f <file>]\n", prog);
+    fprintf(stderr, "Usage: %s [-hblVdDHI] [-f <file>] [-L <so>]...\n", prog);
     fprintf(stderr, "Options\n");
     fprintf(stderr, "\t-p         Calculate Checkpoint Score.\n");
     fprintf(stderr, "\t-d <i>     Debug: 0 off; 1 default; 2 lots.\n");
     fprintf(stderr, "\t-D         Equivalent to -d2.\n");
+    fprintf(stderr, "\t-L <so>    Run the mm package in shared object <so> (repeat to compare).\n");
+    fprintf(stderr, "\t-a <n>     Allocate with mm_memalign to <n> bytes, and check alignment.\n");
+    fprintf(stderr, "\t-z         Free with mm_free_sized; check payloads up to mm_usable_size.\n");
+    fprintf(stderr, "\t-w <pct>   While timing, write and read <pct>%% of each payload.\n");
+    fprintf(stderr, "\t-B         Batch runs of same-size allocs and of frees (mm_malloc_batch).\n");
+    fprintf(stderr, "\t-R <n>     Allocate from arenas of <n> payloads, reset once all are freed.\n");
+    fprintf(stderr, "\t-H         Find overlapping blocks with a shadow bitmap of the heap.\n");
+    fprintf(stderr, "\t-M <opts>  Map the heap with prefault,thp (or none); count page faults.\n");
+    fprintf(stderr, "\t-I         Like -D, but check only the blocks each op touched.\n");
     fprintf(stderr, "\t-c <file>  Run trace file <file> once, check for correctness only.\n");
     fprintf(stderr, "\t-t <dir>   Directory to find default traces.\n");
     fprintf(stderr, "\t-h         Print this message.\n");
-    // fprintf(stderr, "\t-l         Run libc malloc as well.\n");
+    fprintf(stderr, "\t-l         Run libc malloc as well, and compare speed and RSS.\n");
     fprintf(stderr, "\t-V         Print diagnostics as each trace is run.\n");
     fprintf(stderr, "\t-v <i>     Set Verbosity Level to <i>\n");
     fprintf(stderr, "\t-s <s>     Timeout after s secs (default no timeout)\n");
     fprintf(stderr, "\t-T         Print diagnostics in tab mode\n");
+    fprintf(stderr, "\t-S         Stream traces from disk (for traces too big for memory)\n");
+    fprintf(stderr, "\t-g <K>     Write fragmentation every K ops to <trace>.frag\n");
     fprintf(stderr, "\t-f <file>  Use <file> as the trace file\n");
+    fprintf(stderr, "\t-b         Use the stress-pattern traces (bench-*.rep) instead of the defaults.\n");
 }
@@ -23,12 +23,21 @@
 static unsigned char *heap;                 /* Starting address of heap */
 static unsigned char *mem_brk;              /* Current position of break */
 static unsigned char *mem_max_addr;         /* Maximum allowable heap address */
+static unsigned char *mem_used_brk;         /* Highest break since mem_init */
 static size_t mmap_length = MAX_DENSE_HEAP; /* Number of bytes allocated by mmap */
 static bool show_stats = false;             /* Should program print allocation information? */
 static bool stats_printed = false;          /* Has information been printed about allocation */
+static int map_options = 0;                 /* MEM_PREFAULT and MEM_THP */
 
 static void print_stats();
 
+/*
+ * mem_set_options - choose how mem_init maps the heap from then on
+ */
+void mem_set_options(int options) {
+    map_options = options;
+}
+
 /* 
  * mem_init - initialize the memory system model
  */
@@ -55,12 +64,25 @@ void mem_init(){
         fprintf(stderr, "FAILURE.  mmap couldn't allocate space for heap\n");
         exit(1);
     }
+
+#ifdef MADV_HUGEPAGE
+    /* Before any page is touched, so prefaulting gets huge pages too */
+    if ((map_options & MEM_THP) && madvise(addr, mmap_length, MADV_HUGEPAGE) != 0)
+        fprintf(stderr, "WARNING.  madvise couldn't ask for huge pages for heap\n");
+#endif
+    /* Write to every page, so no fault is taken inside the allocator */
+    if (map_options & MEM_PREFAULT) {
+        size_t pagesize = mem_pagesize();
+        for (size_t off = 0; off < mmap_length; off += pagesize)
+            ((volatile unsigned char *) addr)[off] = 0;
+    }
     
     heap = addr;
     mem_max_addr = heap + MAX_DENSE_HEAP;
     
     stats_printed = false;
     mem_brk = heap;
+    mem_used_brk = heap;
     mem_reset_brk();
 }
 
@@ -104,6 +126,8 @@ void *mem_sbrk(intptr_t incr) {
     }
     if (ok) {
         mem_brk += incr;
+        if (mem_brk > mem_used_brk)
+            mem_used_brk = mem_brk;
         return (void *) old_brk;
     } else {
         errno = ENOMEM;
@@ -125,6 +149,14 @@ void *mem_heap_hi(){
     return (void *)(mem_brk - 1);
 }
 
+/*
+ * mem_heap_used_brk - return the highest break since mem_init.  No heap
+ *                     has written the bytes from there up, so they are zero
+ */
+void *mem_heap_used_brk(void){
+    return (void *) mem_used_brk;
+}
+
 /*
  * mem_heapsize() - returns the heap size in bytes
  */
@@ -170,3 +202,67 @@ void mem_write(void *addr, uint64_t val, size_t len) {
     else
         memcpy(addr, (void *) &val, len);
 }
+
+void mem_write_bytes(void *addr, const void *src, size_t len) {
+    memcpy(addr, src, len);
+}
+
+/* Compare a word at a time, then the leftover bytes */
+static size_t mismatch_scalar(const unsigned char *a, const unsigned char *b, size_t len) {
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= len; i += sizeof(uint64_t)) {
+        uint64_t x, y;
+        memcpy(&x, a + i, sizeof(x));
+        memcpy(&y, b + i, sizeof(y));
+        if (x != y)
+            break;
+    }
+    for (; i < len; i++)
+        if (a[i] != b[i])
+            return i;
+    return len;
+}
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+
+static size_t mismatch_sse2(const unsigned char *a, const unsigned char *b, size_t len) {
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i *) (a + i));
+        __m128i y = _mm_loadu_si128((const __m128i *) (b + i));
+        unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi8(x, y));
+        if (mask != 0xFFFF)
+            return i + __builtin_ctz(~mask);
+    }
+    return i + mismatch_scalar(a + i, b + i, len - i);
+}
+
+__attribute__((target("avx2")))
+static size_t mismatch_avx2(const unsigned char *a, const unsigned char *b, size_t len) {
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i *) (a + i));
+        __m256i y = _mm256_loadu_si256((const __m256i *) (b + i));
+        unsigned mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(x, y));
+        if (mask != 0xFFFFFFFFu)
+            return i + __builtin_ctz(~mask);
+    }
+    return i + mismatch_sse2(a + i, b + i, len - i);
+}
+#endif
+
+size_t mem_mismatch(const void *addr, const void *expected, size_t len) {
+#if defined(__x86_64__)
+    static int use_avx2 = -1;
+    if (use_avx2 < 0) {
+        __builtin_cpu_init();
+        use_avx2 = __builtin_cpu_supports("avx2");
+    }
+    if (use_avx2)
+        return mismatch_avx2(addr, expected, len);
+    return mismatch_sse2(addr, expected, len);
+#else
+    return mismatch_scalar(addr, expected, len);
+#endif
+}
@@ -2,12 +2,18 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+/* Ways to map the heap, given to mem_set_options before mem_init */
+#define MEM_PREFAULT 0x1  /* touch every page of the heap in mem_init */
+#define MEM_THP      0x2  /* ask for transparent huge pages */
+
+void mem_set_options(int options);
 void mem_init();               
 void mem_deinit(void);
 void *mem_sbrk(intptr_t incr);
 void mem_reset_brk(void); 
 void *mem_heap_lo(void);
 void *mem_heap_hi(void);
+void *mem_heap_used_brk(void);
 size_t mem_heapsize(void);
 size_t mem_pagesize(void);
 
@@ -18,3 +24,10 @@ uint64_t mem_read(const void *addr, size_t len);
 /* Write lower order len bytes of val to address */
 /* Require 0 <= len <= 8 */
 void mem_write(void *addr, uint64_t val, size_t len);
+
+/* Copy len bytes from src to the heap at addr */
+void mem_write_bytes(void *addr, const void *src, size_t len);
+
+/* Return the offset of the first byte at addr that differs from
+   expected, or len if all len bytes match */
+size_t mem_mismatch(const void *addr, const void *expected, size_t len);
@@ -1,6 +1,9 @@
 #include <stdio.h>
 #include <stdbool.h>
 
+/* A region that payloads are bump allocated from and released all at once */
+struct arena;
+
 #ifdef DRIVER
 
 /* declare functions for driver tests */
@@ -8,6 +11,17 @@ extern void *mm_malloc (size_t size);
 extern void mm_free (void *ptr);
 extern void *mm_realloc(void *ptr, size_t size);
 extern void *mm_calloc (size_t nmemb, size_t size);
+extern void *mm_memalign(size_t alignment, size_t size);
+extern int mm_posix_memalign(void **memptr, size_t alignment, size_t size);
+extern void *mm_aligned_alloc(size_t alignment, size_t size);
+extern void mm_free_sized(void *ptr, size_t size);
+extern size_t mm_usable_size(void *ptr);
+extern size_t mm_malloc_batch(size_t size, size_t n, void **ptrs);
+extern void mm_free_batch(void **ptrs, size_t n);
+extern struct arena *mm_arena_create(size_t chunk_size);
+extern void *mm_arena_alloc(struct arena *arena, size_t size);
+extern void mm_arena_reset(struct arena *arena);
+extern void mm_arena_destroy(struct arena *arena);
 
 #else
 
@@ -16,6 +30,17 @@ extern void *malloc (size_t size);
 extern void free (void *ptr);
 extern void *realloc(void *ptr, size_t size);
 extern void *calloc (size_t nmemb, size_t size);
+extern void *memalign(size_t alignment, size_t size);
+extern int posix_memalign(void **memptr, size_t alignment, size_t size);
+extern void *aligned_alloc(size_t alignment, size_t size);
+extern void free_sized(void *ptr, size_t size);
+extern size_t malloc_usable_size(void *ptr);
+extern size_t malloc_batch(size_t size, size_t n, void **ptrs);
+extern void free_batch(void **ptrs, size_t n);
+extern struct arena *arena_create(size_t chunk_size);
+extern void *arena_alloc(struct arena *arena, size_t size);
+extern void arena_reset(struct arena *arena);
+extern void arena_destroy(struct arena *arena);
 
 #endif
 
@@ -23,3 +48,14 @@ extern bool mm_init(void);
 
 /* This is for debugging.  Returns false if error encountered */
 extern bool mm_checkheap(int lineno);
+
+/* Checks only the blocks and free lists changed since the last check.
+   Returns false if error encountered */
+extern bool mm_checkheap_incremental(int lineno);
+
+/* For the driver's fragmentation report: free bytes per size class and
+   the largest free block.  class_size[i] is the smallest block size in
+   class i, which holds the sizes up to the next class's.  Returns the
+   number of classes filled in. */
+extern size_t mm_free_stats(size_t *class_size, size_t *free_bytes,
+                            size_t max_classes, size_t *largest);
@@ -38,6 +38,7 @@
 #include <stddef.h>
 #include <assert.h>
 #include <stddef.h>
+#include <errno.h>
 
 #include "mm.h"
 #include "memlib.h"
@@ -48,6 +49,17 @@
 #define free mm_free
 #define realloc mm_realloc
 #define calloc mm_calloc
+#define memalign mm_memalign
+#define posix_memalign mm_posix_memalign
+#define aligned_alloc mm_aligned_alloc
+#define free_sized mm_free_sized
+#define malloc_usable_size mm_usable_size
+#define malloc_batch mm_malloc_batch
+#define free_batch mm_free_batch
+#define arena_create mm_arena_create
+#define arena_alloc mm_arena_alloc
+#define arena_reset mm_arena_reset
+#define arena_destroy mm_arena_destroy
 #endif /* def DRIVER */
 
 /* You can change anything from here onward */
@@ -89,13 +101,66 @@
 #define dbg_ensures(...)
 #endif
 
+/*
+ * Allocator policy, chosen at compile time so the Makefile can build each
+ * variant into its own driver, e.g. -DMM_FIT_POLICY=MM_BEST_FIT.
+ *   MM_FIRST_FIT -- take the first block that fits
+ *   MM_NTH_FIT   -- take the best of the first MM_NTH blocks that fit
+ *   MM_BEST_FIT  -- take the best block in the first seg list with a fit
+ * MM_CHUNKSIZE is the least the heap is extended by when nothing fits.
+ * MM_LIST_ORDER is where a freed block goes in its seg list:
+ *   MM_LIFO       -- at the head
+ *   MM_FIFO       -- at the tail
+ *   MM_ADDR_ORDER -- in address order, so first fit is address-ordered
+ * The slab list is always LIFO.
+ * MM_SPLIT_THRESHOLD splits a free block from its high end for requests
+ * smaller than it and from its low end for the rest, so that small and
+ * large blocks gather at opposite ends of the free space.  0 always
+ * splits from the low end.
+ * MM_RUN_MAX is the largest request served from a run: a block of
+ * same-size objects with one free list per object size, found through
+ * a one byte mini header like a slab instead of a block header (at most
+ * 1007, 0 for no runs, the default).  Runs speed up traces of many
+ * small objects, but they hold memory that only their size can use,
+ * which costs utilization: 31 already lowers the average on the default
+ * traces, and larger limits lower it further.
+ */
+#define MM_FIRST_FIT 1
+#define MM_NTH_FIT 2
+#define MM_BEST_FIT 3
+
+#define MM_LIFO 1
+#define MM_FIFO 2
+#define MM_ADDR_ORDER 3
+
+#ifndef MM_FIT_POLICY
+#define MM_FIT_POLICY MM_NTH_FIT
+#endif
+#ifndef MM_NTH
+#define MM_NTH 30
+#endif
+#ifndef MM_CHUNKSIZE
+#define MM_CHUNKSIZE (1 << 9)
+#endif
+#ifndef MM_LIST_ORDER
+#define MM_LIST_ORDER MM_LIFO
+#endif
+#ifndef MM_SPLIT_THRESHOLD
+#define MM_SPLIT_THRESHOLD 0
+#endif
+#ifndef MM_RUN_MAX
+#define MM_RUN_MAX 0
+#endif
+
 /* Basic constants */
 typedef uint64_t word_t;
 static const size_t wsize = sizeof(word_t);   // word and header size (bytes)
 static const size_t dsize = 2*sizeof(word_t);       // double word size (bytes)
 static const size_t min_block_size = 4*sizeof(word_t); // Minimum block size
-static const size_t chunksize = (1 << 9);    // requires (chunksize % 16 == 0)
+static const size_t chunksize = MM_CHUNKSIZE;    // requires (chunksize % 16 == 0)
+static const size_t split_threshold = MM_SPLIT_THRESHOLD; // smaller requests split from the high end
 static const size_t mm_init_chunksize = (1 << 12);    // requires (chunksize % 16 == 0)
+static const size_t arena_chunksize = (1 << 12); // arena chunk size unless one is asked for
 
 static const word_t is_slab_mask = 0x1; // both checks for if it's a slab and a slab block
 static const word_t alloc_mask = 0x2;
@@ -103,7 +168,7 @@ static const word_t prev_alloc_mask = 0x4;
 static const word_t size_mask = ~(word_t)0xF;
 static const word_t ptr_mask = ~(word_t)0x7;
 
-static const int N = 30; // N for Nth fit -- best seems to be ~30
+static const int N = MM_NTH; // N for Nth fit -- best seems to be ~30
 static const size_t min_moe_size = 256;
 static const size_t max_size = ~0x0;
 
@@ -115,6 +180,20 @@ static const size_t slab_block_size = num_slabs * slab_size + (slab_block_overhe
 
 static const word_t vector_mask =  ~((word_t) 0xFFFFFFFFFFFFFFFF << num_slabs);
 static const word_t vector_slab_header_mask = 0xFF00000000000000;
+static const word_t slab_dist_mask = 0x3F; // mini header bits 1-6: distance to the payload start in slabs
+
+static const size_t run_max_size = MM_RUN_MAX; // max number of bytes in a run object
+static const size_t run_max_objects = 32; // number of objects in a run of the smallest stride
+static const size_t run_max_dist = 63; // farthest an object can be from the run payload start, in dsize units
+static const word_t run_mini_mask = 0x80; // mini header bit for an object in a run
+// run bit vector: objects in bits 0-31, block size / dsize in bits 32-47,
+// stride / dsize in bits 48-55 and the first mini header in bits 56-63
+static const word_t run_vector_mask = 0xFFFFFFFF;
+static const int run_size_shift = 32;
+static const int run_stride_shift = 48;
+static const word_t run_vector_flag = 0x8000000000000000; // run bit of the first mini header
+static const word_t run_size_mask = 0xFFFF;
+static const word_t run_stride_mask = 0xFF;
 
 
 typedef struct block
@@ -136,6 +215,15 @@ typedef struct block
     };
 } block_t;
 
+// An arena bump allocates payloads out of chunks it mallocs, and frees the
+// chunks all at once.  Each chunk starts with a pointer to the chunk before it.
+struct arena {
+    void **chunks;     // the newest chunk, which payloads are bumped out of
+    char *next;        // next free byte of the newest chunk
+    char *end;         // end of the newest chunk
+    size_t chunk_size; // bytes asked for each chunk, past its pointer
+};
+
 
 /*** Global Variables ***/
 
@@ -143,12 +231,44 @@ typedef struct block
 static block_t *heap_start = NULL; // Pointer to the first block in the heap
 // Segregated Free List Headers
 static block_t *seg_lists[] = {NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL};
+// Segregated Free List Tails -- where MM_FIFO inserts
+static block_t *seg_tails[] = {NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL};
+// Blocks of each list to start an MM_ADDR_ORDER search from: the highest
+// block of the list in each 2^finger_region_bits byte region of the heap,
+// with a bit for each region that has one and a summary bit for each word
+// of those.  There are enough regions for memlib's 100MB heap; the last
+// one takes any heap past them.
+#define FINGER_REGIONS (MM_LIST_ORDER == MM_ADDR_ORDER ? (100 << 20) >> 12 : 64)
+#define FINGER_WORDS ((FINGER_REGIONS + 63) / 64)
+static block_t *seg_fingers[13][FINGER_REGIONS];
+static word_t finger_bits[13][FINGER_WORDS];
+static word_t finger_summary[13][(FINGER_WORDS + 63) / 64];
+static size_t finger_regions_used = 0; // regions given a finger since mm_init
+// Runs with a free object, one list for each object stride from 32 bytes up
+static block_t *run_lists[MM_RUN_MAX / 16 + 1];
+
+// Blocks whose headers were written and seg lists that were changed since
+// the last incremental heap check.  Overflowing the buffer forces a full check.
+static block_t *dirty_blocks[64];
+static const size_t max_dirty_blocks = 64;
+static size_t dirty_count = 0;
+static bool dirty_overflow = true;
+static word_t dirty_lists = 0;
+static word_t dirty_run_lists = 0; // one bit per run list; there are at most 63
+
+// Every byte of the heap from zero_start up is still zero, as no heap since
+// mem_init has used it, except the header, list pointers and footer of the free block at the end
+// of the heap.  place records whether it took its block from there, so
+// calloc knows what it has to clear.
+static char *zero_start = NULL;
+static bool placed_zeroed = false;
 
 /*** End Global Variables ***/
 
 // Segregated List Constants
 
 static const size_t seg_list_count = 13;
+static const int finger_region_bits = 12; // bytes of heap covered by a finger, log2
 static const size_t slab_list_index = 0; // put slab blocks in the first seg list
 // Segregated Free List Sizes
 static const size_t seg_list_idx_1 = 1;
@@ -168,9 +288,15 @@ static const size_t seg_list_sizes[] = {slab_block_size, 32, 48, 64, 80, 96, 112
 
 /* Function prototypes for internal helper routines */
 static block_t *extend_heap(size_t size);
-static void place(block_t *block, size_t asize);
+static block_t *place(block_t *block, size_t asize);
+static block_t *place_aligned(block_t *block, size_t asize, size_t alignment);
+static size_t place_batch(block_t *block, size_t asize, size_t n, void **ptrs);
 static block_t *find_fit(size_t asize);
+static block_t *find_aligned_fit(size_t asize, size_t alignment);
+static size_t aligned_lead(block_t *block, size_t alignment);
 static block_t *coalesce(block_t *block);
+static void raise_zero_start(void *addr);
+static void free_chunks(void **chunk);
 
 static size_t max(size_t x, size_t y);
 static size_t round_up(size_t size, size_t n);
@@ -196,6 +322,13 @@ static word_t *find_prev_footer(block_t *block);
 static block_t *find_prev(block_t *block);
 
 static void list_insert(block_t *block);
+static void list_insert_slack(block_t *block);
+static void list_link(size_t list_index, block_t *block, block_t *prev);
+static block_t *find_addr_prev(size_t list_index, block_t *block);
+static size_t finger_region(block_t *block);
+static void finger_insert(size_t list_index, block_t *block);
+static void finger_remove(size_t list_index, block_t *block, block_t *prev);
+static block_t *finger_below(size_t list_index, size_t region);
 static void list_remove(block_t *block);
 
 static size_t find_seg_list_index(size_t asize);
@@ -203,7 +336,10 @@ static size_t find_seg_list_index(size_t asize);
 // SLABS FUNCTIONS
 
 static void *place_in_slab();
+static size_t place_in_slab_batch(void **ptrs, size_t n);
 static block_t *free_from_slab(void *sp);
+static block_t *free_from_slab_batch(block_t *slab_block, word_t freed);
+static word_t lowest_bits(word_t bits, size_t n);
 
 static block_t *init_slab_block();
 static size_t get_free_slab(block_t *slab_block);
@@ -222,10 +358,32 @@ static bool is_slab(void *sp);
 static bool is_slab_block_full(block_t *block);
 static bool is_slab_block_empty(block_t *block);
 static void set_is_slab(block_t *block, bool is_slab);
+static block_t **slab_list_head(block_t *block);
+
+static void *place_in_run(size_t size);
+static size_t place_in_run_batch(size_t size, void **ptrs, size_t n);
+static block_t *free_from_run(void *rp);
+static block_t *init_run_block(size_t stride);
+static size_t run_objects(size_t stride);
+static size_t run_stride(block_t *run);
+static size_t run_list_index(size_t stride);
+static bool is_run_block(block_t *block);
+static bool is_run(void *rp);
+static bool is_run_full(block_t *run);
+static bool is_run_empty(block_t *run);
 
 // END SLABS FUNCTIONS
 
+static void mark_dirty(block_t *block);
+static void mark_slab_list_dirty(block_t *block);
+static void clear_dirty();
+static bool check_block(block_t *b, int line, int *heap_count);
+static bool check_seg_list(size_t list_index, int line, int *free_list_count);
+static bool check_slab_list(int line);
+static bool check_run_list(size_t list_index, int line);
+
 bool mm_checkheap(int lineno);
+bool mm_checkheap_incremental(int lineno);
 bool print_heap();
 bool print_seg_lists();
 
@@ -241,6 +399,11 @@ bool print_seg_lists();
  * - Added prev_alloc functionality for Remove Footers.
  * - Added Seg List Initialization.
  * - Added Slab bit to pack function calls.
+ * - Resets the dirty block tracking for incremental heap checking.
+ * - Resets the seg list tails and fingers.
+ * - Resets the run lists.
+ * - Resets the zeroed part of the heap.
+ * - Starts the zeroed part of the heap at the highest break since mem_init.
  */
 bool mm_init(void) 
 {
@@ -248,7 +411,19 @@ bool mm_init(void)
     // set seg list heads to NULL for when the code resets
     for(size_t i = 0; i < seg_list_count; i++) {
         seg_lists[i] = NULL;
+        seg_tails[i] = NULL;
+        memset(seg_fingers[i], 0, finger_regions_used * sizeof(block_t *));
+        memset(finger_bits[i], 0, (finger_regions_used + 63) / 64 * sizeof(word_t));
+        memset(finger_summary[i], 0, sizeof(finger_summary[i]));
+    }
+    finger_regions_used = 0;
+    for(size_t i = 0; i < sizeof(run_lists) / sizeof(run_lists[0]); i++) {
+        run_lists[i] = NULL;
     }
+    // the old heap is gone, so the next incremental check must be a full one
+    clear_dirty();
+    dirty_overflow = true;
+    zero_start = mem_heap_used_brk();
 
     // Create the initial empty heap 
     word_t *start = (word_t *)(mem_sbrk(2*wsize));
@@ -278,6 +453,7 @@ bool mm_init(void)
  * - Provided Function at Init.
  * - Updated to utilize space with Remove Footers.
  * - Added Slabs functionality.
+ * - Added Runs functionality.
  */
 void *malloc(size_t size) 
 {
@@ -306,6 +482,11 @@ void *malloc(size_t size)
         return sp;
     }
 
+    // run code for the sizes with a run
+    if(size <= run_max_size) {
+        return place_in_run(size);
+    }
+
     // Adjust block size to include overhead and to meet alignment requirements
     asize = round_up(size + wsize, dsize);
 
@@ -324,7 +505,7 @@ void *malloc(size_t size)
 
     }
 
-    place(block, asize);
+    block = place(block, asize);
     bp = header_to_payload(block);
 
     return bp;
@@ -337,6 +518,7 @@ void *malloc(size_t size)
  * - Provided Function at Init.
  * - Updated to work better with Remove Footers.
  * - Added Slabs functionality.
+ * - Added Runs functionality.
  */
 void free(void *bp)
 {
@@ -351,9 +533,9 @@ void free(void *bp)
     }
 
     if(is_slab(bp)) {
-        block = free_from_slab(bp);
-        if(!is_slab_block_empty(block)) {
-            return; // if slab block is not empty, don't coalesce
+        block = is_run(bp) ? free_from_run(bp) : free_from_slab(bp);
+        if(is_slab_block(block)) {
+            return; // if the slab block or run is not empty, don't coalesce
         }
     } else { // regular block
         block = payload_to_header(bp);
@@ -367,10 +549,10 @@ void free(void *bp)
  *
  * @Changelog
  * - Provided Function at Init.
+ * - Copies the usable size, since slabs and runs have no block header.
  */
 void *realloc(void *ptr, size_t size)
 {
-    block_t *block = payload_to_header(ptr);
     size_t copysize;
     void *newptr;
 
@@ -396,7 +578,7 @@ void *realloc(void *ptr, size_t size)
     }
 
     // Copy the old data
-    copysize = get_payload_size(block); // gets size of old payload
+    copysize = malloc_usable_size(ptr); // gets size of old payload
     if(size < copysize)
     {
         copysize = size;
@@ -414,6 +596,7 @@ void *realloc(void *ptr, size_t size)
  *
  * @Changelog
  * - Provided Function at Init.
+ * - Only clears what was written in a block placed from zeroed heap.
  */
 void *calloc(size_t elements, size_t size)
 {
@@ -426,17 +609,445 @@ void *calloc(size_t elements, size_t size)
         return NULL;
     }
     
+    placed_zeroed = false;
     bp = malloc(asize);
     if (bp == NULL)
     {
         return NULL;
     }
-    // Initialize all bits to 0
-    memset(bp, 0, asize);
 
+    if(placed_zeroed) {
+        // only the old list pointers and footer of the free block can be set
+        block_t *block = payload_to_header(bp);
+        memset(bp, 0, dsize);
+        memset((char *) bp + get_payload_size(block) - wsize, 0, wsize);
+    } else {
+        // Initialize all bits to 0
+        memset(bp, 0, asize);
+    }
+
+    return bp;
+}
+
+/**
+ * @brief allocates a block whose payload is a multiple of alignment bytes
+ *        into the heap, by carving it out of a free block and putting the
+ *        free space before it back on the seg lists
+ *
+ * @param alignment a power of two
+ * @param size the number of bytes requested
+ *
+ * @return the payload, or NULL if alignment is not a power of two or
+ *         the heap can't be extended
+ *
+ * @Changelog
+ * - Added Function for Aligned Allocation.
+ * - Added a size check so huge requests can't overflow the fit size.
+ */
+void *memalign(size_t alignment, size_t size)
+{
+    dbg_printf(BOLD GREEN"MEMALIGN CALLED with alignment: %lu, size: %lu\n"RESET, alignment, size);
+    dbg_requires(mm_checkheap(__LINE__));
+    size_t asize;      // Adjusted block size
+    size_t fitsize;    // Block size that fits wherever it starts
+    block_t *block;
+
+    if (alignment == 0 || (alignment & (alignment - 1)) != 0) {
+        return NULL;
+    }
+    // every payload is already aligned to dsize
+    if (alignment <= dsize) {
+        return malloc(size);
+    }
+
+    if (heap_start == NULL) { // Initialize heap if it isn't initialized
+        mm_init();
+    }
+
+    if (size == 0) { // Ignore spurious request
+        return NULL;
+    }
+    // fitsize would wrap around, as rounding adds up to wsize + dsize - 1
+    if (size > SIZE_MAX - alignment - min_block_size - 2 * dsize) {
+        return NULL;
+    }
+
+    asize = max(round_up(size + wsize, dsize), min_block_size);
+    fitsize = asize + alignment + min_block_size;
+
+    block = find_aligned_fit(asize, alignment);
+    if (block == NULL)
+    {
+        block = extend_heap(max(fitsize, chunksize));
+        if (block == NULL) // extend_heap returns an error
+        {
+            return NULL;
+        }
+    }
+
+    block = place_aligned(block, asize, alignment);
+
+    dbg_ensures(mm_checkheap(__LINE__));
+    return header_to_payload(block);
+}
+
+/**
+ * @brief overload the posix_memalign function with our implementation
+ *
+ * @Changelog
+ * - Added Function for Aligned Allocation.
+ */
+int posix_memalign(void **memptr, size_t alignment, size_t size)
+{
+    void *bp;
+
+    if (alignment % sizeof(void *) != 0 || (alignment & (alignment - 1)) != 0) {
+        return EINVAL;
+    }
+    bp = memalign(alignment, size);
+    if (bp == NULL && size != 0) {
+        return ENOMEM;
+    }
+    *memptr = bp;
+    return 0;
+}
+
+/**
+ * @brief overload the aligned_alloc function with our implementation
+ *
+ * @Changelog
+ * - Added Function for Aligned Allocation.
+ */
+void *aligned_alloc(size_t alignment, size_t size)
+{
+    return memalign(alignment, size);
+}
+
+/**
+ * @brief frees a payload from malloc, calloc or realloc given the size it
+ *        was allocated with, which says whether it is a slab, an object in
+ *        a run or a block without reading its mini header
+ *
+ * @param bp the payload
+ * @param size the size it was allocated with.  Payloads from memalign
+ *        must be freed with free, since a small one is not in a slab.
+ *
+ * @Changelog
+ * - Added Function for Sized Free.
+ */
+void free_sized(void *bp, size_t size)
+{
+    dbg_printf(BOLD CYAN"FREE_SIZED CALLED with addr: %p, size: %lu\n"RESET, bp, size);
+    dbg_ensures(print_heap());
+    dbg_ensures(print_seg_lists());
+
+    block_t *block;
+
+    if (bp == NULL) {
+        return;
+    }
+
+    if(size <= slab_payload_size) {
+        block = free_from_slab(bp);
+    } else if(size <= run_max_size) {
+        block = free_from_run(bp);
+    } else {
+        block = payload_to_header(bp);
+    }
+    if(is_slab_block(block)) {
+        return; // if the slab block or run is not empty, don't coalesce
+    }
+
+    update_next_prev_alloc(coalesce(block), false);
+}
+
+/**
+ * @brief returns how many bytes of a payload can be used, which can be more
+ *        than were asked for
+ *
+ * @param bp the payload
+ *
+ * @return the usable size, 0 for NULL
+ *
+ * @Changelog
+ * - Added Function for Sized Free.
+ */
+size_t malloc_usable_size(void *bp)
+{
+    if (bp == NULL) {
+        return 0;
+    }
+
+    // slabs and run objects end a byte short so the next mini header fits
+    if(is_slab(bp)) {
+        return is_run(bp) ? run_stride(slab_to_header(bp)) - 1 : slab_payload_size;
+    }
+    return get_payload_size(payload_to_header(bp));
+}
+
+/**
+ * @brief allocates n payloads of the same size at once.  Slabs and run
+ *        objects are taken a whole bit vector at a time, and blocks are
+ *        split off one free block in a single pass, so each find_fit and
+ *        list update is shared by many payloads.
+ *
+ * @param size the number of bytes requested for each payload
+ * @param n the number of payloads
+ * @param ptrs where the payloads are stored
+ *
+ * @return the number of payloads stored, fewer than n only if the heap
+ *         can't be extended, and 0 if size is 0
+ *
+ * @Changelog
+ * - Added Function for Batch Allocation.
+ */
+size_t malloc_batch(size_t size, size_t n, void **ptrs)
+{
+    dbg_printf(BOLD RED"MALLOC_BATCH CALLED with size: %lu, n: %lu\n"RESET, size, n);
+    dbg_requires(mm_checkheap(__LINE__));
+    size_t asize;      // Adjusted block size
+    size_t placed = 0;
+    size_t count;
+    block_t *block;
+
+    if (heap_start == NULL) { // Initialize heap if it isn't initialized
+        mm_init();
+    }
+
+    if (size == 0) { // Ignore spurious request
+        return 0;
+    }
+
+    if(size <= slab_payload_size) {
+        while(placed < n && (count = place_in_slab_batch(ptrs + placed, n - placed)) != 0) {
+            placed += count;
+        }
+        return placed;
+    }
+
+    if(size <= run_max_size) {
+        while(placed < n && (count = place_in_run_batch(size, ptrs + placed, n - placed)) != 0) {
+            placed += count;
+        }
+        return placed;
+    }
+
+    asize = round_up(size + wsize, dsize);
+    while(placed < n) {
+        block = find_fit(asize);
+
+        // extend the heap by enough for the rest of the batch at once
+        if (block == NULL)
+        {
+            block = extend_heap(max(asize * (n - placed), chunksize));
+            if (block == NULL) // extend_heap returns an error
+            {
+                break;
+            }
+        }
+
+        placed += place_batch(block, asize, n - placed, ptrs + placed);
+    }
+
+    dbg_ensures(mm_checkheap(__LINE__));
+    return placed;
+}
+
+/**
+ * @brief frees n payloads at once.  Slabs and run objects that follow each
+ *        other in ptrs and share a slab block or run are cleared from its
+ *        bit vector together, and blocks that follow each other in ptrs and
+ *        in the heap are joined and coalesced once.
+ *
+ * @param ptrs the payloads, any of which may be NULL
+ * @param n the number of payloads
+ *
+ * @Changelog
+ * - Added Function for Batch Allocation.
+ */
+void free_batch(void **ptrs, size_t n)
+{
+    dbg_printf(BOLD CYAN"FREE_BATCH CALLED with n: %lu\n"RESET, n);
+    block_t *block;
+    size_t i = 0;
+
+    while(i < n) {
+        void *bp = ptrs[i];
+        if (bp == NULL) {
+            i++;
+            continue;
+        }
+
+        if(is_slab(bp)) {
+            block_t *slab_block = slab_to_header(bp);
+            bool run = is_run_block(slab_block);
+            size_t stride = run ? run_stride(slab_block) : slab_size;
+            word_t freed = 0;
+            for(; i < n && ptrs[i] != NULL && is_slab(ptrs[i])
+                    && slab_to_header(ptrs[i]) == slab_block; i++) {
+                size_t index = run ? (size_t) ((char *) ptrs[i] - slab_block->slab.payload) / stride
+                                   : get_slab_index(ptrs[i]);
+                freed |= 0x1ull << index;
+            }
+            block = free_from_slab_batch(slab_block, freed);
+            if(is_slab_block(block)) {
+                continue; // if the slab block or run is not empty, don't coalesce
+            }
+        } else { // regular blocks, joined while the next one follows in the heap
+            block = payload_to_header(bp);
+            block_t *next = find_next(block);
+            size_t size = get_size(block);
+            for(i++; i < n && ptrs[i] == header_to_payload(next) && !is_slab(ptrs[i]); i++) {
+                size += get_size(next);
+                next = find_next(next);
+            }
+            if(size != get_size(block)) {
+                write_header(block, size, true, get_prev_alloc(block));
+            }
+        }
+
+        update_next_prev_alloc(coalesce(block), false);
+    }
+
+    dbg_ensures(mm_checkheap(__LINE__));
+}
+
+/**
+ * @brief creates an arena that payloads can be bump allocated from and
+ *        then released all at once
+ *
+ * @param chunk_size the bytes of payload each chunk of the arena holds,
+ *        or 0 for arena_chunksize
+ *
+ * @return the arena, or NULL if chunk_size is too big or it couldn't be
+ *         allocated
+ *
+ * @Changelog
+ * - Added Function for Arenas.
+ * - Added a chunk size check so huge chunks can't overflow.
+ */
+struct arena *arena_create(size_t chunk_size)
+{
+    struct arena *arena;
+
+    // a chunk this big would wrap around like a request in arena_alloc
+    if (chunk_size > SIZE_MAX - 4 * dsize) {
+        return NULL;
+    }
+
+    arena = malloc(sizeof(struct arena));
+    if (arena == NULL) {
+        return NULL;
+    }
+    arena->chunks = NULL;
+    arena->next = NULL;
+    arena->end = NULL;
+    arena->chunk_size = chunk_size != 0 ? round_up(chunk_size, dsize) : arena_chunksize;
+    return arena;
+}
+
+/**
+ * @brief allocates a payload from an arena by bumping past it in the
+ *        newest chunk, or by mallocing a new chunk once that is full.  A
+ *        request bigger than a chunk gets a chunk of its own, which goes
+ *        behind the newest one so its free space isn't lost.  The payload
+ *        can't be freed on its own, only with arena_reset or arena_destroy.
+ *
+ * @param arena the arena
+ * @param size the number of bytes requested
+ *
+ * @return the payload, or NULL if size is 0 or too big, or the heap
+ *         can't be extended
+ *
+ * @Changelog
+ * - Added Function for Arenas.
+ * - Added a size check so huge requests can't overflow the chunk size.
+ */
+void *arena_alloc(struct arena *arena, size_t size)
+{
+    void **chunk;
+    void *bp;
+
+    if (size == 0) { // Ignore spurious request
+        return NULL;
+    }
+
+    // the chunk's size would wrap around, as rounding, the pointer to the
+    // chunk before and malloc's own rounding add up to 3 * dsize + wsize - 2
+    if (size > SIZE_MAX - 4 * dsize) {
+        return NULL;
+    }
+
+    // keep every payload aligned to dsize
+    size = round_up(size, dsize);
+    if (size <= (size_t) (arena->end - arena->next)) {
+        bp = arena->next;
+        arena->next += size;
+        return bp;
+    }
+
+    // the pointer to the chunk before takes a dsize so payloads stay aligned
+    chunk = malloc(dsize + max(size, arena->chunk_size));
+    if (chunk == NULL) {
+        return NULL;
+    }
+    bp = (char *) chunk + dsize;
+
+    if (size > arena->chunk_size && arena->chunks != NULL) {
+        chunk[0] = arena->chunks[0];
+        arena->chunks[0] = chunk;
+        return bp;
+    }
+
+    chunk[0] = arena->chunks;
+    arena->chunks = chunk;
+    arena->next = (char *) bp + size;
+    arena->end = (char *) chunk + malloc_usable_size(chunk);
     return bp;
 }
 
+/**
+ * @brief releases every payload of an arena, keeping only its newest chunk
+ *        to allocate from again and freeing the rest
+ *
+ * @param arena the arena
+ *
+ * @Changelog
+ * - Added Function for Arenas.
+ */
+void arena_reset(struct arena *arena)
+{
+    void **chunk = arena->chunks;
+
+    if (chunk == NULL) {
+        return;
+    }
+
+    free_chunks(chunk[0]);
+    chunk[0] = NULL;
+    arena->next = (char *) chunk + dsize;
+    arena->end = (char *) chunk + malloc_usable_size(chunk);
+}
+
+/**
+ * @brief releases every payload of an arena and the arena itself, by
+ *        freeing each of its chunks with a single coalesce
+ *
+ * @param arena the arena, or NULL
+ *
+ * @Changelog
+ * - Added Function for Arenas.
+ */
+void arena_destroy(struct arena *arena)
+{
+    if (arena == NULL) {
+        return;
+    }
+
+    free_chunks(arena->chunks);
+    free(arena);
+}
+
 /******** The remaining content below are helper and debug routines ********/;
 
 /**
@@ -451,6 +1062,7 @@ void *calloc(size_t elements, size_t size)
  * - Provided Function at Init.
  * - Added prev_alloc functionality for Remove Footers.
  * - Added Slabs functionality.
+ * - Keeps track of the zeroed part of the heap.
  */
 static block_t *extend_heap(size_t size) 
 {
@@ -462,6 +1074,9 @@ static block_t *extend_heap(size_t size)
     {
         return NULL;
     }
+    // the new memory is zero, but the old end of the heap no longer is the
+    // metadata of a block at the end of the heap once it is coalesced
+    raise_zero_start(bp);
     
     // Initialize free block header/footer 
     block_t *block = payload_to_header(bp);
@@ -490,6 +1105,7 @@ static block_t *extend_heap(size_t size)
  * - Provided Function at Init.  Added functionality to it.
  * - Added explicit free list insert and remove.
  * - Added prev_alloc functionality for Remove Footers.
+ * - Keeps track of the zeroed part of the heap.
  */
 static block_t *coalesce(block_t * block) 
 {
@@ -509,6 +1125,10 @@ static block_t *coalesce(block_t * block)
     }
 
     size_t next_size = get_size(next_block);
+    if(!next_alloc) {
+        // the next block's header and list pointers are left in the middle
+        raise_zero_start(&next_block->prev + 1);
+    }
 
     // case 2
     if(prev_alloc && !next_alloc) {
@@ -548,29 +1168,86 @@ static block_t *coalesce(block_t * block)
 }
 
 /**
- * @brief splits the block into a block with the given size if it can be split,
- *          else writes the new header and footer for the given block
+ * @brief moves zero_start up to addr, once the heap below addr has been
+ *        handed out or has metadata in it that no block owns anymore
  *
- * @param block the block being allocated
- * @param asize the required number of bytes
+ * @param addr the lowest address that may still be zero
  *
  * @Changelog
- * - Provided Function at Init.
- * - Added explicit free list insert and remove.
- * - Added prev_alloc functionality for Remove Footers.
- * - Slightly modified to work correctly with Segregated Lists.
- * - Added Slabs bit functionality.
+ * - Added for Zeroed calloc.
  */
-static void place(block_t *block, size_t asize)
+static void raise_zero_start(void *addr)
 {
-    size_t csize = get_size(block);
-    bool prev_alloc = get_prev_alloc(block);
-
-    if ((csize - asize) >= min_block_size)
-    {
-        block_t *block_next;
-        list_remove(block);
-        write_header(block, asize, true, prev_alloc);
+    if((char *) addr > zero_start) {
+        zero_start = addr;
+    }
+}
+
+/**
+ * @brief frees a chunk of an arena and every chunk before it
+ *
+ * @param chunk the newest of the chunks, or NULL
+ *
+ * @Changelog
+ * - Added Function for Arenas.
+ */
+static void free_chunks(void **chunk)
+{
+    while (chunk != NULL) {
+        void **prev = chunk[0];
+        free(chunk);
+        chunk = prev;
+    }
+}
+
+/**
+ * @brief splits the block into a block with the given size if it can be split,
+ *          else writes the new header and footer for the given block
+ *
+ * @param block the block being allocated
+ * @param asize the required number of bytes
+ *
+ * @return the allocated block, which is at the high end of the given block
+ *          if it was split for a request below split_threshold
+ *
+ * @Changelog
+ * - Provided Function at Init.
+ * - Added explicit free list insert and remove.
+ * - Added prev_alloc functionality for Remove Footers.
+ * - Slightly modified to work correctly with Segregated Lists.
+ * - Added Slabs bit functionality.
+ * - Places small requests at the high end with MM_SPLIT_THRESHOLD.
+ * - Records whether the allocated block came from the zeroed heap.
+ */
+static block_t *place(block_t *block, size_t asize)
+{
+    size_t csize = get_size(block);
+    bool prev_alloc = get_prev_alloc(block);
+
+    // the last block stays split from the low end, so its free remainder is
+    // still at the end of the heap for extend_heap to coalesce with
+    if ((csize - asize) >= min_block_size && asize < split_threshold
+            && get_size(find_next(block)) != 0)
+    {
+        block_t *block_alloc;
+        list_remove(block);
+        write_header(block, csize-asize, false, prev_alloc);
+        write_footer(block, csize-asize, false, prev_alloc);
+        list_insert(block);
+
+        block_alloc = find_next(block);
+        set_is_slab(block_alloc, false);
+        write_header(block_alloc, asize, true, false);
+        update_next_prev_alloc(block_alloc, true);
+        placed_zeroed = block_alloc->payload >= zero_start;
+        raise_zero_start(find_next(block_alloc));
+        return block_alloc;
+    }
+    else if ((csize - asize) >= min_block_size)
+    {
+        block_t *block_next;
+        list_remove(block);
+        write_header(block, asize, true, prev_alloc);
 
         block_next = find_next(block);
         prev_alloc = true; // set prev_alloc to true since we just allocated the previous block
@@ -586,6 +1263,110 @@ static void place(block_t *block, size_t asize)
         write_header(block, csize, true, prev_alloc);
         update_next_prev_alloc(block, true);
     }
+    placed_zeroed = block->payload >= zero_start;
+    raise_zero_start(find_next(block));
+    return block;
+}
+
+/**
+ * @brief places an allocated block of asize bytes with its payload aligned
+ *        to alignment in the given block, splitting off the free space before
+ *        and after it.  Always splits from the low end, since the payload
+ *        could not be aligned at the high end.
+ *
+ * @param block a free block with room for asize bytes past its aligned_lead
+ * @param asize the required number of bytes
+ * @param alignment a power of two greater than dsize
+ *
+ * @return the allocated block
+ *
+ * @Changelog
+ * - Added Function for Aligned Allocation.
+ * - Puts the free space before the payload at the back of its seg list.
+ */
+static block_t *place_aligned(block_t *block, size_t asize, size_t alignment)
+{
+    size_t csize = get_size(block);
+    bool prev_alloc = get_prev_alloc(block);
+    size_t lead = aligned_lead(block, alignment);
+
+    list_remove(block);
+    if(lead != 0) {
+        write_header(block, lead, false, prev_alloc);
+        write_footer(block, lead, false, prev_alloc);
+        list_insert_slack(block);
+
+        block = find_next(block);
+        set_is_slab(block, false);
+        csize -= lead;
+        prev_alloc = false;
+    }
+
+    if((csize - asize) >= min_block_size) {
+        block_t *block_next;
+        write_header(block, asize, true, prev_alloc);
+
+        block_next = find_next(block);
+        set_is_slab(block_next, false);
+        write_header(block_next, csize-asize, false, true);
+        write_footer(block_next, csize-asize, false, true);
+        update_next_prev_alloc(block_next, false);
+        list_insert(block_next);
+    } else {
+        write_header(block, csize, true, prev_alloc);
+        update_next_prev_alloc(block, true);
+    }
+    raise_zero_start(find_next(block));
+    return block;
+}
+
+/**
+ * @brief splits as many allocated blocks of asize bytes as are wanted, up to
+ *        n, off the low end of a free block in one pass.  Only the first
+ *        block's prev_alloc bit and the remainder need working out, since
+ *        every other block follows an allocated one.
+ *
+ * @param block the free block
+ * @param asize the required number of bytes for each block
+ * @param n the most blocks wanted
+ * @param ptrs where the payloads are stored
+ *
+ * @return the number of blocks placed, at least 1
+ *
+ * @Changelog
+ * - Added Function for Batch Allocation.
+ */
+static size_t place_batch(block_t *block, size_t asize, size_t n, void **ptrs)
+{
+    size_t csize = get_size(block);
+    bool prev_alloc = get_prev_alloc(block);
+    size_t count = csize / asize < n ? csize / asize : n;
+    size_t rest = csize - count * asize;
+    block_t *last = block;
+
+    list_remove(block);
+    for(size_t i = 0; i < count; i++) {
+        last = block;
+        set_is_slab(last, false);
+        // a remainder too small to be a block stays with the last one
+        size_t bsize = (i == count - 1 && rest < min_block_size) ? asize + rest : asize;
+        write_header(last, bsize, true, prev_alloc);
+        ptrs[i] = header_to_payload(last);
+        prev_alloc = true;
+        block = find_next(last);
+    }
+
+    if(rest >= min_block_size) {
+        set_is_slab(block, false);
+        write_header(block, rest, false, true);
+        write_footer(block, rest, false, true);
+        update_next_prev_alloc(block, false);
+        list_insert(block);
+    } else {
+        update_next_prev_alloc(last, true);
+    }
+    raise_zero_start(find_next(last));
+    return count;
 }
 
 /**
@@ -600,6 +1381,7 @@ static void place(block_t *block, size_t asize)
  * - Changed to find first block in the explicit free list.
  * - Changed to Nth fit algorithm with explicit free list.
  * - Changed to Nth fit with Segregated Free Lists.
+ * - Fit policy chosen at compile time with MM_FIT_POLICY.
  * - Added checks for Slabs.
  */
 static block_t *find_fit(size_t asize)
@@ -644,6 +1426,10 @@ static block_t *find_fit(size_t asize)
                     continue;
                 }
 
+                if(MM_FIT_POLICY == MM_FIRST_FIT) {
+                    return block;
+                }
+
                 if(block_size < best_block_size) {
                     best_block = block;
                     best_block_size = block_size;
@@ -651,7 +1437,7 @@ static block_t *find_fit(size_t asize)
             }
 
             // end the loop if we have found N blocks that fit
-            if(blocks_found >= N) {
+            if(MM_FIT_POLICY == MM_NTH_FIT && blocks_found >= N) {
                 return best_block;
             }
         }
@@ -665,6 +1451,93 @@ static block_t *find_fit(size_t asize)
     return best_block; // NULL if no block found
 }
 
+/**
+ * @brief finds a block that can hold asize bytes with the payload aligned
+ *        to alignment.  Takes the first one, and looks at no more than N
+ *        blocks in all of the seg lists whose blocks might not fit, since
+ *        the free blocks left before aligned payloads gather there.  Lists
+ *        too small for any lead only have their head looked at.
+ *
+ * @param asize the required number of bytes
+ * @param alignment a power of two greater than dsize
+ *
+ * @return the block, or NULL if no such block was found
+ *
+ * @Changelog
+ * - Added Function for Aligned Allocation.
+ * - Bounded the search of the list fitsize falls in, and shared the bound
+ *   between lists, so lists full of lead slack can't be scanned end to end.
+ * - Only looks at the head of lists too small for any lead.
+ * - Stops at the lead slack at the back of a LIFO list.
+ */
+static block_t *find_aligned_fit(size_t asize, size_t alignment)
+{
+    // a block this big fits however its payload is aligned
+    size_t fitsize = asize + alignment + min_block_size;
+    size_t fit_index = find_seg_list_index(fitsize);
+
+    int blocks_checked = 0;
+
+    // fitsize's own list holds blocks either side of it, so it counts too
+    for(size_t i = find_seg_list_index(asize); i <= fit_index; i++) {
+        // no block in this list has room for a lead, so only one whose payload
+        // is already aligned fits.  One freed from an aligned payload goes in
+        // at the head, and the lead slack that fills these lists at the tail.
+        if(seg_list_sizes[i] < asize + min_block_size) {
+            block_t *block = seg_lists[i];
+            if(block != NULL && aligned_lead(block, alignment) == 0 && get_size(block) >= asize) {
+                return block;
+            }
+            continue;
+        }
+        for(block_t *block = seg_lists[i]; block != NULL && blocks_checked < N; block = block->next) {
+            size_t block_size = get_size(block);
+            size_t lead = aligned_lead(block, alignment);
+            if(block_size >= fitsize || lead + asize <= block_size) {
+                return block;
+            }
+            // a block that only reaches the next aligned payload is lead slack,
+            // and in LIFO order the rest of the list past it is too
+            if(MM_LIST_ORDER == MM_LIFO && lead >= block_size) {
+                break;
+            }
+            blocks_checked++;
+        }
+    }
+    // every block in the lists above fits
+    for(size_t i = fit_index + 1; i < seg_list_count; i++) {
+        if(seg_lists[i] != NULL) {
+            return seg_lists[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief returns how far a free block's payload moves up to be aligned,
+ *        leaving a free block of at least min_block_size before it
+ *
+ * @param block the free block
+ * @param alignment a power of two greater than dsize
+ *
+ * @return the size of the free block left before the aligned block
+ *
+ * @Changelog
+ * - Added Function for Aligned Allocation.
+ */
+static size_t aligned_lead(block_t *block, size_t alignment)
+{
+    size_t bp = (size_t) header_to_payload(block);
+    size_t lead = round_up(bp, alignment) - bp;
+
+    // the space before the payload becomes a free block, so it can't be
+    // smaller than one
+    if(lead != 0 && lead < min_block_size) {
+        lead += alignment;
+    }
+    return lead;
+}
+
 /**
  * @brief returns x if x > y, and y otherwise.
  *
@@ -749,10 +1622,16 @@ static size_t extract_size(word_t word)
  * @Changelog
  * - Provided Function at Init.
  * - Added slabs check.
+ * - Added runs check.
  */
 static size_t get_size(block_t *block)
 {
-    return is_slab_block(block) ? slab_block_size : extract_size(block->header);
+    if(is_slab_block(block)) {
+        return is_run_block(block)
+            ? ((block->slab.bit_vector >> run_size_shift) & run_size_mask) * dsize
+            : slab_block_size;
+    }
+    return extract_size(block->header);
 }
 
 
@@ -835,6 +1714,7 @@ static bool get_prev_alloc(block_t *block)
  * - Provided Function at Init.
  * - Added prev_alloc parameter for Remove Footers.
  * - Added Slabs header functionality.
+ * - Marks the block dirty for incremental heap checking.
  */
 static void write_header(block_t *block, size_t size, bool alloc, bool prev_alloc)
 {
@@ -846,6 +1726,7 @@ static void write_header(block_t *block, size_t size, bool alloc, bool prev_allo
     } else {
         block->header = pack(size, alloc, prev_alloc, is_slab);
     }
+    mark_dirty(block);
 }
 
 
@@ -982,7 +1863,8 @@ static block_t *find_prev(block_t *block)
 }
 
 /**
- * @brief insert the block at the beginning of the correct seg list
+ * @brief insert the block into the correct seg list, at the place
+ * MM_LIST_ORDER picks for it
  *
  * @param block the block to be inserted
  *
@@ -990,15 +1872,16 @@ static block_t *find_prev(block_t *block)
  * - Added Function for Explicit Free List.
  * - Modified for Segregated Free Lists.
  * - Added separate condition for Slabs list.
+ * - Marks the seg list dirty for incremental heap checking.
+ * - Inserts normal blocks at the tail or in address order as well.
+ * - Inserts runs into their run list.
+ * - Marks the run list dirty for runs.
  */
 static void list_insert(block_t *block) {
 
-    size_t list_index = find_seg_list_index(get_size(block));
-    block_t *list_head = seg_lists[list_index];
-
-    if(is_slab_block(block)) { // insert slab block into slabs seg list
-        list_index = slab_list_index;
-        list_head = seg_lists[list_index];
+    if(is_slab_block(block)) { // insert slab block into slabs seg list, or run into its run list
+        block_t **head = slab_list_head(block);
+        block_t *list_head = *head;
 
         if(list_head == NULL) { // empty free list
             set_prev_ptr_slab(block, NULL);
@@ -1009,20 +1892,218 @@ static void list_insert(block_t *block) {
             block->slab.next = list_head;
             set_prev_ptr_slab(list_head, block);
         }
+        *head = block;
+        mark_slab_list_dirty(block);
+        return;
+    }
 
-    } else { // insert normal block
+    size_t list_index = find_seg_list_index(get_size(block));
 
-        if(list_head == NULL) { // empty free list
-            block->prev = NULL;
-            block->next = NULL;
-        }
-        else { // at least one item in the free list
-            block->prev = NULL;
-            block->next = list_head;
-            list_head->prev = block;
+    if(MM_LIST_ORDER == MM_FIFO) { // insert normal block at the tail
+        list_link(list_index, block, seg_tails[list_index]);
+
+    } else if(MM_LIST_ORDER == MM_ADDR_ORDER) { // insert normal block in address order
+        list_link(list_index, block, find_addr_prev(list_index, block));
+        finger_insert(list_index, block);
+
+    } else { // insert normal block at the head
+        list_link(list_index, block, NULL);
+    }
+    dirty_lists |= (word_t) 1 << list_index;
+}
+
+/**
+ * @brief inserts the free block left before an aligned payload at the tail
+ *        of its seg list.  It seldom fits the next aligned request, so
+ *        find_aligned_fit, which only looks at N blocks from the head,
+ *        shouldn't spend them on it.  In address order it goes where it
+ *        belongs, like any other block.
+ *
+ * @param block the free block to insert
+ *
+ * @Changelog
+ * - Added Function for Aligned Allocation.
+ */
+static void list_insert_slack(block_t *block) {
+    size_t list_index = find_seg_list_index(get_size(block));
+
+    if(MM_LIST_ORDER == MM_ADDR_ORDER) {
+        list_insert(block);
+        return;
+    }
+    list_link(list_index, block, seg_tails[list_index]);
+    dirty_lists |= (word_t) 1 << list_index;
+}
+
+/**
+ * @brief link a normal block into a seg list right after another block
+ *
+ * @param list_index the seg list to link the block into
+ * @param block the block to be linked in
+ * @param prev the block to follow, or NULL to make the block the head
+ *
+ * @ChangeLog
+ * - Added Function for Free List Orders.
+ */
+static void list_link(size_t list_index, block_t *block, block_t *prev) {
+    block_t *next = prev ? prev->next : seg_lists[list_index];
+
+    block->prev = prev;
+    block->next = next;
+    if(prev == NULL) {
+        seg_lists[list_index] = block;
+    } else {
+        prev->next = block;
+    }
+    if(next == NULL) {
+        seg_tails[list_index] = block;
+    } else {
+        next->prev = block;
+    }
+}
+
+/**
+ * @brief find the last block in an address-ordered seg list that is
+ * below the given block.  Blocks below the head or above the tail, or
+ * above the finger of their region, are placed at once.  Otherwise the
+ * search walks the blocks of the region from the finger below it.
+ *
+ * @param list_index the seg list to search
+ * @param block the block being inserted
+ *
+ * @return the block to insert after, or NULL if it goes at the head
+ *
+ * @ChangeLog
+ * - Added Function for Address-Ordered Free Lists.
+ * - Finds the finger to start from by region instead of scanning them.
+ */
+static block_t *find_addr_prev(size_t list_index, block_t *block) {
+    block_t *head = seg_lists[list_index];
+    if(head == NULL || block < head) {
+        return NULL;
+    }
+    if(seg_tails[list_index] < block) {
+        return seg_tails[list_index];
+    }
+
+    // the finger is the highest block of the region, so a block above it follows it
+    size_t region = finger_region(block);
+    block_t *prev = seg_fingers[list_index][region];
+    if(prev != NULL && prev < block) {
+        return prev;
+    }
+    // otherwise only the blocks of the region below it lie in between
+    prev = finger_below(list_index, region);
+    if(prev == NULL) {
+        prev = head;
+    }
+    while(prev->next != NULL && prev->next < block) {
+        prev = prev->next;
+    }
+    return prev;
+}
+
+/**
+ * @brief get the region of the heap a block is in, for the fingers of its
+ * seg list.  Blocks past the last region are all in it.
+ *
+ * @param block the block whose region is wanted
+ *
+ * @return the region
+ *
+ * @ChangeLog
+ * - Added Function for Address-Ordered Free Lists.
+ * - Numbers the regions from the start of the heap instead of wrapping.
+ */
+static size_t finger_region(block_t *block) {
+    size_t region = (size_t) ((char *) block - (char *) heap_start) >> finger_region_bits;
+    return region < FINGER_REGIONS ? region : FINGER_REGIONS - 1;
+}
+
+/**
+ * @brief make a block just inserted into an address-ordered seg list the
+ * finger of its region, if it is the highest block of the list there
+ *
+ * @param list_index the seg list
+ * @param block the block inserted
+ *
+ * @ChangeLog
+ * - Added Function for Address-Ordered Free Lists.
+ */
+static void finger_insert(size_t list_index, block_t *block) {
+    size_t region = finger_region(block);
+    block_t **finger = &seg_fingers[list_index][region];
+
+    if(*finger == NULL) {
+        size_t word = region / 64;
+        finger_bits[list_index][word] |= (word_t) 1 << (region % 64);
+        finger_summary[list_index][word / 64] |= (word_t) 1 << (word % 64);
+        finger_regions_used = max(finger_regions_used, region + 1);
+        *finger = block;
+    } else if(*finger < block) {
+        *finger = block;
+    }
+}
+
+/**
+ * @brief hand the finger of a block being removed from an address-ordered
+ * seg list to the block before it, or clear it if that block is in
+ * another region
+ *
+ * @param list_index the seg list
+ * @param block the block removed
+ * @param prev the block before it in the list, or NULL
+ *
+ * @ChangeLog
+ * - Added Function for Address-Ordered Free Lists.
+ */
+static void finger_remove(size_t list_index, block_t *block, block_t *prev) {
+    size_t region = finger_region(block);
+    if(seg_fingers[list_index][region] != block) {
+        return;
+    }
+    if(prev != NULL && finger_region(prev) == region) {
+        seg_fingers[list_index][region] = prev;
+        return;
+    }
+
+    size_t word = region / 64;
+    seg_fingers[list_index][region] = NULL;
+    finger_bits[list_index][word] &= ~((word_t) 1 << (region % 64));
+    if(finger_bits[list_index][word] == 0) {
+        finger_summary[list_index][word / 64] &= ~((word_t) 1 << (word % 64));
+    }
+}
+
+/**
+ * @brief find the highest block of an address-ordered seg list below a
+ * region, through the bits of the regions that have a finger
+ *
+ * @param list_index the seg list
+ * @param region the region to look below
+ *
+ * @return the finger of the closest region below that has one, or NULL
+ *
+ * @ChangeLog
+ * - Added Function for Address-Ordered Free Lists.
+ */
+static block_t *finger_below(size_t list_index, size_t region) {
+    size_t word = region / 64;
+    word_t bits = finger_bits[list_index][word] & (((word_t) 1 << (region % 64)) - 1);
+
+    if(bits == 0) {
+        size_t summary = word / 64;
+        word_t words = finger_summary[list_index][summary] & (((word_t) 1 << (word % 64)) - 1);
+        while(words == 0) {
+            if(summary == 0) {
+                return NULL;
+            }
+            words = finger_summary[list_index][--summary];
         }
+        word = summary * 64 + 63 - __builtin_clzll(words);
+        bits = finger_bits[list_index][word];
     }
-    seg_lists[list_index] = block;
+    return seg_fingers[list_index][word * 64 + 63 - __builtin_clzll(bits)];
 }
 
 /**
@@ -1034,47 +2115,55 @@ static void list_insert(block_t *block) {
  * - Added Function for Explicit Free List.
  * - Modified for Segregated Free Lists.
  * - Added separate condition for Slabs list.
+ * - Marks the seg list dirty for incremental heap checking.
+ * - Keeps the seg list tails and fingers up to date.
+ * - Removes runs from their run list.
+ * - Marks the slab list or run list dirty as well.
  */
 static void list_remove(block_t *block) {
 
-    size_t block_size = get_size(block);
-
-    if(is_slab_block(block)) { // remove a slab block from slabs seg list
-        // avoid extra function call because we know what list index for sure
-        size_t list_index = slab_list_index;
+    if(is_slab_block(block)) { // remove a slab block from slabs seg list, or a run from its run list
+        block_t **head = slab_list_head(block);
 
         block_t *prev_block = get_prev_ptr_slab(block);
         block_t *next_block = block->slab.next;
 
         if(!prev_block && !next_block) {
-            seg_lists[list_index] = NULL;
+            *head = NULL;
         } else if(!prev_block) {
             set_prev_ptr_slab(next_block, NULL);
-            seg_lists[list_index] = next_block;
+            *head = next_block;
         } else if(!next_block) {
             prev_block->slab.next = NULL;
         } else {
             prev_block->slab.next = next_block;
             set_prev_ptr_slab(next_block, prev_block);
         }
+        mark_slab_list_dirty(block);
 
     } else { // remove all other blocks from its respective seg list
-        size_t list_index = find_seg_list_index(block_size);
+        size_t list_index = find_seg_list_index(get_size(block));
+        dirty_lists |= (word_t) 1 << list_index;
 
         block_t *prev_block = block->prev;
         block_t *next_block = block->next;
 
         if(prev_block == NULL && next_block == NULL) {
             seg_lists[list_index] = NULL;
+            seg_tails[list_index] = NULL;
         } else if(prev_block == NULL) {
             next_block->prev = NULL;
             seg_lists[list_index] = next_block;
         } else if(next_block == NULL) {
             prev_block->next = NULL;
+            seg_tails[list_index] = prev_block;
         } else {
             prev_block->next = next_block;
             next_block->prev = prev_block;
         }
+        if(MM_LIST_ORDER == MM_ADDR_ORDER) {
+            finger_remove(list_index, block, prev_block);
+        }
     }
 }
 
@@ -1128,7 +2217,7 @@ static size_t find_seg_list_index(size_t asize) {
 /**
  * @brief places into a slab if a slab block exists, otherwise creates a new slab block
  *
- * @return a pointer to the slab block
+ * @return a pointer to the slab block, or NULL if the heap can't grow
  */
 static void *place_in_slab() {
 
@@ -1136,6 +2225,9 @@ static void *place_in_slab() {
 
     if(slab_block == NULL) {
         slab_block = init_slab_block();
+        if(slab_block == NULL) {
+            return NULL;
+        }
     }
 
     size_t slab_index = get_free_slab(slab_block);
@@ -1149,6 +2241,40 @@ static void *place_in_slab() {
     return slab_at_index(slab_block, slab_index);
 }
 
+/**
+ * @brief places up to n slabs in the first slab block with free slabs,
+ *        otherwise in a new slab block, setting their bits all at once
+ *
+ * @param ptrs where the slabs are stored
+ * @param n the most slabs wanted
+ *
+ * @return the number of slabs placed, or 0 if the heap can't grow
+ */
+static size_t place_in_slab_batch(void **ptrs, size_t n) {
+
+    block_t *slab_block = seg_lists[slab_list_index];
+
+    if(slab_block == NULL) {
+        slab_block = init_slab_block();
+        if(slab_block == NULL) {
+            return 0;
+        }
+    }
+
+    word_t taken = lowest_bits(~slab_block->slab.bit_vector & vector_mask, n);
+    slab_block->slab.bit_vector |= taken;
+
+    if(is_slab_block_full(slab_block)) {
+        list_remove(slab_block);
+    }
+
+    size_t count = 0;
+    for(; taken != 0; taken &= taken - 1) {
+        ptrs[count++] = slab_at_index(slab_block, __builtin_ctzll(taken));
+    }
+    return count;
+}
+
 /**
  * @brief frees a slab in a slab block and frees the slab block if it is empty
  *
@@ -1183,39 +2309,98 @@ static block_t *free_from_slab(void *sp) {
 }
 
 /**
- * @brief initializes a slab block by finding a free block of the correct size
- *        and splitting it if necessary.  Also then initializes the slab bit vector.
+ * @brief frees the slabs of a slab block, or objects of a run, whose bits
+ *        are set in freed, and frees the slab block or run if it is empty
  *
- * @return a pointer to the slab block
+ * @param slab_block the slab block or run
+ * @param freed the bits of the slabs or objects being freed
+ *
+ * @return a pointer to the slab block or run, or to the free block it
+ *         became if it is empty
  */
-static block_t *init_slab_block() {
-    block_t *slab_block = find_fit(slab_block_size);
-    if(slab_block == NULL) {
-        slab_block = extend_heap(slab_block_size);
+static block_t *free_from_slab_batch(block_t *slab_block, word_t freed) {
+    bool run = is_run_block(slab_block);
+
+    if(run ? is_run_full(slab_block) : is_slab_block_full(slab_block)) {
+        list_insert(slab_block);
     }
 
-    size_t block_size = get_size(slab_block);
-    list_remove(slab_block);
-    // both alloc and prev_alloc are true because slab block and would've been coalesced if prev_alloc was false
-    write_header(slab_block, 0, true, true);
-    set_is_slab(slab_block, true);
+    slab_block->slab.bit_vector &= ~freed;
 
-    // split the block just like in place
-    if(block_size != slab_block_size) {
-        block_t *block_next = find_next(slab_block);
-        bool prev_alloc = true; // set prev_alloc to true since we just created a slab block in the previous block
-        set_is_slab(block_next, false);
-        write_header(block_next, block_size-slab_block_size, false, prev_alloc);
-        write_footer(block_next, block_size-slab_block_size, false, prev_alloc);
-        update_next_prev_alloc(block_next, false);
-        list_insert(block_next);
-    } else {
-        update_next_prev_alloc(slab_block, true);
+    if(!(run ? is_run_empty(slab_block) : is_slab_block_empty(slab_block))) {
+        return slab_block;
     }
 
-    // initialize the slab mini headers
-    size_t index = 0;
-    for(; index < num_slabs; ++index) {
+    // the slab block or run is empty, so turn it back into a free block for coalesce
+    size_t block_size = get_size(slab_block);
+    list_remove(slab_block);
+    bool prev_alloc = get_prev_alloc(slab_block);
+    set_is_slab(slab_block, false);
+    write_header(slab_block, block_size, false, prev_alloc);
+    write_footer(slab_block, block_size, false, prev_alloc);
+    slab_block->prev = NULL;
+    slab_block->next = NULL;
+
+    return slab_block;
+}
+
+/**
+ * @brief returns the lowest n set bits of a bit vector
+ *
+ * @param bits the bit vector
+ * @param n the most bits wanted
+ *
+ * @return a vector of those bits
+ */
+static word_t lowest_bits(word_t bits, size_t n) {
+    word_t taken = 0;
+    for(; n > 0 && bits != 0; n--) {
+        word_t low = bits & -bits;
+        taken |= low;
+        bits ^= low;
+    }
+    return taken;
+}
+
+/**
+ * @brief initializes a slab block by finding a free block of the correct size
+ *        and splitting it if necessary.  Also then initializes the slab bit vector.
+ *
+ * @return a pointer to the slab block, or NULL if the heap can't grow
+ */
+static block_t *init_slab_block() {
+    block_t *slab_block = find_fit(slab_block_size);
+    if(slab_block == NULL) {
+        slab_block = extend_heap(slab_block_size);
+        if(slab_block == NULL) {
+            return NULL;
+        }
+    }
+
+    size_t block_size = get_size(slab_block);
+    list_remove(slab_block);
+    raise_zero_start((char *) slab_block + slab_block_size);
+    // both alloc and prev_alloc are true because slab block and would've been coalesced if prev_alloc was false
+    write_header(slab_block, 0, true, true);
+    set_is_slab(slab_block, true);
+
+    // split the block just like in place
+    if(block_size != slab_block_size) {
+        block_t *block_next = find_next(slab_block);
+        bool prev_alloc = true; // set prev_alloc to true since we just created a slab block in the previous block
+        set_is_slab(block_next, false);
+        write_header(block_next, block_size-slab_block_size, false, prev_alloc);
+        write_footer(block_next, block_size-slab_block_size, false, prev_alloc);
+        update_next_prev_alloc(block_next, false);
+        list_insert(block_next);
+    } else {
+        update_next_prev_alloc(slab_block, true);
+    }
+
+    // initialize the slab mini headers, the first of which is in the vector
+    slab_block->slab.bit_vector = 0;
+    size_t index = 0;
+    for(; index < num_slabs; ++index) {
         void *sp = slab_at_index(slab_block, index);
         pack_mini_header(sp, index);
     }
@@ -1313,7 +2498,8 @@ static char *slab_to_mini_header(void *sp) {
 }
 
 /**
- * @brief returns the index of the slab in the slab block
+ * @brief returns the index of the slab in the slab block.  For an object in
+ *        a run, this is its distance from the run payload in dsize units.
  *
  * @param sp a pointer to the slab
  *
@@ -1321,13 +2507,14 @@ static char *slab_to_mini_header(void *sp) {
  */
 static size_t get_slab_index(void *sp) {
     char mini_header = *slab_to_mini_header(sp);
-    return (size_t) ((mini_header & ~is_slab_mask) >> 1);
+    return (size_t) ((mini_header >> 1) & slab_dist_mask);
 }
 
 /**
- * @brief returns the header of the slab block from a pointer to a slab
+ * @brief returns the header of the slab block from a pointer to a slab,
+ *        or of the run from a pointer to an object in it
  *
- * @param sp a pointer to a slab
+ * @param sp a pointer to a slab or run object
  *
  * @return a pointer to the slab block
  */
@@ -1400,6 +2587,21 @@ static bool is_slab_block_empty(block_t *block) {
  */
 static void set_is_slab(block_t *block, bool is_slab) {
     block->header = is_slab ? (block->header | is_slab_mask) : (block->header & ~is_slab_mask);
+    mark_dirty(block);
+}
+
+/**
+ * @brief returns the head of the list a slab block or run with free space is kept in
+ *
+ * @param block the slab block or run
+ *
+ * @return a pointer to the list head
+ */
+static block_t **slab_list_head(block_t *block) {
+    if(is_run_block(block)) {
+        return &run_lists[run_list_index(run_stride(block))];
+    }
+    return &seg_lists[slab_list_index];
 }
 
 
@@ -1407,103 +2609,529 @@ static void set_is_slab(block_t *block, bool is_slab) {
 // END SLAB_SECTION
 
 
+// RUN_SECTION
+
+/*
+ * A run is a slab block for objects larger than a slab, all of one stride
+ * (a multiple of dsize).  Like a slab, each object ends one byte short of
+ * its stride so the next object's mini header fits, and the mini header
+ * holds the object's distance from the run payload so the run can be found
+ * without a block header.  The distance must fit in the mini header, which
+ * bounds how many objects a run of a large stride holds.
+ */
+
 /**
- * @brief checks the heap for all invariants as shown in the changelog.
+ * @brief places into a run of the size's stride if one has a free object,
+ *        otherwise creates a new run
+ *
+ * @param size the requested size, more than a slab and at most run_max_size
+ *
+ * @return a pointer to the object, or NULL if the heap can't grow
+ */
+static void *place_in_run(size_t size) {
+    size_t stride = round_up(size + 1, dsize);
+    block_t *run = run_lists[run_list_index(stride)];
+
+    if(run == NULL) {
+        run = init_run_block(stride);
+        if(run == NULL) {
+            return NULL;
+        }
+    }
+
+    size_t index = __builtin_ctzll(~run->slab.bit_vector);
+    update_vector(run, index, true);
+
+    if(is_run_full(run)) {
+        list_remove(run);
+    }
+
+    return (void *) (run->slab.payload + index * stride);
+}
+
+/**
+ * @brief places up to n objects in the first run of the size's stride with
+ *        a free object, otherwise in a new run, setting their bits all at once
+ *
+ * @param size the requested size, more than a slab and at most run_max_size
+ * @param ptrs where the objects are stored
+ * @param n the most objects wanted
+ *
+ * @return the number of objects placed, or 0 if the heap can't grow
+ */
+static size_t place_in_run_batch(size_t size, void **ptrs, size_t n) {
+    size_t stride = round_up(size + 1, dsize);
+    block_t *run = run_lists[run_list_index(stride)];
+
+    if(run == NULL) {
+        run = init_run_block(stride);
+        if(run == NULL) {
+            return 0;
+        }
+    }
+
+    word_t taken = lowest_bits(~run->slab.bit_vector & run_vector_mask, n);
+    run->slab.bit_vector |= taken;
+
+    if(is_run_full(run)) {
+        list_remove(run);
+    }
+
+    size_t count = 0;
+    for(; taken != 0; taken &= taken - 1) {
+        ptrs[count++] = (void *) (run->slab.payload + __builtin_ctzll(taken) * stride);
+    }
+    return count;
+}
+
+/**
+ * @brief frees an object in a run and frees the run if it is empty
+ *
+ * @param rp the pointer to the object
+ *
+ * @return a pointer to the run, or to the free block it became if it is empty
+ */
+static block_t *free_from_run(void *rp) {
+    block_t *run = slab_to_header(rp);
+    size_t stride = run_stride(run);
+    size_t index = (size_t) ((char *) rp - run->slab.payload) / stride;
+
+    if(is_run_full(run)) {
+        list_insert(run);
+    }
+
+    update_vector(run, index, false);
+
+    if(!is_run_empty(run)) {
+        return run;
+    }
+
+    // the run is empty, so turn it back into a free block for coalesce
+    size_t run_size = get_size(run);
+    list_remove(run);
+    bool prev_alloc = get_prev_alloc(run);
+    set_is_slab(run, false);
+    write_header(run, run_size, false, prev_alloc);
+    write_footer(run, run_size, false, prev_alloc);
+    run->prev = NULL;
+    run->next = NULL;
+
+    return run;
+}
+
+/**
+ * @brief initializes a run by finding a free block of the correct size and
+ *        splitting it if necessary.  A remainder too small to be a block is
+ *        kept at the end of the run.
+ *
+ * @param stride the stride of the run's objects
+ *
+ * @return a pointer to the run, or NULL if the heap can't grow
+ */
+static block_t *init_run_block(size_t stride) {
+    size_t objects = run_objects(stride);
+    size_t run_size = objects * stride + (slab_block_overhead + wsize);
+
+    block_t *run = find_fit(run_size);
+    if(run == NULL) {
+        run = extend_heap(run_size);
+        if(run == NULL) {
+            return NULL;
+        }
+    }
+
+    size_t block_size = get_size(run);
+    list_remove(run);
+    if(block_size - run_size < min_block_size) {
+        run_size = block_size;
+    }
+    raise_zero_start((char *) run + run_size);
+
+    // the vector holds the run's size and stride, and marks the bits past
+    // the last object as allocated
+    run->slab.bit_vector = ((word_t) (run_size / dsize) << run_size_shift)
+                         | ((word_t) (stride / dsize) << run_stride_shift)
+                         | (run_vector_mask & run_vector_mask << objects);
+
+    // initialize the object mini headers, the first of which is in the vector,
+    // before the slab bit is set and get_size reads the vector
+    for(size_t index = 0; index < objects; ++index) {
+        char *mini_header = run->slab.payload + index * stride - 1;
+        *mini_header = run_mini_mask | ((index * stride / dsize) << 1) | is_slab_mask;
+    }
+
+    // both alloc and prev_alloc are true because a free block before it would've been coalesced
+    write_header(run, 0, true, true);
+    set_is_slab(run, true);
+
+    // split the block just like in place
+    if(block_size != run_size) {
+        block_t *block_next = find_next(run);
+        set_is_slab(block_next, false);
+        write_header(block_next, block_size-run_size, false, true);
+        write_footer(block_next, block_size-run_size, false, true);
+        update_next_prev_alloc(block_next, false);
+        list_insert(block_next);
+    } else {
+        update_next_prev_alloc(run, true);
+    }
+
+    list_insert(run);
+    return run;
+}
+
+/**
+ * @brief returns the number of objects in a run of the given stride
+ *
+ * @param stride the stride of the run's objects
+ *
+ * @return the number of objects
+ */
+static size_t run_objects(size_t stride) {
+    size_t objects = run_max_dist * dsize / stride + 1;
+    return objects < run_max_objects ? objects : run_max_objects;
+}
+
+/**
+ * @brief returns the stride of the objects in a run
+ *
+ * @param run the run to check
+ *
+ * @return the stride in bytes
+ */
+static size_t run_stride(block_t *run) {
+    return ((run->slab.bit_vector >> run_stride_shift) & run_stride_mask) * dsize;
+}
+
+/**
+ * @brief returns the index of the run list for the given stride
+ *
+ * @param stride the stride of a run's objects
+ *
+ * @return the index into run_lists
+ */
+static size_t run_list_index(size_t stride) {
+    return stride / dsize - 2; // the smallest stride is 32
+}
+
+/**
+ * @brief returns true if the slab block is a run, false otherwise
+ *
+ * @param block the slab block to check
+ *
+ * @return true if the block is a run
+ */
+static bool is_run_block(block_t *block) {
+    return block->slab.bit_vector & run_vector_flag;
+}
+
+/**
+ * @brief returns true if the slab pointer is an object in a run, false otherwise
+ *
+ * @param rp the pointer to check, which is_slab is true for
  *
+ * @return true if the pointer is in a run
+ */
+static bool is_run(void *rp) {
+    return *slab_to_mini_header(rp) & run_mini_mask;
+}
+
+/**
+ * @brief returns true if every object in the run is allocated
+ *
+ * @param run the run to check
+ *
+ * @return true if the run is full
+ */
+static bool is_run_full(block_t *run) {
+    return (run->slab.bit_vector & run_vector_mask) == run_vector_mask;
+}
+
+/**
+ * @brief returns true if no object in the run is allocated
+ *
+ * @param run the run to check
+ *
+ * @return true if the run is empty
+ */
+static bool is_run_empty(block_t *run) {
+    return (run->slab.bit_vector & run_vector_mask)
+        == (run_vector_mask & run_vector_mask << run_objects(run_stride(run)));
+}
+
+// END RUN_SECTION
+
+
+/**
+ * @brief records that a block's header was written, for the next
+ *        incremental heap check.
+ *
+ * @param block the block whose header changed
+ *
+ * @Changelog
+ * - Added for incremental heap checking.
+ */
+static void mark_dirty(block_t *block) {
+    if(dirty_count < max_dirty_blocks) {
+        dirty_blocks[dirty_count++] = block;
+    } else {
+        dirty_overflow = true;
+    }
+}
+
+/**
+ * @brief records that the list of a slab block, the slab list or the run
+ *        list of its stride, was changed, for the next incremental heap check.
+ *
+ * @param block the slab block or run inserted or removed
+ *
+ * @Changelog
+ * - Added for incremental checking of the slab and run lists.
+ */
+static void mark_slab_list_dirty(block_t *block) {
+    if(is_run_block(block)) {
+        dirty_run_lists |= (word_t) 1 << run_list_index(run_stride(block));
+    } else {
+        dirty_lists |= (word_t) 1 << slab_list_index;
+    }
+}
+
+/**
+ * @brief forgets the dirty blocks and seg lists after a heap check.
+ *
+ * @Changelog
+ * - Added for incremental heap checking.
+ * - Forgets the dirty run lists too.
+ */
+static void clear_dirty() {
+    dirty_count = 0;
+    dirty_overflow = false;
+    dirty_lists = 0;
+    dirty_run_lists = 0;
+}
+
+/**
+ * @brief checks the invariants between a block and the block after it.
+ *
+ * @param b the block to check
  * @param line the line number of the caller
+ * @param heap_count incremented if the block is free
  *
  * @return true if no invariants are violated, false otherwise
  *
  * @Changelog
- * - Provided Function at Init.  Added Coalesce Invariant -- 1.
- * - Added Explicit Free List Invariants -- 2, 3, 4, 5.
- * - Added Remove Footers Invariants -- 6, 7.
- * - Added Segregated Free List Invariant -- 8.
- * - No Slabs Invariants Added.
+ * - Split out of mm_checkheap for incremental heap checking.
  */
-bool mm_checkheap(int line)
-{
+static bool check_block(block_t *b, int line, int *heap_count) {
+    block_t * next = find_next(b);
 
-    int free_list_count = 0;
-    int heap_count = 0;
+    bool b_alloc = get_alloc(b);
+    bool prev_alloc = get_prev_alloc(b);
+    bool next_alloc = get_alloc(next);
 
-    block_t *b;
-    // loop through the heap for all invariants requiring the entire heap
-    for (b = heap_start; get_size(b) != 0; b = find_next(b)) {
-        block_t * next = find_next(b);
+    if (b_alloc == false) {
+        (*heap_count)++; // increment count of free blocks in the heap
 
-        bool b_alloc = get_alloc(b);
-        bool prev_alloc = get_prev_alloc(b);
-        bool next_alloc = get_alloc(next);
+        // Check that Coalesce works as intended
+        if (prev_alloc == false || next_alloc == false) {
+            printf(BOLD RED"Coalesce Invariant failed at line %d with heap:\n"RESET, line);
+            print_heap();
+            return false; // INVARIANT 1
+        }
 
-        if (b_alloc == false) {
-            heap_count++; // increment count of free blocks in the heap
+        if (b->header != *find_prev_footer(next)) {
+            printf(BOLD RED"Footer Not Matching Header Invariant Broken at line %d with heap:\n"RESET, line);
+            print_heap();
+            return false; // INVARIANT 6
+        }
+    }
 
-            // Check that Coalesce works as intended
-            if (prev_alloc == false || next_alloc == false) {
-                printf(BOLD RED"Coalesce Invariant failed at line %d with heap:\n"RESET, line);
-                print_heap();
-                return false; // INVARIANT 1
-            }
+    if(b_alloc != get_prev_alloc(next)) {
+        printf(BOLD RED"Incorrect Prev Alloc Bit Invariant Broken at line %d with heap:\n"RESET, line);
+        print_heap();
+        return false; // INVARIANT 7
+    }
+    return true;
+}
 
-            if (b->header != *find_prev_footer(next)) {
-                printf(BOLD RED"Footer Not Matching Header Invariant Broken at line %d with heap:\n"RESET, line);
-                print_heap();
-                return false; // INVARIANT 6
-            }
+/**
+ * @brief checks the invariants of every block in one seg list.
+ *
+ * @param list_index the seg list to check
+ * @param line the line number of the caller
+ * @param free_list_count incremented for every block in the list
+ *
+ * @return true if no invariants are violated, false otherwise
+ *
+ * @Changelog
+ * - Split out of mm_checkheap for incremental heap checking.
+ */
+static bool check_seg_list(size_t list_index, int line, int *free_list_count) {
+    block_t *f_block = seg_lists[list_index];
+    for(; f_block != NULL; f_block = f_block->next) {
+        if(list_index != slab_list_index) {
+            (*free_list_count)++; // increment count of free list blocks
         }
+        size_t block_size = get_size(f_block);
 
-        if(b_alloc != get_prev_alloc(next)) {
-            printf(BOLD RED"Incorrect Prev Alloc Bit Invariant Broken at line %d with heap:\n"RESET, line);
+        // Check that the free list block is actually free, but ignore the slabs list which is marked as allocated
+        if(get_alloc(f_block) && list_index != slab_list_index) {
+            printf(BOLD RED"Allocated Block (addr: %p) in Seg List Invariant"
+                           " Broken at line %d with heap:\n"RESET, f_block, line);
             print_heap();
-            return false; // INVARIANT 7
+            print_seg_lists();
+            return false; // INVARIANT 2
         }
-    }
 
-    // loop through the seg lists for all invariants requiring the seg free lists
-    size_t list_index = 1;
-    for(; list_index < seg_list_count; list_index++) {
+        // Check that the free list is doubly linked
+        if(f_block->next != NULL && f_block->next->prev != f_block) {
+            printf(BOLD RED"Seg List (index: %zu) Not Doubly Linked Invariant"
+                           " Broken at line %d with heap:\n"RESET, list_index, line);
+            print_heap();
+            return false; // INVARIANT 3
+        }
 
-        block_t *f_block = seg_lists[list_index];
-        for(; f_block != NULL; f_block = f_block->next) {
-            if(list_index != slab_list_index) {
-                free_list_count++; // increment count of free list blocks
-            }
-            size_t block_size = get_size(f_block);
+        // Check that all blocks are in the correct Seg List
+        if((block_size > seg_list_sizes[list_index]
+                && (list_index-1 == slab_list_index || block_size <= seg_list_sizes[list_index-1]))) {
+            printf(BOLD RED"Block in Wrong Seg List Invariant Broken at line %d with heap:\n"RESET, line);
+            print_heap();
+            print_seg_lists();
+            return false; // INVARIANT 8
+        }
 
-            // Check that the free list block is actually free, but ignore the slabs list which is marked as allocated
-            if(get_alloc(f_block) && list_index != slab_list_index) {
-                printf(BOLD RED"Allocated Block (addr: %p) in Seg List Invariant"
-                               " Broken at line %d with heap:\n"RESET, f_block, line);
-                print_heap();
+        if(list_index != slab_list_index) {
+            // Check that an address-ordered list is in address order
+            if(MM_LIST_ORDER == MM_ADDR_ORDER && f_block->next != NULL && f_block->next < f_block) {
+                printf(BOLD RED"Seg List (index: %zu) Out of Address Order Invariant"
+                               " Broken at line %d with heap:\n"RESET, list_index, line);
                 print_seg_lists();
-                return false; // INVARIANT 2
+                return false; // INVARIANT 9
             }
 
-            // Check that the free list is doubly linked
-            if(f_block->next != NULL && f_block->next->prev != f_block) {
-                printf(BOLD RED"Seg List (index: %zu) Not Doubly Linked Invariant"
+            // Check that the tail is the last block in the list
+            if(f_block->next == NULL && seg_tails[list_index] != f_block) {
+                printf(BOLD RED"Seg List (index: %zu) Wrong Tail Invariant"
                                " Broken at line %d with heap:\n"RESET, list_index, line);
-                print_heap();
-                return false; // INVARIANT 3
-            }
-
-            // Check that all blocks are in the correct Seg List
-            if((block_size > seg_list_sizes[list_index]
-                    && (list_index-1 == slab_list_index || block_size <= seg_list_sizes[list_index-1]))) {
-                printf(BOLD RED"Block in Wrong Seg List Invariant Broken at line %d with heap:\n"RESET, line);
-                print_heap();
                 print_seg_lists();
-                return false; // INVARIANT 8
+                return false; // INVARIANT 10
             }
+        }
 
-            const int too_large_number = 1000000000;
-            if(free_list_count > too_large_number) {
-                printf(BOLD RED"Free Lists in an Infinite Loop at line %d with heap:\n"RESET, line);
-                print_heap();
-                return false; // INVARIANT 5
-            }
+        const int too_large_number = 1000000000;
+        if(*free_list_count > too_large_number) {
+            printf(BOLD RED"Free Lists in an Infinite Loop at line %d with heap:\n"RESET, line);
+            print_heap();
+            return false; // INVARIANT 5
+        }
+    }
+    return true;
+}
 
+/**
+ * @brief checks the invariants of the slab list: it holds only slab blocks
+ *        that have both a free and a placed slab, doubly linked.
+ *
+ * @param line the line number of the caller
+ *
+ * @return true if no invariants are violated, false otherwise
+ *
+ * @Changelog
+ * - Added for incremental checking of the slab list.
+ */
+static bool check_slab_list(int line) {
+    for(block_t *slab_block = seg_lists[slab_list_index]; slab_block != NULL; slab_block = slab_block->slab.next) {
+        block_t *next = slab_block->slab.next;
+        if(!is_slab_block(slab_block) || is_run_block(slab_block)
+                || is_slab_block_full(slab_block) || is_slab_block_empty(slab_block)
+                || (next != NULL && get_prev_ptr_slab(next) != slab_block)) {
+            printf(BOLD RED"Slab List Invariant Broken at block %p"
+                           " at line %d with heap:\n"RESET, slab_block, line);
+            print_heap();
+            return false; // INVARIANT 12
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief checks the invariants of a run list: it holds runs of its stride
+ *        that have both a free and a placed object, doubly linked.
+ *
+ * @param list_index the run list to check
+ * @param line the line number of the caller
+ *
+ * @return true if no invariants are violated, false otherwise
+ *
+ * @Changelog
+ * - Added for Runs.
+ * - Checks one run list, so incremental checks can check only dirty ones.
+ * - Checks that the run list is doubly linked.
+ */
+static bool check_run_list(size_t list_index, int line) {
+    for(block_t *run = run_lists[list_index]; run != NULL; run = run->slab.next) {
+        // Check that the run list holds runs of its stride with a free object
+        block_t *next = run->slab.next;
+        if(!is_slab_block(run) || !is_run_block(run) || run_list_index(run_stride(run)) != list_index
+                || is_run_full(run) || is_run_empty(run)
+                || (next != NULL && get_prev_ptr_slab(next) != run)) {
+            printf(BOLD RED"Run List (index: %zu) Invariant Broken at block %p"
+                           " at line %d with heap:\n"RESET, list_index, run, line);
+            print_heap();
+            return false; // INVARIANT 11
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief checks the heap for all invariants as shown in the changelog.
+ *
+ * @param line the line number of the caller
+ *
+ * @return true if no invariants are violated, false otherwise
+ *
+ * @Changelog
+ * - Provided Function at Init.  Added Coalesce Invariant -- 1.
+ * - Added Explicit Free List Invariants -- 2, 3, 4, 5.
+ * - Added Remove Footers Invariants -- 6, 7.
+ * - Added Segregated Free List Invariant -- 8.
+ * - No Slabs Invariants Added.
+ * - Moved the per block and per list checks into helpers.
+ * - Added Free List Order Invariants -- 9, 10.
+ * - Added Run List Invariant -- 11.
+ * - Added Slab List Invariant -- 12.
+ */
+bool mm_checkheap(int line)
+{
+
+    int free_list_count = 0;
+    int heap_count = 0;
+
+    // everything is checked, so nothing is dirty anymore
+    clear_dirty();
+
+    block_t *b;
+    // loop through the heap for all invariants requiring the entire heap
+    for (b = heap_start; get_size(b) != 0; b = find_next(b)) {
+        if(!check_block(b, line, &heap_count)) {
+            return false;
+        }
+    }
+
+    // loop through the seg lists for all invariants requiring the seg free lists
+    size_t list_index = 1;
+    for(; list_index < seg_list_count; list_index++) {
+        if(!check_seg_list(list_index, line, &free_list_count)) {
+            return false;
+        }
+    }
+    if(!check_slab_list(line)) {
+        return false;
+    }
+    for(size_t i = 0; i < sizeof(run_lists) / sizeof(run_lists[0]); i++) {
+        if(!check_run_list(i, line)) {
+            return false;
         }
     }
 
@@ -1521,6 +3149,86 @@ bool mm_checkheap(int line)
     return true;
 }
 
+/**
+ * @brief checks only the blocks and seg lists changed since the last check.
+ *        Every block whose header was written is checked against the blocks
+ *        on either side of it, and every seg list that was inserted into or
+ *        removed from is walked, as are the slab list and run lists
+ *        that were.  Invariant 4 needs the whole heap, so it is
+ *        left to the next full mm_checkheap.  Falls back to a full check
+ *        after mm_init or when too many blocks were changed to remember.
+ *
+ * @param line the line number of the caller
+ *
+ * @return true if no invariants are violated, false otherwise
+ *
+ * @Changelog
+ * - Added for incremental heap checking.
+ * - Checks the dirty slab list and run lists.
+ */
+bool mm_checkheap_incremental(int line)
+{
+    if(dirty_overflow) {
+        return mm_checkheap(line);
+    }
+
+    // sort the dirty blocks by address (there are only a handful)
+    for(size_t i = 1; i < dirty_count; i++) {
+        block_t *b = dirty_blocks[i];
+        size_t j = i;
+        for(; j > 0 && dirty_blocks[j-1] > b; j--) {
+            dirty_blocks[j] = dirty_blocks[j-1];
+        }
+        dirty_blocks[j] = b;
+    }
+
+    // A dirty block that has since been coalesced away lies inside the block
+    // that absorbed it, which was written later and so is dirty too.  Skipping
+    // the dirty blocks inside the last block checked leaves only real blocks.
+    int heap_count = 0;
+    block_t *checked_end = NULL;
+    for(size_t i = 0; i < dirty_count; i++) {
+        block_t *b = dirty_blocks[i];
+        if(b < checked_end || get_size(b) == 0) {
+            continue;
+        }
+
+        // a free block before this one must end right where this one starts
+        if(!get_prev_alloc(b)) {
+            block_t *prev = find_prev(b);
+            if(get_alloc(prev) || find_next(prev) != b) {
+                printf(BOLD RED"Incorrect Prev Alloc Bit Invariant Broken at line %d with heap:\n"RESET, line);
+                print_heap();
+                return false; // INVARIANT 7
+            }
+        }
+
+        if(!check_block(b, line, &heap_count)) {
+            return false;
+        }
+        checked_end = find_next(b);
+    }
+
+    int free_list_count = 0;
+    for(size_t list_index = 1; list_index < seg_list_count; list_index++) {
+        if((dirty_lists & ((word_t) 1 << list_index))
+                && !check_seg_list(list_index, line, &free_list_count)) {
+            return false;
+        }
+    }
+    if((dirty_lists & ((word_t) 1 << slab_list_index)) && !check_slab_list(line)) {
+        return false;
+    }
+    for(size_t i = 0; i < sizeof(run_lists) / sizeof(run_lists[0]); i++) {
+        if((dirty_run_lists & ((word_t) 1 << i)) && !check_run_list(i, line)) {
+            return false;
+        }
+    }
+
+    clear_dirty();
+    return true;
+}
+
 /**
  * @brief prints the heap
  *
@@ -1529,6 +3237,7 @@ bool mm_checkheap(int line)
  * @Changelog
  * - Created during Coalesce Phase for debugging use.
  * - Added Slabs.
+ * - Added Runs.
  */
 bool print_heap() {
 /*
@@ -1555,7 +3264,11 @@ bool print_heap() {
         size_t block_size = get_size(b);
         printf(BOLD"BLOCK %d"RESET" with ADDR: %p, \talloc: %s, \tprev_alloc: %s, \tsize: %lu",
                count, b, alloc_status, prev_alloc_status, block_size);
-        if(is_slab_block(b)) {
+        if(is_slab_block(b) && is_run_block(b)) {
+            printf(","YELLOW"\tRUN of %zu"RESET, run_stride(b));
+            printf(BLUE"\t vector: 0x%lx\tprev: %p\tnext: %p\n"RESET,
+                   b->slab.bit_vector & run_vector_mask, get_prev_ptr_slab(b), b->slab.next);
+        } else if(is_slab_block(b)) {
             printf(","YELLOW"\tSLAB BLOCK"RESET);
             printf(BLUE"\t vector: 0x%lx\tprev: %p\tnext: %p\n"RESET,
                    b->slab.bit_vector & vector_mask, get_prev_ptr_slab(b), b->slab.next);
@@ -1612,4 +3325,61 @@ bool print_seg_lists() {
     printf(BOLD"------------------------------------------------------------\n\n"RESET);
 
     return true; // return true to allow for use in dbg macros
-}
\ No newline at end of file
+}
+
+/**
+ * @brief reports the free space in the heap for the driver's fragmentation
+ *        time series.  Free slabs are counted in the slab list's class, and
+ *        free run objects in the seg list class of their stride.
+ *
+ * @param class_size filled with the smallest block size of each seg list
+ * @param free_bytes filled with the free bytes in each seg list
+ * @param max_classes the number of entries in class_size and free_bytes
+ * @param largest set to the size of the largest free block
+ *
+ * @return the number of classes filled in
+ *
+ * @Changelog
+ * - Added for fragmentation reporting.
+ * - Added Runs.
+ * - Reports the smallest block size of each class, as mm.h asks.
+ */
+size_t mm_free_stats(size_t *class_size, size_t *free_bytes, size_t max_classes, size_t *largest) {
+    size_t count = seg_list_count < max_classes ? seg_list_count : max_classes;
+    for(size_t i = 0; i < count; i++) {
+        // seg_list_sizes holds the largest size of each list
+        if(i == slab_list_index) {
+            class_size[i] = slab_size;
+        } else if(i-1 == slab_list_index) {
+            class_size[i] = min_block_size;
+        } else {
+            class_size[i] = seg_list_sizes[i-1] + dsize;
+        }
+        free_bytes[i] = 0;
+    }
+    *largest = 0;
+
+    for(block_t *b = heap_start; get_size(b) != 0; b = find_next(b)) {
+        size_t index;
+        size_t bytes;
+        if(is_slab_block(b) && is_run_block(b)) {
+            word_t vector = b->slab.bit_vector & run_vector_mask;
+            index = find_seg_list_index(run_stride(b));
+            bytes = (run_max_objects - __builtin_popcountll(vector)) * run_stride(b);
+        } else if(is_slab_block(b)) {
+            word_t vector = b->slab.bit_vector & vector_mask;
+            index = slab_list_index;
+            bytes = (num_slabs - __builtin_popcountll(vector)) * slab_size;
+        } else if(!get_alloc(b)) {
+            bytes = get_size(b);
+            index = find_seg_list_index(bytes);
+            *largest = max(*largest, bytes);
+        } else {
+            continue;
+        }
+        if(index < count) {
+            free_bytes[index] += bytes;
+        }
+    }
+    return count;
+}
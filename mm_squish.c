@@ -38,6 +38,7 @@
 #include <stddef.h>
 #include <assert.h>
 #include <stddef.h>
+#include <errno.h>
 
 #include "mm.h"
 #include "memlib.h"
@@ -48,6 +49,17 @@
 #define free mm_free
 #define realloc mm_realloc
 #define calloc mm_calloc
+#define memalign mm_memalign
+#define posix_memalign mm_posix_memalign
+#define aligned_alloc mm_aligned_alloc
+#define free_sized mm_free_sized
+#define malloc_usable_size mm_usable_size
+#define malloc_batch mm_malloc_batch
+#define free_batch mm_free_batch
+#define arena_create mm_arena_create
+#define arena_alloc mm_arena_alloc
+#define arena_reset mm_arena_reset
+#define arena_destroy mm_arena_destroy
 #endif /* def DRIVER */
 
 /* You can change anything from here onward */
@@ -88,13 +100,55 @@
 #define dbg_ensures(...)
 #endif
 
+/*
+ * Allocator policy, chosen at compile time so the Makefile can build each
+ * variant into its own driver, e.g. -DMM_FIT_POLICY=MM_BEST_FIT.
+ *   MM_FIRST_FIT -- take the first block that fits
+ *   MM_NTH_FIT   -- take the best of the first MM_NTH blocks that fit
+ *   MM_BEST_FIT  -- take the best block in the first seg list with a fit
+ * MM_CHUNKSIZE is the least the heap is extended by when nothing fits.
+ * MM_LIST_ORDER is where a freed block goes in its seg list:
+ *   MM_LIFO       -- at the head
+ *   MM_FIFO       -- at the tail
+ *   MM_ADDR_ORDER -- in address order, so first fit is address-ordered
+ * MM_SPLIT_THRESHOLD splits a free block from its high end for requests
+ * smaller than it and from its low end for the rest, so that small and
+ * large blocks gather at opposite ends of the free space.  0 always
+ * splits from the low end.
+ */
+#define MM_FIRST_FIT 1
+#define MM_NTH_FIT 2
+#define MM_BEST_FIT 3
+
+#define MM_LIFO 1
+#define MM_FIFO 2
+#define MM_ADDR_ORDER 3
+
+#ifndef MM_FIT_POLICY
+#define MM_FIT_POLICY MM_NTH_FIT
+#endif
+#ifndef MM_NTH
+#define MM_NTH 75
+#endif
+#ifndef MM_CHUNKSIZE
+#define MM_CHUNKSIZE (1 << 12)
+#endif
+#ifndef MM_LIST_ORDER
+#define MM_LIST_ORDER MM_LIFO
+#endif
+#ifndef MM_SPLIT_THRESHOLD
+#define MM_SPLIT_THRESHOLD 64
+#endif
+
 /* Basic constants */
 typedef uint64_t word_t;
 static const size_t wsize = sizeof(word_t);   // word and header size (bytes)
 static const size_t dsize = 2*sizeof(word_t);       // double word size (bytes)
 static const size_t min_block_size = dsize; // Minimum block size -- with Squish
 static const size_t squished_block_size = dsize; // another constant to make things clearer
-static const size_t chunksize = (1 << 12);    // requires (chunksize % 16 == 0)
+static const size_t chunksize = MM_CHUNKSIZE;    // requires (chunksize % 16 == 0)
+static const size_t arena_chunksize = (1 << 12); // arena chunk size unless one is asked for
+static const size_t split_threshold = MM_SPLIT_THRESHOLD; // smaller requests split from the high end
 
 static const word_t alloc_mask = 0x1;
 static const word_t prev_alloc_mask = 0x2;
@@ -104,7 +158,7 @@ static const word_t size_mask = ~(word_t)0xF;
 static const word_t squish_ptr_mask = ~(word_t)0x7;
 static const word_t squish_bits_mask = (word_t)0x7;
 
-static const int N = 75; // N for Nth fit -- best for seg lists seems to be ~75
+static const int N = MM_NTH; // N for Nth fit -- best for seg lists seems to be ~75
 static const size_t min_moe_size = 256;
 static const size_t max_size = ~0x0;
 
@@ -114,6 +168,7 @@ static const int log2_min_block_size = 4; // log2(16) = 4 --> min_block_size isn
 static const int first_list_index = 0;
 static const int last_list_index = 9;
 static const int seg_list_count = 10;
+static const int finger_region_bits = 12; // bytes of heap covered by a finger, log2
 
 
 typedef struct block
@@ -131,6 +186,15 @@ typedef struct block
     };
 } block_t;
 
+// An arena bump allocates payloads out of chunks it mallocs, and frees the
+// chunks all at once.  Each chunk starts with a pointer to the chunk before it.
+struct arena {
+    void **chunks;     // the newest chunk, which payloads are bumped out of
+    char *next;        // next free byte of the newest chunk
+    char *end;         // end of the newest chunk
+    size_t chunk_size; // bytes asked for each chunk, past its pointer
+};
+
 
 /* Global variables */
 
@@ -138,15 +202,47 @@ typedef struct block
 static block_t *heap_start = NULL; // Pointer to the first block in the heap
 // Segregated Free List Headers
 static block_t *seg_lists[] = {NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL};
+// Segregated Free List Tails -- where MM_FIFO inserts
+static block_t *seg_tails[] = {NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL};
+// Blocks of each list to start an MM_ADDR_ORDER search from: the highest
+// block of the list in each 2^finger_region_bits byte region of the heap,
+// with a bit for each region that has one and a summary bit for each word
+// of those.  There are enough regions for memlib's 100MB heap; the last
+// one takes any heap past them.
+#define FINGER_REGIONS (MM_LIST_ORDER == MM_ADDR_ORDER ? (100 << 20) >> 12 : 64)
+#define FINGER_WORDS ((FINGER_REGIONS + 63) / 64)
+static block_t *seg_fingers[10][FINGER_REGIONS];
+static word_t finger_bits[10][FINGER_WORDS];
+static word_t finger_summary[10][(FINGER_WORDS + 63) / 64];
+static size_t finger_regions_used = 0; // regions given a finger since mm_init
+// Blocks whose headers were written and seg lists that were changed since
+// the last incremental heap check.  Overflowing the buffer forces a full check.
+static block_t *dirty_blocks[64];
+static const size_t max_dirty_blocks = 64;
+static size_t dirty_count = 0;
+static bool dirty_overflow = true;
+static word_t dirty_lists = 0;
+// Every byte of the heap from zero_start up is still zero, as no heap since
+// mem_init has used it, except the header, list pointers and footer of the free block at the end
+// of the heap.  place records whether it took its block from there, so
+// calloc knows what it has to clear.
+static char *zero_start = NULL;
+static bool placed_zeroed = false;
 // Segregated Free List Min Sizes -- used only for printing/debugging
 static const size_t seg_list_sizes[] = {16, 32, 64, 128, 256, 512, 1024, 2048, 4096, 8192};
 
 
 /* Function prototypes for internal helper routines */
 static block_t *extend_heap(size_t size);
-static void place(block_t *block, size_t asize);
+static block_t *place(block_t *block, size_t asize);
+static block_t *place_aligned(block_t *block, size_t asize, size_t alignment);
+static size_t place_batch(block_t *block, size_t asize, size_t n, void **ptrs);
 static block_t *find_fit(size_t asize);
+static block_t *find_aligned_fit(size_t asize, size_t alignment);
+static size_t aligned_lead(block_t *block, size_t alignment);
 static block_t *coalesce(block_t *block);
+static void raise_zero_start(void *addr);
+static void free_chunks(void **chunk);
 
 static size_t max(size_t x, size_t y);
 static size_t round_up(size_t size, size_t n);
@@ -179,11 +275,24 @@ static void set_prev_squished(block_t *block, block_t *prev);
 static void set_next_squished(block_t *block, block_t *next);
 
 static void list_insert(block_t *block);
+static void list_insert_slack(block_t *block);
+static void list_link(int list_index, block_t *block, block_t *prev);
+static block_t *find_addr_prev(int list_index, block_t *block);
+static size_t finger_region(block_t *block);
+static void finger_insert(int list_index, block_t *block);
+static void finger_remove(int list_index, block_t *block, block_t *prev);
+static block_t *finger_below(int list_index, size_t region);
 static void list_remove(block_t *block);
 
 static int find_seg_list_index(size_t asize);
 
+static void mark_dirty(block_t *block);
+static void clear_dirty();
+static bool check_block(block_t *b, int line, int *heap_count);
+static bool check_seg_list(int list_index, int line, int *free_list_count);
+
 bool mm_checkheap(int lineno);
+bool mm_checkheap_incremental(int lineno);
 bool print_heap();
 bool print_seg_lists();
 
@@ -196,13 +305,26 @@ bool print_seg_lists();
  * - Added explicit free list head to NULL. (previous commit -- whoops)
  * - Added prev_alloc functionality for Remove Footers.
  * - Added Seg List Initialization.
+ * - Resets the dirty block tracking for incremental heap checking.
+ * - Resets the seg list tails and fingers.
+ * - Resets the zeroed part of the heap.
+ * - Starts the zeroed part of the heap at the highest break since mem_init.
  */
 bool mm_init(void) 
 {
     // set seg list heads to NULL for when the code resets
     for(int i = 0; i < seg_list_count; i++) {
         seg_lists[i] = NULL;
+        seg_tails[i] = NULL;
+        memset(seg_fingers[i], 0, finger_regions_used * sizeof(block_t *));
+        memset(finger_bits[i], 0, (finger_regions_used + 63) / 64 * sizeof(word_t));
+        memset(finger_summary[i], 0, sizeof(finger_summary[i]));
     }
+    finger_regions_used = 0;
+    // the old heap is gone, so the next incremental check must be a full one
+    clear_dirty();
+    dirty_overflow = true;
+    zero_start = mem_heap_used_brk();
 
     // Create the initial empty heap 
     word_t *start = (word_t *)(mem_sbrk(2*wsize));
@@ -274,7 +396,7 @@ void *malloc(size_t size)
 
     }
 
-    place(block, asize);
+    block = place(block, asize);
     bp = header_to_payload(block);
 
     dbg_ensures(mm_checkheap(__LINE__));
@@ -357,6 +479,7 @@ void *realloc(void *ptr, size_t size)
  *
  * @Changelog
  * - Provided Function at Init.
+ * - Only clears what was written in a block placed from zeroed heap.
  */
 void *calloc(size_t elements, size_t size)
 {
@@ -369,17 +492,398 @@ void *calloc(size_t elements, size_t size)
         return NULL;
     }
     
+    placed_zeroed = false;
     bp = malloc(asize);
     if (bp == NULL)
     {
         return NULL;
     }
-    // Initialize all bits to 0
-    memset(bp, 0, asize);
+
+    if(placed_zeroed && asize > dsize) {
+        // only the old list pointers and footer of the free block can be set
+        block_t *block = payload_to_header(bp);
+        memset(bp, 0, dsize);
+        memset((char *) bp + get_payload_size(block) - wsize, 0, wsize);
+    } else {
+        // Initialize all bits to 0
+        memset(bp, 0, asize);
+    }
 
     return bp;
 }
 
+/**
+ * @brief allocates a block whose payload is a multiple of alignment bytes
+ *        into the heap, by carving it out of a free block and putting the
+ *        free space before it back on the seg lists
+ *
+ * @param alignment a power of two
+ * @param size the number of bytes requested
+ *
+ * @return the payload, or NULL if alignment is not a power of two or
+ *         the heap can't be extended
+ *
+ * @Changelog
+ * - Added Function for Aligned Allocation.
+ * - Added a size check so huge requests can't overflow the fit size.
+ */
+void *memalign(size_t alignment, size_t size)
+{
+    dbg_printf(BOLD BLUE"MEMALIGN CALLED with alignment: %lu, size: %lu\n"RESET, alignment, size);
+    dbg_requires(mm_checkheap(__LINE__));
+    size_t asize;      // Adjusted block size
+    size_t fitsize;    // Block size that fits wherever it starts
+    block_t *block;
+
+    if (alignment == 0 || (alignment & (alignment - 1)) != 0) {
+        return NULL;
+    }
+    // every payload is already aligned to dsize
+    if (alignment <= dsize) {
+        return malloc(size);
+    }
+
+    if (heap_start == NULL) { // Initialize heap if it isn't initialized
+        mm_init();
+    }
+
+    if (size == 0) { // Ignore spurious request
+        return NULL;
+    }
+    // fitsize would wrap around, as rounding adds up to wsize + dsize - 1
+    if (size > SIZE_MAX - alignment - min_block_size - 2 * dsize) {
+        return NULL;
+    }
+
+    asize = max(round_up(size + wsize, dsize), min_block_size);
+    fitsize = asize + alignment + min_block_size;
+
+    block = find_aligned_fit(asize, alignment);
+    if (block == NULL)
+    {
+        block = extend_heap(max(fitsize, chunksize));
+        if (block == NULL) // extend_heap returns an error
+        {
+            return NULL;
+        }
+    }
+
+    block = place_aligned(block, asize, alignment);
+
+    dbg_ensures(mm_checkheap(__LINE__));
+    return header_to_payload(block);
+}
+
+/**
+ * @brief overload the posix_memalign function with our implementation
+ *
+ * @Changelog
+ * - Added Function for Aligned Allocation.
+ */
+int posix_memalign(void **memptr, size_t alignment, size_t size)
+{
+    void *bp;
+
+    if (alignment % sizeof(void *) != 0 || (alignment & (alignment - 1)) != 0) {
+        return EINVAL;
+    }
+    bp = memalign(alignment, size);
+    if (bp == NULL && size != 0) {
+        return ENOMEM;
+    }
+    *memptr = bp;
+    return 0;
+}
+
+/**
+ * @brief overload the aligned_alloc function with our implementation
+ *
+ * @Changelog
+ * - Added Function for Aligned Allocation.
+ */
+void *aligned_alloc(size_t alignment, size_t size)
+{
+    return memalign(alignment, size);
+}
+
+/**
+ * @brief frees a payload from malloc, calloc or realloc given the size it
+ *        was allocated with.  Every block has its size in its header, which
+ *        coalesce reads anyway, so this is the same as free.
+ *
+ * @param bp the payload
+ * @param size the size it was allocated with
+ *
+ * @Changelog
+ * - Added Function for Sized Free.
+ */
+void free_sized(void *bp, size_t size)
+{
+    free(bp);
+}
+
+/**
+ * @brief returns how many bytes of a payload can be used, which can be more
+ *        than were asked for
+ *
+ * @param bp the payload
+ *
+ * @return the usable size, 0 for NULL
+ *
+ * @Changelog
+ * - Added Function for Sized Free.
+ */
+size_t malloc_usable_size(void *bp)
+{
+    if (bp == NULL)
+    {
+        return 0;
+    }
+    return get_payload_size(payload_to_header(bp));
+}
+
+/**
+ * @brief allocates n payloads of the same size at once, by splitting them
+ *        off one free block in a single pass, so each find_fit and list
+ *        update is shared by many payloads
+ *
+ * @param size the number of bytes requested for each payload
+ * @param n the number of payloads
+ * @param ptrs where the payloads are stored
+ *
+ * @return the number of payloads stored, fewer than n only if the heap
+ *         can't be extended, and 0 if size is 0
+ *
+ * @Changelog
+ * - Added Function for Batch Allocation.
+ */
+size_t malloc_batch(size_t size, size_t n, void **ptrs)
+{
+    dbg_printf(BOLD MAGENTA"MALLOC_BATCH CALLED with size: %lu, n: %lu\n"RESET, size, n);
+    dbg_requires(mm_checkheap(__LINE__));
+    size_t asize;      // Adjusted block size
+    size_t placed = 0;
+    block_t *block;
+
+    if (heap_start == NULL) // Initialize heap if it isn't initialized
+    {
+        mm_init();
+    }
+
+    if (size == 0) // Ignore spurious request
+    {
+        return 0;
+    }
+
+    asize = round_up(size + wsize, dsize);
+    while (placed < n)
+    {
+        block = find_fit(asize);
+
+        // extend the heap by enough for the rest of the batch at once
+        if (block == NULL)
+        {
+            block = extend_heap(max(asize * (n - placed), chunksize));
+            if (block == NULL) // extend_heap returns an error
+            {
+                break;
+            }
+        }
+
+        placed += place_batch(block, asize, n - placed, ptrs + placed);
+    }
+
+    dbg_ensures(mm_checkheap(__LINE__));
+    return placed;
+}
+
+/**
+ * @brief frees n payloads at once.  Blocks that follow each other in ptrs
+ *        and in the heap are joined and coalesced once.
+ *
+ * @param ptrs the payloads, any of which may be NULL
+ * @param n the number of payloads
+ *
+ * @Changelog
+ * - Added Function for Batch Allocation.
+ */
+void free_batch(void **ptrs, size_t n)
+{
+    dbg_printf(BOLD CYAN"FREE_BATCH CALLED with n: %lu\n"RESET, n);
+    size_t i = 0;
+
+    while (i < n)
+    {
+        if (ptrs[i] == NULL)
+        {
+            i++;
+            continue;
+        }
+
+        block_t *block = payload_to_header(ptrs[i]);
+        block_t *next = find_next(block);
+        size_t size = get_size(block);
+        for (i++; i < n && ptrs[i] == header_to_payload(next); i++)
+        {
+            size += get_size(next);
+            next = find_next(next);
+        }
+        if (size != get_size(block))
+        {
+            write_header(block, size, true, get_prev_alloc(block));
+        }
+
+        update_next_prev_alloc(coalesce(block), false);
+    }
+
+    dbg_ensures(mm_checkheap(__LINE__));
+}
+
+/**
+ * @brief creates an arena that payloads can be bump allocated from and
+ *        then released all at once
+ *
+ * @param chunk_size the bytes of payload each chunk of the arena holds,
+ *        or 0 for arena_chunksize
+ *
+ * @return the arena, or NULL if chunk_size is too big or it couldn't be
+ *         allocated
+ *
+ * @Changelog
+ * - Added Function for Arenas.
+ * - Added a chunk size check so huge chunks can't overflow.
+ */
+struct arena *arena_create(size_t chunk_size)
+{
+    struct arena *arena;
+
+    // a chunk this big would wrap around like a request in arena_alloc
+    if (chunk_size > SIZE_MAX - 4 * dsize)
+    {
+        return NULL;
+    }
+
+    arena = malloc(sizeof(struct arena));
+    if (arena == NULL)
+    {
+        return NULL;
+    }
+    arena->chunks = NULL;
+    arena->next = NULL;
+    arena->end = NULL;
+    arena->chunk_size = chunk_size != 0 ? round_up(chunk_size, dsize) : arena_chunksize;
+    return arena;
+}
+
+/**
+ * @brief allocates a payload from an arena by bumping past it in the
+ *        newest chunk, or by mallocing a new chunk once that is full.  A
+ *        request bigger than a chunk gets a chunk of its own, which goes
+ *        behind the newest one so its free space isn't lost.  The payload
+ *        can't be freed on its own, only with arena_reset or arena_destroy.
+ *
+ * @param arena the arena
+ * @param size the number of bytes requested
+ *
+ * @return the payload, or NULL if size is 0 or too big, or the heap
+ *         can't be extended
+ *
+ * @Changelog
+ * - Added Function for Arenas.
+ * - Added a size check so huge requests can't overflow the chunk size.
+ */
+void *arena_alloc(struct arena *arena, size_t size)
+{
+    void **chunk;
+    void *bp;
+
+    if (size == 0) // Ignore spurious request
+    {
+        return NULL;
+    }
+
+    // the chunk's size would wrap around, as rounding, the pointer to the
+    // chunk before and malloc's own rounding add up to 3 * dsize + wsize - 2
+    if (size > SIZE_MAX - 4 * dsize)
+    {
+        return NULL;
+    }
+
+    // keep every payload aligned to dsize
+    size = round_up(size, dsize);
+    if (size <= (size_t) (arena->end - arena->next))
+    {
+        bp = arena->next;
+        arena->next += size;
+        return bp;
+    }
+
+    // the pointer to the chunk before takes a dsize so payloads stay aligned
+    chunk = malloc(dsize + max(size, arena->chunk_size));
+    if (chunk == NULL)
+    {
+        return NULL;
+    }
+    bp = (char *) chunk + dsize;
+
+    if (size > arena->chunk_size && arena->chunks != NULL)
+    {
+        chunk[0] = arena->chunks[0];
+        arena->chunks[0] = chunk;
+        return bp;
+    }
+
+    chunk[0] = arena->chunks;
+    arena->chunks = chunk;
+    arena->next = (char *) bp + size;
+    arena->end = (char *) chunk + malloc_usable_size(chunk);
+    return bp;
+}
+
+/**
+ * @brief releases every payload of an arena, keeping only its newest chunk
+ *        to allocate from again and freeing the rest
+ *
+ * @param arena the arena
+ *
+ * @Changelog
+ * - Added Function for Arenas.
+ */
+void arena_reset(struct arena *arena)
+{
+    void **chunk = arena->chunks;
+
+    if (chunk == NULL)
+    {
+        return;
+    }
+
+    free_chunks(chunk[0]);
+    chunk[0] = NULL;
+    arena->next = (char *) chunk + dsize;
+    arena->end = (char *) chunk + malloc_usable_size(chunk);
+}
+
+/**
+ * @brief releases every payload of an arena and the arena itself, by
+ *        freeing each of its chunks with a single coalesce
+ *
+ * @param arena the arena, or NULL
+ *
+ * @Changelog
+ * - Added Function for Arenas.
+ */
+void arena_destroy(struct arena *arena)
+{
+    if (arena == NULL)
+    {
+        return;
+    }
+
+    free_chunks(arena->chunks);
+    free(arena);
+}
+
 /******** The remaining content below are helper and debug routines ********/;
 
 /**
@@ -393,6 +897,7 @@ void *calloc(size_t elements, size_t size)
  * @Changelog
  * - Provided Function at Init.
  * - Added prev_alloc functionality for Remove Footers.
+ * - Keeps track of the zeroed part of the heap.
  */
 static block_t *extend_heap(size_t size) 
 {
@@ -404,6 +909,9 @@ static block_t *extend_heap(size_t size)
     {
         return NULL;
     }
+    // the new memory is zero, but the old end of the heap no longer is the
+    // metadata of a block at the end of the heap once it is coalesced
+    raise_zero_start(bp);
     
     // Initialize free block header/footer 
     block_t *block = payload_to_header(bp);
@@ -430,6 +938,7 @@ static block_t *extend_heap(size_t size)
  * - Provided Function at Init.  Added functionality to it.
  * - Added explicit free list insert and remove.
  * - Added prev_alloc functionality for Remove Footers.
+ * - Keeps track of the zeroed part of the heap.
  */
 static block_t *coalesce(block_t * block) 
 {
@@ -448,6 +957,10 @@ static block_t *coalesce(block_t * block)
     }
 
     size_t next_size = get_size(next_block);
+    if(!next_alloc) {
+        // the next block's header and list pointers are left in the middle
+        raise_zero_start(&next_block->next + 1);
+    }
 
     // case 2
     if(prev_alloc && !next_alloc) {
@@ -486,6 +999,39 @@ static block_t *coalesce(block_t * block)
     return prev_block;
 }
 
+/**
+ * @brief moves zero_start up to addr, once the heap below addr has been
+ *        handed out or has metadata in it that no block owns anymore
+ *
+ * @param addr the lowest address that may still be zero
+ *
+ * @Changelog
+ * - Added for Zeroed calloc.
+ */
+static void raise_zero_start(void *addr)
+{
+    if((char *) addr > zero_start) {
+        zero_start = addr;
+    }
+}
+
+/**
+ * @brief frees a chunk of an arena and every chunk before it
+ *
+ * @param chunk the newest of the chunks, or NULL
+ *
+ * @Changelog
+ * - Added Function for Arenas.
+ */
+static void free_chunks(void **chunk)
+{
+    while (chunk != NULL) {
+        void **prev = chunk[0];
+        free(chunk);
+        chunk = prev;
+    }
+}
+
 /**
  * @brief splits the block into a block with the given size if it can be split,
  *          else writes the new header and footer for the given block
@@ -493,18 +1039,42 @@ static block_t *coalesce(block_t * block)
  * @param block the block being allocated
  * @param asize the required number of bytes
  *
+ * @return the allocated block, which is at the high end of the given block
+ *          if it was split for a request below split_threshold
+ *
  * @Changelog
  * - Provided Function at Init.
  * - Added explicit free list insert and remove.
  * - Added prev_alloc functionality for Remove Footers.
  * - Slightly modified to work correctly with Segregated Lists.
+ * - Places small requests at the high end with MM_SPLIT_THRESHOLD.
+ * - Records whether the allocated block came from the zeroed heap.
  */
-static void place(block_t *block, size_t asize)
+static block_t *place(block_t *block, size_t asize)
 {
     size_t csize = get_size(block);
     bool prev_alloc = get_prev_alloc(block);
 
-    if ((csize - asize) >= min_block_size)
+    // the last block stays split from the low end, so its free remainder is
+    // still at the end of the heap for extend_heap to coalesce with
+    if ((csize - asize) >= min_block_size && asize < split_threshold
+            && get_size(find_next(block)) != 0)
+    {
+        block_t *block_alloc;
+        list_remove(block);
+        write_header(block, csize-asize, false, prev_alloc);
+        write_footer(block, csize-asize, false, prev_alloc);
+        list_insert(block);
+
+        block_alloc = find_next(block);
+        block_alloc->header = 0; // clear what was there so no squished pointer is kept
+        write_header(block_alloc, asize, true, false);
+        update_next_prev_alloc(block_alloc, true);
+        placed_zeroed = block_alloc->payload >= zero_start;
+        raise_zero_start(find_next(block_alloc));
+        return block_alloc;
+    }
+    else if ((csize - asize) >= min_block_size)
     {
         block_t *block_next;
         list_remove(block);
@@ -523,6 +1093,114 @@ static void place(block_t *block, size_t asize)
         write_header(block, csize, true, prev_alloc);
         update_next_prev_alloc(block, true);
     }
+    placed_zeroed = block->payload >= zero_start;
+    raise_zero_start(find_next(block));
+    return block;
+}
+
+/**
+ * @brief places an allocated block of asize bytes with its payload aligned
+ *        to alignment in the given block, splitting off the free space before
+ *        and after it.  Always splits from the low end, since the payload
+ *        could not be aligned at the high end.
+ *
+ * @param block a free block with room for asize bytes past its aligned_lead
+ * @param asize the required number of bytes
+ * @param alignment a power of two greater than dsize
+ *
+ * @return the allocated block
+ *
+ * @Changelog
+ * - Added Function for Aligned Allocation.
+ * - Puts the free space before the payload at the back of its seg list.
+ */
+static block_t *place_aligned(block_t *block, size_t asize, size_t alignment)
+{
+    size_t csize = get_size(block);
+    bool prev_alloc = get_prev_alloc(block);
+    size_t lead = aligned_lead(block, alignment);
+
+    list_remove(block);
+    if(lead != 0) {
+        write_header(block, lead, false, prev_alloc);
+        write_footer(block, lead, false, prev_alloc);
+        list_insert_slack(block);
+
+        block = find_next(block);
+        block->header = 0; // clear what was there so no squished pointer is kept
+        csize -= lead;
+        prev_alloc = false;
+    }
+
+    if((csize - asize) >= min_block_size) {
+        block_t *block_next;
+        write_header(block, asize, true, prev_alloc);
+
+        block_next = find_next(block);
+        block_next->header = 0;
+        write_header(block_next, csize-asize, false, true);
+        write_footer(block_next, csize-asize, false, true);
+        update_next_prev_alloc(block_next, false);
+        list_insert(block_next);
+    } else {
+        write_header(block, csize, true, prev_alloc);
+        update_next_prev_alloc(block, true);
+    }
+    raise_zero_start(find_next(block));
+    return block;
+}
+
+/**
+ * @brief splits as many allocated blocks of asize bytes as are wanted, up to
+ *        n, off the low end of a free block in one pass.  Only the first
+ *        block's prev_alloc bit and the remainder need working out, since
+ *        every other block follows an allocated one.
+ *
+ * @param block the free block
+ * @param asize the required number of bytes for each block
+ * @param n the most blocks wanted
+ * @param ptrs where the payloads are stored
+ *
+ * @return the number of blocks placed, at least 1
+ *
+ * @Changelog
+ * - Added Function for Batch Allocation.
+ */
+static size_t place_batch(block_t *block, size_t asize, size_t n, void **ptrs)
+{
+    size_t csize = get_size(block);
+    bool prev_alloc = get_prev_alloc(block);
+    size_t count = csize / asize < n ? csize / asize : n;
+    size_t rest = csize - count * asize;
+    block_t *last = block;
+
+    list_remove(block);
+    for (size_t i = 0; i < count; i++)
+    {
+        last = block;
+        last->header = 0; // clear what was there so no squished pointer is kept
+        // a remainder too small to be a block stays with the last one
+        size_t bsize = (i == count - 1 && rest < min_block_size) ? asize + rest : asize;
+        write_header(last, bsize, true, prev_alloc);
+        ptrs[i] = header_to_payload(last);
+        prev_alloc = true;
+        block = find_next(last);
+    }
+
+    if (rest >= min_block_size)
+    {
+        block->header = 0;
+        write_header(block, rest, false, true);
+        write_footer(block, rest, false, true);
+        update_next_prev_alloc(block, false);
+        list_insert(block);
+    }
+    else
+    {
+        update_next_prev_alloc(last, true);
+    }
+    raise_zero_start(find_next(last));
+    return count;
 }
 
 /**
@@ -537,6 +1215,7 @@ static void place(block_t *block, size_t asize)
  * - Changed to find first block in the explicit free list.
  * - Changed to Nth fit algorithm with explicit free list.
  * - Changed to Nth fit with Segregated Free Lists.
+ * - Fit policy chosen at compile time with MM_FIT_POLICY.
  */
 static block_t *find_fit(size_t asize)
 {
@@ -577,25 +1256,120 @@ static block_t *find_fit(size_t asize)
                     return block;
                 }
 
+                if(MM_FIT_POLICY == MM_FIRST_FIT) {
+                    return block;
+                }
+
                 if(block_size < best_block_size) {
                     best_block = block;
                     best_block_size = block_size;
                 }
             }
-
-            // end the loop if we have found N blocks that fit
-            if(blocks_found >= N) {
-                return best_block;
+
+            // end the loop if we have found N blocks that fit
+            if(MM_FIT_POLICY == MM_NTH_FIT && blocks_found >= N) {
+                return best_block;
+            }
+        }
+
+        // if we have found something that fits, don't search the rest of the lists
+        if(blocks_found > 0) {
+            break;
+        }
+    }
+
+    return best_block; // NULL if no block found
+}
+
+/**
+ * @brief finds a block that can hold asize bytes with the payload aligned
+ *        to alignment.  Takes the first one, and looks at no more than N
+ *        blocks in all of the seg lists whose blocks might not fit, since
+ *        the free blocks left before aligned payloads gather there.  Lists
+ *        too small for any lead only have their head looked at.
+ *
+ * @param asize the required number of bytes
+ * @param alignment a power of two greater than dsize
+ *
+ * @return the block, or NULL if no such block was found
+ *
+ * @Changelog
+ * - Added Function for Aligned Allocation.
+ * - Bounded the search of the list fitsize falls in, and shared the bound
+ *   between lists, so lists full of lead slack can't be scanned end to end.
+ * - Only looks at the head of lists too small for any lead.
+ * - Stops at the lead slack at the back of a LIFO list.
+ */
+static block_t *find_aligned_fit(size_t asize, size_t alignment)
+{
+    // a block this big fits however its payload is aligned
+    size_t fitsize = asize + alignment + min_block_size;
+    int fit_index = find_seg_list_index(fitsize);
+
+    int blocks_checked = 0;
+
+    // fitsize's own list holds blocks either side of it, so it counts too
+    for(int i = find_seg_list_index(asize); i <= fit_index; i++) {
+        // no block in this list has room for a lead, so only one whose payload
+        // is already aligned fits.  One freed from an aligned payload goes in
+        // at the head, and the lead slack that fills these lists at the tail.
+        size_t list_max = i < last_list_index ? 2 * seg_list_sizes[i] - dsize : SIZE_MAX;
+        if(list_max < asize + min_block_size) {
+            block_t *block = seg_lists[i];
+            if(block != NULL && aligned_lead(block, alignment) == 0 && get_size(block) >= asize) {
+                return block;
+            }
+            continue;
+        }
+        block_t *next;
+        for(block_t *block = seg_lists[i]; block != NULL && blocks_checked < N; block = next) {
+            // the 16 byte list is linked through the squished pointers
+            next = i == first_list_index ? get_next_squished(block) : block->next;
+            size_t block_size = get_size(block);
+            size_t lead = aligned_lead(block, alignment);
+            if(block_size >= fitsize || lead + asize <= block_size) {
+                return block;
+            }
+            // a block that only reaches the next aligned payload is lead slack,
+            // and in LIFO order the rest of the list past it is too
+            if(MM_LIST_ORDER == MM_LIFO && lead >= block_size) {
+                break;
             }
+            blocks_checked++;
         }
-
-        // if we have found something that fits, don't search the rest of the lists
-        if(blocks_found > 0) {
-            break;
+    }
+    // every block in the lists above fits
+    for(int i = fit_index + 1; i < seg_list_count; i++) {
+        if(seg_lists[i] != NULL) {
+            return seg_lists[i];
         }
     }
+    return NULL;
+}
 
-    return best_block; // NULL if no block found
+/**
+ * @brief returns how far a free block's payload moves up to be aligned,
+ *        leaving a free block of at least min_block_size before it
+ *
+ * @param block the free block
+ * @param alignment a power of two greater than dsize
+ *
+ * @return the size of the free block left before the aligned block
+ *
+ * @Changelog
+ * - Added Function for Aligned Allocation.
+ */
+static size_t aligned_lead(block_t *block, size_t alignment)
+{
+    size_t bp = (size_t) header_to_payload(block);
+    size_t lead = round_up(bp, alignment) - bp;
+
+    // the space before the payload becomes a free block, so it can't be
+    // smaller than one
+    if(lead != 0 && lead < min_block_size) {
+        lead += alignment;
+    }
+    return lead;
 }
 
 /**
@@ -782,6 +1556,7 @@ static bool get_is_16(block_t *block) {
  * - Provided Function at Init.
  * - Added prev_alloc parameter for Remove Footers.
  * - Adjusted to save pointers for squished 16 byte blocks.
+ * - Marks the block dirty for incremental heap checking.
  */
 static void write_header(block_t *block, size_t size, bool alloc, bool prev_alloc)
 {
@@ -792,6 +1567,7 @@ static void write_header(block_t *block, size_t size, bool alloc, bool prev_allo
     } else {
         block->header = pack(size, alloc, prev_alloc);
     }
+    mark_dirty(block);
 }
 
 
@@ -983,7 +1759,8 @@ static void set_next_squished(block_t *block, block_t *next) {
 }
 
 /**
- * @brief insert the block at the beginning of the correct seg list
+ * @brief insert the block into the correct seg list, at the place
+ * MM_LIST_ORDER picks for it
  *
  * @param block the block to be inserted
  *
@@ -991,38 +1768,237 @@ static void set_next_squished(block_t *block, block_t *next) {
  * - Added Function for Explicit Free List.
  * - Modified for Segregated Free Lists.
  * - Added condition for when inserting a squished block.
+ * - Marks the seg list dirty for incremental heap checking.
+ * - Inserts at the tail or in address order as well, moving the linking
+ *   of both kinds of block into list_link.
  */
 static void list_insert(block_t *block) {
 
-    size_t block_size = get_size(block);
-    int list_index = find_seg_list_index(block_size);
-    block_t *list_head = seg_lists[list_index];
+    int list_index = find_seg_list_index(get_size(block));
 
-    if(block_size == squished_block_size) { // insert squished block into 16 byte list
+    if(MM_LIST_ORDER == MM_FIFO) { // insert at the tail
+        list_link(list_index, block, seg_tails[list_index]);
+    } else if(MM_LIST_ORDER == MM_ADDR_ORDER) { // insert in address order
+        list_link(list_index, block, find_addr_prev(list_index, block));
+        finger_insert(list_index, block);
+    } else { // insert at the head
+        list_link(list_index, block, NULL);
+    }
+    dirty_lists |= (word_t) 1 << list_index;
+}
 
-        if(list_head == NULL) { // empty free list
-            set_prev_squished(block, NULL);
-            set_next_squished(block, NULL);
-        }
-        else { // at least one item in the free list
-            set_prev_squished(block, NULL);
-            set_next_squished(block, list_head);
-            set_prev_squished(list_head, block);
-        }
+/**
+ * @brief inserts the free block left before an aligned payload at the tail
+ *        of its seg list.  It seldom fits the next aligned request, so
+ *        find_aligned_fit, which only looks at N blocks from the head,
+ *        shouldn't spend them on it.  In address order it goes where it
+ *        belongs, like any other block.
+ *
+ * @param block the free block to insert
+ *
+ * @Changelog
+ * - Added Function for Aligned Allocation.
+ */
+static void list_insert_slack(block_t *block) {
+    int list_index = find_seg_list_index(get_size(block));
 
-    } else { // insert non-squished block
+    if(MM_LIST_ORDER == MM_ADDR_ORDER) {
+        list_insert(block);
+        return;
+    }
+    list_link(list_index, block, seg_tails[list_index]);
+    dirty_lists |= (word_t) 1 << list_index;
+}
 
-        if(list_head == NULL) { // empty free list
-            block->prev = NULL;
-            block->next = NULL;
-        }
-        else { // at least one item in the free list
-            block->prev = NULL;
-            block->next = list_head;
-            list_head->prev = block;
+/**
+ * @brief link a block into a seg list right after another block.  The
+ * 16 byte list holds only squished blocks, so it is linked through the
+ * squished pointers.
+ *
+ * @param list_index the seg list to link the block into
+ * @param block the block to be linked in
+ * @param prev the block to follow, or NULL to make the block the head
+ *
+ * @ChangeLog
+ * - Added Function for Free List Orders.
+ */
+static void list_link(int list_index, block_t *block, block_t *prev) {
+    bool squished = list_index == first_list_index;
+    block_t *next = seg_lists[list_index];
+    if(prev != NULL) {
+        next = squished ? get_next_squished(prev) : prev->next;
+    }
+
+    if(squished) {
+        set_prev_squished(block, prev);
+        set_next_squished(block, next);
+    } else {
+        block->prev = prev;
+        block->next = next;
+    }
+
+    if(prev == NULL) {
+        seg_lists[list_index] = block;
+    } else if(squished) {
+        set_next_squished(prev, block);
+    } else {
+        prev->next = block;
+    }
+
+    if(next == NULL) {
+        seg_tails[list_index] = block;
+    } else if(squished) {
+        set_prev_squished(next, block);
+    } else {
+        next->prev = block;
+    }
+}
+
+/**
+ * @brief find the last block in an address-ordered seg list that is
+ * below the given block.  Blocks below the head or above the tail, or
+ * above the finger of their region, are placed at once.  Otherwise the
+ * search walks the blocks of the region from the finger below it.
+ *
+ * @param list_index the seg list to search
+ * @param block the block being inserted
+ *
+ * @return the block to insert after, or NULL if it goes at the head
+ *
+ * @ChangeLog
+ * - Added Function for Address-Ordered Free Lists.
+ * - Finds the finger to start from by region instead of scanning them.
+ */
+static block_t *find_addr_prev(int list_index, block_t *block) {
+    bool squished = list_index == first_list_index;
+    block_t *head = seg_lists[list_index];
+    if(head == NULL || block < head) {
+        return NULL;
+    }
+    if(seg_tails[list_index] < block) {
+        return seg_tails[list_index];
+    }
+
+    // the finger is the highest block of the region, so a block above it follows it
+    size_t region = finger_region(block);
+    block_t *prev = seg_fingers[list_index][region];
+    if(prev != NULL && prev < block) {
+        return prev;
+    }
+    // otherwise only the blocks of the region below it lie in between
+    prev = finger_below(list_index, region);
+    if(prev == NULL) {
+        prev = head;
+    }
+    block_t *next = squished ? get_next_squished(prev) : prev->next;
+    while(next != NULL && next < block) {
+        prev = next;
+        next = squished ? get_next_squished(next) : next->next;
+    }
+    return prev;
+}
+
+/**
+ * @brief get the region of the heap a block is in, for the fingers of its
+ * seg list.  Blocks past the last region are all in it.
+ *
+ * @param block the block whose region is wanted
+ *
+ * @return the region
+ *
+ * @ChangeLog
+ * - Added Function for Address-Ordered Free Lists.
+ * - Numbers the regions from the start of the heap instead of wrapping.
+ */
+static size_t finger_region(block_t *block) {
+    size_t region = (size_t) ((char *) block - (char *) heap_start) >> finger_region_bits;
+    return region < FINGER_REGIONS ? region : FINGER_REGIONS - 1;
+}
+
+/**
+ * @brief make a block just inserted into an address-ordered seg list the
+ * finger of its region, if it is the highest block of the list there
+ *
+ * @param list_index the seg list
+ * @param block the block inserted
+ *
+ * @ChangeLog
+ * - Added Function for Address-Ordered Free Lists.
+ */
+static void finger_insert(int list_index, block_t *block) {
+    size_t region = finger_region(block);
+    block_t **finger = &seg_fingers[list_index][region];
+
+    if(*finger == NULL) {
+        size_t word = region / 64;
+        finger_bits[list_index][word] |= (word_t) 1 << (region % 64);
+        finger_summary[list_index][word / 64] |= (word_t) 1 << (word % 64);
+        finger_regions_used = max(finger_regions_used, region + 1);
+        *finger = block;
+    } else if(*finger < block) {
+        *finger = block;
+    }
+}
+
+/**
+ * @brief hand the finger of a block being removed from an address-ordered
+ * seg list to the block before it, or clear it if that block is in
+ * another region
+ *
+ * @param list_index the seg list
+ * @param block the block removed
+ * @param prev the block before it in the list, or NULL
+ *
+ * @ChangeLog
+ * - Added Function for Address-Ordered Free Lists.
+ */
+static void finger_remove(int list_index, block_t *block, block_t *prev) {
+    size_t region = finger_region(block);
+    if(seg_fingers[list_index][region] != block) {
+        return;
+    }
+    if(prev != NULL && finger_region(prev) == region) {
+        seg_fingers[list_index][region] = prev;
+        return;
+    }
+
+    size_t word = region / 64;
+    seg_fingers[list_index][region] = NULL;
+    finger_bits[list_index][word] &= ~((word_t) 1 << (region % 64));
+    if(finger_bits[list_index][word] == 0) {
+        finger_summary[list_index][word / 64] &= ~((word_t) 1 << (word % 64));
+    }
+}
+
+/**
+ * @brief find the highest block of an address-ordered seg list below a
+ * region, through the bits of the regions that have a finger
+ *
+ * @param list_index the seg list
+ * @param region the region to look below
+ *
+ * @return the finger of the closest region below that has one, or NULL
+ *
+ * @ChangeLog
+ * - Added Function for Address-Ordered Free Lists.
+ */
+static block_t *finger_below(int list_index, size_t region) {
+    size_t word = region / 64;
+    word_t bits = finger_bits[list_index][word] & (((word_t) 1 << (region % 64)) - 1);
+
+    if(bits == 0) {
+        size_t summary = word / 64;
+        word_t words = finger_summary[list_index][summary] & (((word_t) 1 << (word % 64)) - 1);
+        while(words == 0) {
+            if(summary == 0) {
+                return NULL;
+            }
+            words = finger_summary[list_index][--summary];
         }
+        word = summary * 64 + 63 - __builtin_clzll(words);
+        bits = finger_bits[list_index][word];
     }
-    seg_lists[list_index] = block;
+    return seg_fingers[list_index][word * 64 + 63 - __builtin_clzll(bits)];
 }
 
 /**
@@ -1034,6 +2010,8 @@ static void list_insert(block_t *block) {
  * - Added Function for Explicit Free List.
  * - Modified for Segregated Free Lists.
  * - Added condition for when removing a squished block.
+ * - Marks the seg list dirty for incremental heap checking.
+ * - Keeps the seg list tails and fingers up to date.
  */
 static void list_remove(block_t *block) {
 
@@ -1043,39 +2021,51 @@ static void list_remove(block_t *block) {
     if(block_size == squished_block_size) { // remove a squished block from 16 byte seg list
         // avoid extra function call because we know what list index for sure
         int list_index = first_list_index;
+        dirty_lists |= (word_t) 1 << list_index;
 
         block_t *prev_block = get_prev_squished(block);
         block_t *next_block = get_next_squished(block);
 
         if(!prev_block && !next_block) {
             seg_lists[list_index] = NULL;
+            seg_tails[list_index] = NULL;
         } else if(!prev_block) {
             set_prev_squished(next_block, NULL);
             seg_lists[list_index] = next_block;
         } else if(!next_block) {
             set_next_squished(prev_block, NULL);
+            seg_tails[list_index] = prev_block;
         } else {
             set_next_squished(prev_block, next_block);
             set_prev_squished(next_block, prev_block);
         }
+        if(MM_LIST_ORDER == MM_ADDR_ORDER) {
+            finger_remove(list_index, block, prev_block);
+        }
 
     } else { // remove all other blocks from its seg list
         int list_index = find_seg_list_index(block_size);
+        dirty_lists |= (word_t) 1 << list_index;
 
         block_t *prev_block = block->prev;
         block_t *next_block = block->next;
 
         if(prev_block == NULL && next_block == NULL) {
             seg_lists[list_index] = NULL;
+            seg_tails[list_index] = NULL;
         } else if(prev_block == NULL) {
             next_block->prev = NULL;
             seg_lists[list_index] = next_block;
         } else if(next_block == NULL) {
             prev_block->next = NULL;
+            seg_tails[list_index] = prev_block;
         } else {
             prev_block->next = next_block;
             next_block->prev = prev_block;
         }
+        if(MM_LIST_ORDER == MM_ADDR_ORDER) {
+            finger_remove(list_index, block, prev_block);
+        }
     }
 }
 
@@ -1105,6 +2095,168 @@ static int find_seg_list_index(size_t asize) {
 
 
 
+/**
+ * @brief records that a block's header was written, for the next
+ *        incremental heap check.
+ *
+ * @param block the block whose header changed
+ *
+ * @Changelog
+ * - Added for incremental heap checking.
+ */
+static void mark_dirty(block_t *block) {
+    if(dirty_count < max_dirty_blocks) {
+        dirty_blocks[dirty_count++] = block;
+    } else {
+        dirty_overflow = true;
+    }
+}
+
+/**
+ * @brief forgets the dirty blocks and seg lists after a heap check.
+ *
+ * @Changelog
+ * - Added for incremental heap checking.
+ */
+static void clear_dirty() {
+    dirty_count = 0;
+    dirty_overflow = false;
+    dirty_lists = 0;
+}
+
+/**
+ * @brief checks the invariants between a block and the block after it.
+ *
+ * @param b the block to check
+ * @param line the line number of the caller
+ * @param heap_count incremented if the block is free
+ *
+ * @return true if no invariants are violated, false otherwise
+ *
+ * @Changelog
+ * - Split out of mm_checkheap for incremental heap checking.
+ */
+static bool check_block(block_t *b, int line, int *heap_count) {
+    block_t * next = find_next(b);
+
+    bool b_alloc = get_alloc(b);
+    bool prev_alloc = get_prev_alloc(b);
+    bool next_alloc = get_alloc(next);
+
+    if (b_alloc == false) {
+        (*heap_count)++; // increment count of free blocks in the heap
+
+        // Check that Coalesce works as intended
+        if (prev_alloc == false || next_alloc == false) {
+            printf(BOLD RED"Coalesce Invariant failed at line %d with heap:\n"RESET, line);
+            print_heap();
+            return false; // INVARIANT 1
+        }
+
+        // Check that the footer matches the header
+        bool is_16 = get_is_16(b);
+        if(is_16) {
+            if((b->header & squish_bits_mask) != (b->footer & squish_bits_mask)) {
+                printf(BOLD RED"Footer Not Matching Header (Squished) Invariant Broken at line %d with heap:\n"RESET, line);
+                print_heap();
+                return false; // INVARIANT 6A
+            }
+        } else {
+            if(b->header != *find_prev_footer(next)) {
+                printf(BOLD RED"Footer Not Matching Header (Non-Squished) Invariant Broken at line %d with heap:\n"RESET, line);
+                print_heap();
+                return false; // INVARIANT 6B
+            }
+        }
+    }
+
+    if(b_alloc != get_prev_alloc(next)) {
+        printf(BOLD RED"Incorrect Prev Alloc Bit Invariant Broken at line %d with heap:\n"RESET, line);
+        print_heap();
+        return false; // INVARIANT 7
+    }
+    return true;
+}
+
+/**
+ * @brief checks the invariants of every block in one seg list.
+ *
+ * @param list_index the seg list to check
+ * @param line the line number of the caller
+ * @param free_list_count incremented for every block in the list
+ *
+ * @return true if no invariants are violated, false otherwise
+ *
+ * @Changelog
+ * - Split out of mm_checkheap for incremental heap checking.
+ */
+static bool check_seg_list(int list_index, int line, int *free_list_count) {
+    block_t *f_block = seg_lists[list_index];
+    while(f_block != NULL) {
+        (*free_list_count)++; // increment count of free list blocks
+        size_t block_size = get_size(f_block);
+        bool is_16 = get_is_16(f_block);
+
+        // Check that the free list block is actually free
+        if(get_alloc(f_block)) {
+            printf(BOLD RED"Allocated Block (addr: %p) in Seg List Invariant"
+                           " Broken at line %d with heap:\n"RESET, f_block, line);
+            print_heap();
+            print_seg_lists();
+            return false; // INVARIANT 2
+        }
+
+        block_t *next = is_16 ? get_next_squished(f_block) : f_block->next;
+        block_t *next_prev = NULL;
+        if(next) {
+            next_prev = get_is_16(next) ? get_prev_squished(next) : next->prev;
+        }
+
+        // Check that the free list is doubly linked
+        if(next != NULL && next_prev != f_block) {
+            printf(BOLD RED"Seg List (index: %d) Not Doubly Linked Invariant"
+                           " Broken at line %d with heap:\n"RESET, list_index, line);
+            print_heap();
+            return false; // INVARIANT 3
+        }
+
+        // Check that all blocks are in the correct Seg List
+        if(!(block_size >= seg_list_sizes[list_index]
+            && (list_index+1 == seg_list_count || block_size < seg_list_sizes[list_index+1]))) {
+            printf(BOLD RED"Block in Wrong Seg List Invariant Broken at line %d with heap:\n"RESET, line);
+            print_heap();
+            print_seg_lists();
+            return false; // INVARIANT 8
+        }
+
+        // Check that an address-ordered list is in address order
+        if(MM_LIST_ORDER == MM_ADDR_ORDER && next != NULL && next < f_block) {
+            printf(BOLD RED"Seg List (index: %d) Out of Address Order Invariant"
+                           " Broken at line %d with heap:\n"RESET, list_index, line);
+            print_seg_lists();
+            return false; // INVARIANT 9
+        }
+
+        // Check that the tail is the last block in the list
+        if(next == NULL && seg_tails[list_index] != f_block) {
+            printf(BOLD RED"Seg List (index: %d) Wrong Tail Invariant"
+                           " Broken at line %d with heap:\n"RESET, list_index, line);
+            print_seg_lists();
+            return false; // INVARIANT 10
+        }
+
+        const int too_large_number = 1000000000;
+        if(*free_list_count > too_large_number) {
+            printf(BOLD RED"Free Lists in an Infinite Loop at line %d with heap:\n"RESET, line);
+            print_heap();
+            return false; // INVARIANT 5
+        }
+
+        f_block = next;
+    }
+    return true;
+}
+
 /**
  * @brief checks the heap for all invariants as shown in the changelog.
  *
@@ -1118,6 +2270,8 @@ static int find_seg_list_index(size_t asize) {
  * - Added Remove Footers Invariants -- 6, 7.
  * - Added Segregated Free List Invariant -- 8.
  * - Added Checks for Squished Blocks to Existing Invariants.
+ * - Moved the per block and per list checks into helpers.
+ * - Added Free List Order Invariants -- 9, 10.
  */
 bool mm_checkheap(int line)
 {
@@ -1125,113 +2279,106 @@ bool mm_checkheap(int line)
     int free_list_count = 0;
     int heap_count = 0;
 
+    // everything is checked, so nothing is dirty anymore
+    clear_dirty();
+
     block_t *b;
     // loop through the heap for all invariants requiring the entire heap
     for (b = heap_start; get_size(b) != 0; b = find_next(b)) {
-        block_t * next = find_next(b);
-
-        bool b_alloc = get_alloc(b);
-        bool prev_alloc = get_prev_alloc(b);
-        bool next_alloc = get_alloc(next);
-
-        if (b_alloc == false) {
-            heap_count++; // increment count of free blocks in the heap
-
-            // Check that Coalesce works as intended
-            if (prev_alloc == false || next_alloc == false) {
-                printf(BOLD RED"Coalesce Invariant failed at line %d with heap:\n"RESET, line);
-                print_heap();
-                return false; // INVARIANT 1
-            }
-
-            // Check that the footer matches the header
-            bool is_16 = get_is_16(b);
-            if(is_16) {
-                if((b->header & squish_bits_mask) != (b->footer & squish_bits_mask)) {
-                    printf(BOLD RED"Footer Not Matching Header (Squished) Invariant Broken at line %d with heap:\n"RESET, line);
-                    print_heap();
-                    return false; // INVARIANT 6A
-                }
-            } else {
-                if(b->header != *find_prev_footer(next)) {
-                    printf(BOLD RED"Footer Not Matching Header (Non-Squished) Invariant Broken at line %d with heap:\n"RESET, line);
-                    print_heap();
-                    return false; // INVARIANT 6B
-                }
-            }
-        }
-
-        if(b_alloc != get_prev_alloc(next)) {
-            printf(BOLD RED"Incorrect Prev Alloc Bit Invariant Broken at line %d with heap:\n"RESET, line);
-            print_heap();
-            return false; // INVARIANT 7
+        if(!check_block(b, line, &heap_count)) {
+            return false;
         }
     }
 
     // loop through the seg lists for all invariants requiring the seg free lists
     int list_index = 0;
     for(; list_index < seg_list_count; list_index++) {
+        if(!check_seg_list(list_index, line, &free_list_count)) {
+            return false;
+        }
+    }
 
-        block_t *f_block = seg_lists[list_index];
-        while(f_block != NULL) {
-            free_list_count++; // increment count of free list blocks
-            size_t block_size = get_size(f_block);
-            bool is_16 = get_is_16(f_block);
 
-            // Check that the free list block is actually free
-            if(get_alloc(f_block)) {
-                printf(BOLD RED"Allocated Block (addr: %p) in Seg List Invariant"
-                               " Broken at line %d with heap:\n"RESET, f_block, line);
-                print_heap();
-                print_seg_lists();
-                return false; // INVARIANT 2
-            }
 
-            block_t *next = is_16 ? get_next_squished(f_block) : f_block->next;
-            block_t *next_prev = NULL;
-            if(next) {
-                next_prev = get_is_16(next) ? get_prev_squished(next) : next->prev;
-            }
+     // Check that the number of free blocks in the heap
+     // is equal to the number of free blocks in the free list.
+    if (free_list_count != heap_count) {
+        printf(BOLD RED"Free Lists Doesn't Have All Free Blocks Invariant failed at line %d with heap:\n"RESET, line);
+        print_heap();
+        return false; // INVARIANT 4
+    }
 
-            // Check that the free list is doubly linked
-            if(next != NULL && next_prev != f_block) {
-                printf(BOLD RED"Seg List (index: %d) Not Doubly Linked Invariant"
-                               " Broken at line %d with heap:\n"RESET, list_index, line);
-                print_heap();
-                return false; // INVARIANT 3
-            }
 
-            // Check that all blocks are in the correct Seg List
-            if(!(block_size >= seg_list_sizes[list_index]
-                && (list_index+1 == seg_list_count || block_size < seg_list_sizes[list_index+1]))) {
-                printf(BOLD RED"Block in Wrong Seg List Invariant Broken at line %d with heap:\n"RESET, line);
-                print_heap();
-                print_seg_lists();
-                return false; // INVARIANT 8
-            }
+    return true;
+}
 
-            const int too_large_number = 1000000000;
-            if(free_list_count > too_large_number) {
-                printf(BOLD RED"Free Lists in an Infinite Loop at line %d with heap:\n"RESET, line);
-                print_heap();
-                return false; // INVARIANT 5
-            }
+/**
+ * @brief checks only the blocks and seg lists changed since the last check.
+ *        Every block whose header was written is checked against the blocks
+ *        on either side of it, and every seg list that was inserted into or
+ *        removed from is walked.  Invariant 4 needs the whole heap, so it is
+ *        left to the next full mm_checkheap.  Falls back to a full check
+ *        after mm_init or when too many blocks were changed to remember.
+ *
+ * @param line the line number of the caller
+ *
+ * @return true if no invariants are violated, false otherwise
+ *
+ * @Changelog
+ * - Added for incremental heap checking.
+ */
+bool mm_checkheap_incremental(int line)
+{
+    if(dirty_overflow) {
+        return mm_checkheap(line);
+    }
 
-            f_block = next;
+    // sort the dirty blocks by address (there are only a handful)
+    for(size_t i = 1; i < dirty_count; i++) {
+        block_t *b = dirty_blocks[i];
+        size_t j = i;
+        for(; j > 0 && dirty_blocks[j-1] > b; j--) {
+            dirty_blocks[j] = dirty_blocks[j-1];
         }
+        dirty_blocks[j] = b;
     }
 
+    // A dirty block that has since been coalesced away lies inside the block
+    // that absorbed it, which was written later and so is dirty too.  Skipping
+    // the dirty blocks inside the last block checked leaves only real blocks.
+    int heap_count = 0;
+    block_t *checked_end = NULL;
+    for(size_t i = 0; i < dirty_count; i++) {
+        block_t *b = dirty_blocks[i];
+        if(b < checked_end || get_size(b) == 0) {
+            continue;
+        }
 
+        // a free block before this one must end right where this one starts
+        if(!get_prev_alloc(b)) {
+            block_t *prev = find_prev(b);
+            if(get_alloc(prev) || find_next(prev) != b) {
+                printf(BOLD RED"Incorrect Prev Alloc Bit Invariant Broken at line %d with heap:\n"RESET, line);
+                print_heap();
+                return false; // INVARIANT 7
+            }
+        }
 
-     // Check that the number of free blocks in the heap
-     // is equal to the number of free blocks in the free list.
-    if (free_list_count != heap_count) {
-        printf(BOLD RED"Free Lists Doesn't Have All Free Blocks Invariant failed at line %d with heap:\n"RESET, line);
-        print_heap();
-        return false; // INVARIANT 4
+        if(!check_block(b, line, &heap_count)) {
+            return false;
+        }
+        checked_end = find_next(b);
     }
 
+    int free_list_count = 0;
+    for(int list_index = 0; list_index < seg_list_count; list_index++) {
+        if((dirty_lists & ((word_t) 1 << list_index))
+                && !check_seg_list(list_index, line, &free_list_count)) {
+            return false;
+        }
+    }
 
+    clear_dirty();
     return true;
 }
 
@@ -1327,4 +2474,40 @@ bool print_seg_lists() {
     printf(BOLD"------------------------------------------------------------\n\n"RESET);
 
     return true; // return true to allow for use in dbg macros
-}
\ No newline at end of file
+}
+
+/**
+ * @brief reports the free space in the heap for the driver's fragmentation
+ *        time series.
+ *
+ * @param class_size filled with the smallest block size of each seg list
+ * @param free_bytes filled with the free bytes in each seg list
+ * @param max_classes the number of entries in class_size and free_bytes
+ * @param largest set to the size of the largest free block
+ *
+ * @return the number of classes filled in
+ *
+ * @Changelog
+ * - Added for fragmentation reporting.
+ */
+size_t mm_free_stats(size_t *class_size, size_t *free_bytes, size_t max_classes, size_t *largest) {
+    size_t count = (size_t) seg_list_count < max_classes ? (size_t) seg_list_count : max_classes;
+    for(size_t i = 0; i < count; i++) {
+        class_size[i] = seg_list_sizes[i];
+        free_bytes[i] = 0;
+    }
+    *largest = 0;
+
+    for(block_t *b = heap_start; get_size(b) != 0; b = find_next(b)) {
+        if(get_alloc(b)) {
+            continue;
+        }
+        size_t bytes = get_size(b);
+        size_t index = find_seg_list_index(bytes);
+        *largest = max(*largest, bytes);
+        if(index < count) {
+            free_bytes[index] += bytes;
+        }
+    }
+    return count;
+}
@@ -0,0 +1,240 @@
+/*
+ * mmbench.c - Microbenchmarks of an allocator's internal functions
+ *
+ * mdriver times whole traces, which says how fast an allocator is but
+ * not which of its functions a change sped up.  mmbench includes the
+ * allocator's source (MM_SOURCE, set by the Makefile) so that it can
+ * call the static helpers directly.  For each benchmark it builds a
+ * heap in a known state and times one helper alone with fsec_prep,
+ * which rebuilds that heap, untimed, before each timed call:
+ *
+ *   find_fit/<L>     find_fit past L free blocks of its seg list that
+ *                    are too small, to a free block in the last list
+ *   coalesce/<c>     coalesce in case c: 1 no neighbor is free, 2 the
+ *                    next one is, 3 the previous one is, 4 both are
+ *   place_in_slab    placing slabs, including each new slab block
+ *   free_from_slab   freeing them again in the order they were placed
+ *   extend_heap      growing the heap by chunksize onto the free block
+ *                    at its end
+ *
+ * The slab benchmarks are only built for mm_slabs.c (BENCH_SLABS).
+ * Each result is the time of one call in nanoseconds.  Name benchmarks
+ * on the command line to run only those whose names start with them:
+ *
+ *   unix> ./mmbench-slabs find_fit coalesce/4
+ */
+#include MM_SOURCE
+
+#include "fcyc.h"
+
+/* Most helper calls a benchmark times at once */
+#define MAX_CALLS 2048
+
+/* Request sizes: free blocks find_fit skips, and the blocks coalesced */
+#define FIT_SMALL_SIZE 260
+#define FIT_BIG_SIZE 8000
+#define COALESCE_SIZE 100
+
+/* A benchmark: prep builds the heap, run makes calls calls of the helper */
+typedef struct {
+    const char *name;
+    test_funct prep;
+    test_funct run;
+    size_t param;            /* find_fit: blocks to skip; coalesce: case */
+    size_t calls;
+} bench_t;
+
+static block_t *blocks[MAX_CALLS];  /* blocks the helper is called on */
+static block_t *prev_blocks[MAX_CALLS]; /* the blocks before them, for coalesce */
+#ifdef BENCH_SLABS
+static void *payloads[MAX_CALLS];   /* slabs the helper is called on */
+#endif
+static volatile size_t fit_asize;   /* request find_fit is timed with */
+static volatile uintptr_t sink;     /* keeps results from being optimized out */
+
+static void bench_error(const char *msg) {
+    fprintf(stderr, "mmbench: %s\n", msg);
+    exit(1);
+}
+
+/* Start over with an empty heap */
+static void reset_heap(void) {
+    mem_reset_brk();
+    if (!mm_init())
+        bench_error("mm_init failed");
+}
+
+static block_t *new_block(size_t size) {
+    void *bp = mm_malloc(size);
+    if (bp == NULL)
+        bench_error("mm_malloc failed");
+    return payload_to_header(bp);
+}
+
+static void prep_heap(void *arg) {
+    reset_heap();
+}
+
+/*
+ * prep_find_fit - Free param blocks with guards between them, which all
+ *     land in one seg list, and ask for the largest size of that list
+ *     so that none of them fit.  The only block that does is the big
+ *     free block at the end of the heap.
+ */
+static void prep_find_fit(void *arg) {
+    bench_t *b = arg;
+    size_t i;
+
+    reset_heap();
+    block_t *probe = new_block(FIT_SMALL_SIZE);
+    size_t asize = get_size(probe);
+    size_t list_index = find_seg_list_index(asize);
+    while ((size_t) find_seg_list_index(asize + dsize) == list_index)
+        asize += dsize;
+    if (asize == get_size(probe))
+        bench_error("find_fit request fits the blocks it should skip");
+    fit_asize = asize;
+
+    for (i = 0; i < b->param; i++) {
+        blocks[i] = new_block(FIT_SMALL_SIZE);
+        new_block(FIT_SMALL_SIZE); /* guard */
+    }
+    block_t *big = new_block(FIT_BIG_SIZE);
+    for (i = 0; i < b->param; i++)
+        mm_free(header_to_payload(blocks[i]));
+    mm_free(header_to_payload(big));
+}
+
+static void run_find_fit(void *arg) {
+    bench_t *b = arg;
+    size_t i;
+
+    for (i = 0; i < b->calls; i++)
+        sink += (uintptr_t) find_fit(fit_asize);
+}
+
+/*
+ * prep_coalesce - Lay out the heap as runs of four adjacent blocks,
+ *     prev, block, next and a guard, then free prev and next as the
+ *     case (param) asks.  Each block is then coalesced in turn.
+ */
+static void prep_coalesce(void *arg) {
+    bench_t *b = arg;
+    size_t i;
+
+    reset_heap();
+    for (i = 0; i < b->calls; i++) {
+        prev_blocks[i] = new_block(COALESCE_SIZE);
+        blocks[i] = new_block(COALESCE_SIZE);
+        block_t *next = new_block(COALESCE_SIZE);
+        new_block(COALESCE_SIZE); /* guard */
+        if (find_next(prev_blocks[i]) != blocks[i] || find_next(blocks[i]) != next)
+            bench_error("coalesce blocks are not adjacent");
+    }
+    /*
+     * Only free once all are placed, so none of them reuse the space.
+     * Allocated blocks may have no footer, so find_prev can't be used.
+     */
+    for (i = 0; i < b->calls; i++) {
+        if (b->param == 2 || b->param == 4)
+            mm_free(header_to_payload(find_next(blocks[i])));
+        if (b->param == 3 || b->param == 4)
+            mm_free(header_to_payload(prev_blocks[i]));
+    }
+}
+
+static void run_coalesce(void *arg) {
+    bench_t *b = arg;
+    size_t i;
+
+    for (i = 0; i < b->calls; i++)
+        sink += (uintptr_t) coalesce(blocks[i]);
+}
+
+#ifdef BENCH_SLABS
+static void run_place_in_slab(void *arg) {
+    bench_t *b = arg;
+    size_t i;
+
+    for (i = 0; i < b->calls; i++)
+        payloads[i] = place_in_slab();
+}
+
+static void prep_free_from_slab(void *arg) {
+    reset_heap();
+    run_place_in_slab(arg);
+}
+
+static void run_free_from_slab(void *arg) {
+    bench_t *b = arg;
+    size_t i;
+
+    for (i = 0; i < b->calls; i++)
+        sink += (uintptr_t) free_from_slab(payloads[i]);
+}
+#endif /* BENCH_SLABS */
+
+static void run_extend_heap(void *arg) {
+    bench_t *b = arg;
+    size_t i;
+
+    for (i = 0; i < b->calls; i++)
+        sink += (uintptr_t) extend_heap(chunksize);
+}
+
+static bench_t benches[] = {
+    {"find_fit/0", prep_find_fit, run_find_fit, 0, 1000},
+    {"find_fit/4", prep_find_fit, run_find_fit, 4, 1000},
+    {"find_fit/16", prep_find_fit, run_find_fit, 16, 1000},
+    {"find_fit/64", prep_find_fit, run_find_fit, 64, 1000},
+    {"find_fit/256", prep_find_fit, run_find_fit, 256, 1000},
+    {"coalesce/1", prep_coalesce, run_coalesce, 1, 1024},
+    {"coalesce/2", prep_coalesce, run_coalesce, 2, 1024},
+    {"coalesce/3", prep_coalesce, run_coalesce, 3, 1024},
+    {"coalesce/4", prep_coalesce, run_coalesce, 4, 1024},
+#ifdef BENCH_SLABS
+    {"place_in_slab", prep_heap, run_place_in_slab, 0, 32 * num_slabs},
+    {"free_from_slab", prep_free_from_slab, run_free_from_slab, 0, 32 * num_slabs},
+#endif
+    {"extend_heap", prep_heap, run_extend_heap, 0, 256},
+};
+
+/* Whether the benchmark was named on the command line, or none were */
+static bool selected(const char *name, int argc, char **argv) {
+    int i;
+
+    if (argc == 1)
+        return true;
+    for (i = 1; i < argc; i++) {
+        if (strncmp(name, argv[i], strlen(argv[i])) == 0)
+            return true;
+    }
+    return false;
+}
+
+int main(int argc, char **argv)
+{
+    size_t i;
+
+    if (argc > 1 && strcmp(argv[1], "-h") == 0) {
+        fprintf(stderr, "Usage: %s [benchmark]...\n", argv[0]);
+        fprintf(stderr, "Runs the benchmarks whose names start with the ones given, or all:\n");
+        for (i = 0; i < sizeof(benches) / sizeof(benches[0]); i++)
+            fprintf(stderr, "\t%s\n", benches[i].name);
+        exit(0);
+    }
+
+    mem_init();
+    printf("%s\n%-16s %10s\n", MM_SOURCE, "benchmark", "ns/call");
+    for (i = 0; i < sizeof(benches) / sizeof(benches[0]); i++) {
+        bench_t *b = &benches[i];
+        if (!selected(b->name, argc, argv))
+            continue;
+        if (b->calls > MAX_CALLS)
+            bench_error("too many calls for one benchmark");
+        double secs = fsec_prep(b->prep, b->run, b);
+        printf("%-16s %10.2f\n", b->name, secs * 1e9 / b->calls);
+    }
+    mem_deinit();
+    return 0;
+}
@@ -0,0 +1,380 @@
+/*
+ * rec2rep.c - Convert a raw allocation recording made by libtracerec.so
+ * into a .rep trace file that the driver can replay.
+ *
+ * The records are sorted into their global order, every allocation is
+ * given the next dense id (0, 1, 2, ...), and frees and reallocs are
+ * mapped back to the id of the block they refer to.  Requests that
+ * cannot be replayed are dropped: frees of blocks allocated before the
+ * recording started, and zero-byte mallocs (mm_malloc(0) returns NULL).
+ * The header is computed from the requests that are kept.
+ *
+ * A realloc that moved its block is written out where its REC_REALLOC
+ * falls, which is when the old block was released, but its new block is
+ * only entered in the table of live blocks at its REC_MOVED, once it was
+ * obtained, in case another thread freed that address in between.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <getopt.h>
+
+#include "tracerec.h"
+
+/* An entry in the table of live blocks, keyed by address */
+typedef struct {
+    uint64_t ptr;            /* 0 if the slot is empty */
+    long id;
+    uint64_t size;
+} live_t;
+
+/* Open-addressing hash table of live blocks */
+typedef struct {
+    live_t *slots;
+    size_t mask;             /* capacity - 1 (capacity is a power of 2) */
+    size_t count;
+} table_t;
+
+/* Counts gathered during conversion */
+typedef struct {
+    long num_ids;
+    long num_ops;
+    uint64_t live_bytes;
+    uint64_t max_bytes;
+    long dropped;            /* requests that could not be replayed */
+    long races;              /* blocks reused before their free was seen */
+} cstats_t;
+
+static void usage(char *prog);
+static void app_error(const char *fmt, ...)
+    __attribute__((format(printf, 1,2), noreturn));
+
+/*****************************************************************
+ * Table of live blocks
+ ****************************************************************/
+
+static size_t hash_ptr(uint64_t ptr) {
+    ptr ^= ptr >> 33;
+    ptr *= 0xff51afd7ed558ccdull;
+    ptr ^= ptr >> 33;
+    return (size_t) ptr;
+}
+
+static void table_init(table_t *t, size_t capacity) {
+    t->slots = calloc(capacity, sizeof(live_t));
+    if (t->slots == NULL)
+        app_error("calloc failed in table_init\n");
+    t->mask = capacity - 1;
+    t->count = 0;
+}
+
+static live_t *table_find(table_t *t, uint64_t ptr) {
+    size_t i = hash_ptr(ptr) & t->mask;
+    while (t->slots[i].ptr != 0) {
+        if (t->slots[i].ptr == ptr)
+            return &t->slots[i];
+        i = (i + 1) & t->mask;
+    }
+    return NULL;
+}
+
+static void table_insert(table_t *t, uint64_t ptr, long id, uint64_t size);
+
+static void table_grow(table_t *t) {
+    table_t old = *t;
+    table_init(t, 2 * (old.mask + 1));
+    for (size_t i = 0; i <= old.mask; i++)
+        if (old.slots[i].ptr != 0)
+            table_insert(t, old.slots[i].ptr, old.slots[i].id, old.slots[i].size);
+    free(old.slots);
+}
+
+static void table_insert(table_t *t, uint64_t ptr, long id, uint64_t size) {
+    if (2 * (t->count + 1) > t->mask + 1)
+        table_grow(t);
+    size_t i = hash_ptr(ptr) & t->mask;
+    while (t->slots[i].ptr != 0)
+        i = (i + 1) & t->mask;
+    t->slots[i].ptr = ptr;
+    t->slots[i].id = id;
+    t->slots[i].size = size;
+    t->count++;
+}
+
+/* Remove an entry, shifting later entries back to keep probe chains intact */
+static void table_remove(table_t *t, live_t *e) {
+    size_t i = e - t->slots;
+    size_t j = i;
+    for (;;) {
+        j = (j + 1) & t->mask;
+        if (t->slots[j].ptr == 0)
+            break;
+        size_t home = hash_ptr(t->slots[j].ptr) & t->mask;
+        /* Can slot j move back to i without passing its home slot? */
+        if ((j > i && (home <= i || home > j)) ||
+            (j < i && (home <= i && home > j))) {
+            t->slots[i] = t->slots[j];
+            i = j;
+        }
+    }
+    t->slots[i].ptr = 0;
+    t->count--;
+}
+
+/*****************************************************************
+ * Conversion
+ ****************************************************************/
+
+static rec_t *read_recording(const char *name, size_t *count) {
+    FILE *f = fopen(name, "rb");
+    char magic[REC_MAGIC_LEN];
+    size_t capacity = 1 << 16;
+    size_t n = 0;
+    rec_t *recs;
+
+    if (f == NULL)
+        app_error("Could not open %s\n", name);
+    if (fread(magic, 1, REC_MAGIC_LEN, f) != REC_MAGIC_LEN ||
+        memcmp(magic, REC_MAGIC, REC_MAGIC_LEN) != 0)
+        app_error("%s is not a tracerec recording\n", name);
+
+    if ((recs = malloc(capacity * sizeof(rec_t))) == NULL)
+        app_error("malloc failed in read_recording\n");
+    for (;;) {
+        if (n == capacity) {
+            capacity *= 2;
+            if ((recs = realloc(recs, capacity * sizeof(rec_t))) == NULL)
+                app_error("realloc failed in read_recording\n");
+        }
+        size_t got = fread(recs + n, sizeof(rec_t), capacity - n, f);
+        n += got;
+        if (got == 0)
+            break;
+    }
+    fclose(f);
+    *count = n;
+    return recs;
+}
+
+static int cmp_seq(const void *a, const void *b) {
+    uint64_t x = ((const rec_t *) a)->seq;
+    uint64_t y = ((const rec_t *) b)->seq;
+    return (x > y) - (x < y);
+}
+
+static void emit(FILE *out, cstats_t *st, char type, long id, uint64_t size) {
+    st->num_ops++;
+    if (out == NULL)
+        return;
+    if (type == 'f')
+        fprintf(out, "f %ld\n", id);
+    else
+        fprintf(out, "%c %ld %lu\n", type, id, (unsigned long) size);
+}
+
+static void release(FILE *out, cstats_t *st, table_t *live, live_t *e) {
+    emit(out, st, 'f', e->id, 0);
+    st->live_bytes -= e->size;
+    table_remove(live, e);
+}
+
+static void acquire(FILE *out, cstats_t *st, table_t *live, uint64_t ptr, uint64_t size) {
+    live_t *e = table_find(live, ptr);
+    if (e) {
+        /* Another thread reused the block before we saw its free */
+        st->races++;
+        release(out, st, live, e);
+    }
+    long id = st->num_ids++;
+    emit(out, st, 'a', id, size);
+    table_insert(live, ptr, id, size);
+    st->live_bytes += size;
+    if (st->live_bytes > st->max_bytes)
+        st->max_bytes = st->live_bytes;
+}
+
+/* Free every block left in a table, as if the program had at exit */
+static void free_all(FILE *out, cstats_t *st, table_t *t) {
+    for (size_t i = 0; i <= t->mask; i++) {
+        if (t->slots[i].ptr != 0) {
+            emit(out, st, 'f', t->slots[i].id, 0);
+            st->live_bytes -= t->slots[i].size;
+        }
+    }
+}
+
+/*
+ * convert - Replay the sorted records once, writing requests to out
+ *     (or only counting them if out is NULL).
+ */
+static void convert(const rec_t *recs, size_t n, FILE *out, bool free_leaks,
+                    cstats_t *st) {
+    table_t live;
+    table_t moving;          /* reallocs between REC_REALLOC and REC_MOVED,
+                                keyed by the REC_REALLOC's seq + 1 */
+    table_init(&live, 1 << 12);
+    table_init(&moving, 1 << 6);
+    memset(st, 0, sizeof(*st));
+
+    for (size_t i = 0; i < n; i++) {
+        const rec_t *r = &recs[i];
+        live_t *e;
+        long id;
+        switch (r->op) {
+        case REC_MALLOC:
+        case REC_CALLOC:
+            if (r->size == 0) {
+                st->dropped++;
+                break;
+            }
+            acquire(out, st, &live, r->ptr, r->size);
+            break;
+
+        case REC_REALLOC:
+            e = table_find(&live, r->old);
+            if (e == NULL) {
+                /* Block from before the recording: treat as a malloc,
+                   at its REC_MOVED if it has one */
+                st->dropped++;
+                if (r->ptr == r->old)
+                    acquire(out, st, &live, r->ptr, r->size);
+                break;
+            }
+            emit(out, st, 'r', e->id, r->size);
+            id = e->id;
+            st->live_bytes += r->size - e->size;
+            table_remove(&live, e);
+            if (r->ptr == r->old)
+                table_insert(&live, r->ptr, id, r->size);
+            else
+                table_insert(&moving, r->seq + 1, id, r->size);
+            if (st->live_bytes > st->max_bytes)
+                st->max_bytes = st->live_bytes;
+            break;
+
+        case REC_MOVED:
+            e = table_find(&moving, r->old + 1);
+            if (e == NULL) {
+                acquire(out, st, &live, r->ptr, r->size);
+                break;
+            }
+            id = e->id;
+            table_remove(&moving, e);
+            e = table_find(&live, r->ptr);
+            if (e) {
+                /* Another thread reused the block before we saw its free */
+                st->races++;
+                release(out, st, &live, e);
+            }
+            table_insert(&live, r->ptr, id, r->size);
+            break;
+
+        case REC_FREE:
+            e = table_find(&live, r->ptr);
+            if (e == NULL) {
+                st->dropped++;
+                break;
+            }
+            release(out, st, &live, e);
+            break;
+
+        default:
+            app_error("Bogus record type %u\n", r->op);
+        }
+    }
+
+    if (free_leaks) {
+        free_all(out, st, &live);
+        free_all(out, st, &moving);  /* whose REC_MOVED was lost */
+    }
+    free(live.slots);
+    free(moving.slots);
+}
+
+int main(int argc, char **argv)
+{
+    char *outname = NULL;
+    bool free_leaks = true;
+    int weight = 1;
+    size_t n;
+    cstats_t st;
+    int c;
+
+    while ((c = getopt(argc, argv, "o:w:kh")) != EOF) {
+        switch (c) {
+        case 'o':
+            outname = optarg;
+            break;
+        case 'w':
+            weight = atoi(optarg);
+            if (weight < 0 || weight > 3)
+                app_error("weight can only be in {0, 1, 2, 3}\n");
+            break;
+        case 'k':
+            free_leaks = false;
+            break;
+        case 'h':
+            usage(argv[0]);
+            exit(0);
+        default:
+            usage(argv[0]);
+            exit(1);
+        }
+    }
+    if (optind != argc - 1) {
+        usage(argv[0]);
+        exit(1);
+    }
+
+    rec_t *recs = read_recording(argv[optind], &n);
+    qsort(recs, n, sizeof(rec_t), cmp_seq);
+
+    /* Pass 1: compute the header */
+    convert(recs, n, NULL, free_leaks, &st);
+    if (st.num_ids == 0)
+        app_error("%s contains no replayable allocations\n", argv[optind]);
+
+    /* Pass 2: write the trace */
+    FILE *out = stdout;
+    if (outname && (out = fopen(outname, "w")) == NULL)
+        app_error("Could not open %s for writing\n", outname);
+    fprintf(out, "%d\n%ld\n%ld\n%lu\n", weight, st.num_ids, st.num_ops,
+            (unsigned long) st.max_bytes);
+    convert(recs, n, out, free_leaks, &st);
+    if (out != stdout)
+        fclose(out);
+
+    fprintf(stderr, "%zu records: %ld ids, %ld ops, %lu peak bytes, "
+            "%ld dropped, %ld races\n", n, st.num_ids, st.num_ops,
+            (unsigned long) st.max_bytes, st.dropped, st.races);
+    free(recs);
+    return 0;
+}
+
+/*
+ * app_error - Report an arbitrary application error
+ */
+static void app_error(const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+    exit(1);
+}
+
+/*
+ * usage - Explain the command line arguments
+ */
+static void usage(char *prog)
+{
+    fprintf(stderr, "Usage: %s [-hk] [-w <weight>] [-o <file>] <recording>\n", prog);
+    fprintf(stderr, "Options\n");
+    fprintf(stderr, "\t-o <file>  Write the trace to <file> instead of stdout.\n");
+    fprintf(stderr, "\t-w <w>     Trace weight written to the header (default 1).\n");
+    fprintf(stderr, "\t-k         Keep blocks leaked by the program live at the end\n"
+                    "\t           (by default they are freed).\n");
+    fprintf(stderr, "\t-h         Print this message.\n");
+}
@@ -0,0 +1,177 @@
+/*
+ * Shadow bitmap of the simulated heap
+ *
+ * Bit g of the map covers heap bytes [base + g*ALIGNMENT,
+ * base + (g+1)*ALIGNMENT).  The bits live in pages of SH_PAGE_WORDS
+ * words, and a page that was never written is NULL and reads as all
+ * clear.  A range is tested and updated a page at a time: the partial
+ * words at either end through a mask, and the whole words in between
+ * in bulk.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "config.h"
+#include "shadow.h"
+
+#if defined(__x86_64__)
+#include <emmintrin.h>
+#endif
+
+/* Words in each page of the bitmap (4KB, covering 512KB of heap) */
+#define SH_PAGE_WORDS 512
+#define SH_PAGE_BITS (SH_PAGE_WORDS * 64)
+
+struct shadow {
+    uintptr_t base;         /* heap address of bit 0 */
+    size_t npages;
+    uint64_t **pages;       /* NULL until a bit in the page is set */
+    size_t live_bytes;
+};
+
+static int first_set_word(const uint64_t *words, size_t w0, size_t w1);
+
+shadow_t *shadow_new(const void *base, size_t size) {
+    shadow_t *sh = malloc(sizeof(shadow_t));
+    size_t nbits = (size + ALIGNMENT - 1) / ALIGNMENT;
+    if (sh) {
+        sh->base = (uintptr_t) base;
+        sh->npages = (nbits + SH_PAGE_BITS - 1) / SH_PAGE_BITS;
+        sh->pages = calloc(sh->npages, sizeof(uint64_t *));
+        sh->live_bytes = 0;
+    }
+    if (!sh || !sh->pages) {
+        fprintf(stderr, "ERROR.  Couldn't create shadow map\n");
+        exit(1);
+    }
+    return sh;
+}
+
+void shadow_free(shadow_t *sh) {
+    for (size_t p = 0; p < sh->npages; p++)
+        free(sh->pages[p]);
+    free(sh->pages);
+    free(sh);
+}
+
+void shadow_reset(shadow_t *sh) {
+    for (size_t p = 0; p < sh->npages; p++)
+        if (sh->pages[p])
+            memset(sh->pages[p], 0, SH_PAGE_WORDS * sizeof(uint64_t));
+    sh->live_bytes = 0;
+}
+
+/* Mask of bits [b0, b1) of a word, for 0 <= b0 < b1 <= 64 */
+static uint64_t bit_mask(size_t b0, size_t b1) {
+    uint64_t hi = (b1 == 64) ? ~(uint64_t) 0 : (((uint64_t) 1 << b1) - 1);
+    return hi & ~(((uint64_t) 1 << b0) - 1);
+}
+
+void *shadow_first_live(const shadow_t *sh, const void *lo, size_t size) {
+    size_t g = ((uintptr_t) lo - sh->base) / ALIGNMENT;
+    size_t end = g + (size + ALIGNMENT - 1) / ALIGNMENT;
+
+    while (g < end) {
+        size_t p = g / SH_PAGE_BITS;
+        size_t b0 = g % SH_PAGE_BITS;
+        size_t b1 = (end - p * SH_PAGE_BITS < SH_PAGE_BITS) ? end - p * SH_PAGE_BITS : SH_PAGE_BITS;
+        const uint64_t *words = sh->pages[p];
+        g = p * SH_PAGE_BITS + b1;
+        if (!words)
+            continue;
+
+        size_t w0 = b0 / 64, w1 = (b1 - 1) / 64;
+        uint64_t hit;
+        int w;
+        if (w0 == w1) {
+            hit = words[w0] & bit_mask(b0 % 64, (b1 - 1) % 64 + 1);
+            w = w0;
+        } else if ((hit = words[w0] & bit_mask(b0 % 64, 64)) != 0) {
+            w = w0;
+        } else if ((w = first_set_word(words, w0 + 1, w1)) >= 0) {
+            hit = words[w];
+        } else {
+            hit = words[w1] & bit_mask(0, (b1 - 1) % 64 + 1);
+            w = w1;
+        }
+        if (hit)
+            return (void *) (sh->base + ALIGNMENT *
+                             (p * SH_PAGE_BITS + w * 64 + __builtin_ctzll(hit)));
+    }
+    return NULL;
+}
+
+/* Set or clear the bits of a range */
+static void update(shadow_t *sh, const void *lo, size_t size, bool live) {
+    size_t g = ((uintptr_t) lo - sh->base) / ALIGNMENT;
+    size_t end = g + (size + ALIGNMENT - 1) / ALIGNMENT;
+
+    while (g < end) {
+        size_t p = g / SH_PAGE_BITS;
+        size_t b0 = g % SH_PAGE_BITS;
+        size_t b1 = (end - p * SH_PAGE_BITS < SH_PAGE_BITS) ? end - p * SH_PAGE_BITS : SH_PAGE_BITS;
+        g = p * SH_PAGE_BITS + b1;
+        if (!sh->pages[p]) {
+            if (!live)
+                continue;
+            sh->pages[p] = calloc(SH_PAGE_WORDS, sizeof(uint64_t));
+            if (!sh->pages[p]) {
+                fprintf(stderr, "ERROR.  Couldn't create shadow page\n");
+                exit(1);
+            }
+        }
+
+        uint64_t *words = sh->pages[p];
+        size_t w0 = b0 / 64, w1 = (b1 - 1) / 64;
+        uint64_t first = bit_mask(b0 % 64, (w0 == w1) ? (b1 - 1) % 64 + 1 : 64);
+        uint64_t last = bit_mask(0, (b1 - 1) % 64 + 1);
+        if (live) {
+            words[w0] |= first;
+            if (w1 > w0) {
+                memset(&words[w0 + 1], 0xff, (w1 - w0 - 1) * sizeof(uint64_t));
+                words[w1] |= last;
+            }
+        } else {
+            words[w0] &= ~first;
+            if (w1 > w0) {
+                memset(&words[w0 + 1], 0, (w1 - w0 - 1) * sizeof(uint64_t));
+                words[w1] &= ~last;
+            }
+        }
+    }
+}
+
+void shadow_mark(shadow_t *sh, const void *lo, size_t size) {
+    update(sh, lo, size, true);
+    sh->live_bytes += size;
+}
+
+void shadow_clear(shadow_t *sh, const void *lo, size_t size) {
+    update(sh, lo, size, false);
+    sh->live_bytes -= size;
+}
+
+size_t shadow_live_bytes(const shadow_t *sh) {
+    return sh->live_bytes;
+}
+
+/* Index of the first nonzero word in [w0, w1), or -1 if all are zero */
+static int first_set_word(const uint64_t *words, size_t w0, size_t w1) {
+    size_t w = w0;
+#if defined(__x86_64__)
+    /* Test two words (2KB of heap) at a time */
+    const __m128i zero = _mm_setzero_si128();
+    for (; w + 2 <= w1; w += 2) {
+        __m128i x = _mm_loadu_si128((const __m128i *) &words[w]);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(x, zero)) != 0xFFFF)
+            return words[w] ? (int) w : (int) w + 1;
+    }
+#endif
+    for (; w < w1; w++)
+        if (words[w])
+            return w;
+    return -1;
+}
@@ -0,0 +1,31 @@
+/*
+ * Shadow bitmap of the simulated heap, one bit per ALIGNMENT-byte
+ * granule, set while the granule holds part of a live payload.
+ *
+ * Used by the driver (-H) to find overlapping payloads without a tree
+ * lookup: a new payload overlaps another exactly when one of its
+ * granules is already set, since payloads start on granule boundaries.
+ * The bitmap is split into pages that are allocated the first time one
+ * of their bits is set, so a small heap costs only a few pages.
+ */
+
+typedef struct shadow shadow_t;
+
+/* Create a shadow map for the size bytes of heap starting at base */
+shadow_t *shadow_new(const void *base, size_t size);
+
+/* Free the map and all of its pages */
+void shadow_free(shadow_t *sh);
+
+/* Clear every bit, as at the start of a trace */
+void shadow_reset(shadow_t *sh);
+
+/* Address of the first live granule in [lo, lo+size), or NULL if none */
+void *shadow_first_live(const shadow_t *sh, const void *lo, size_t size);
+
+/* Mark the payload [lo, lo+size) live or free again */
+void shadow_mark(shadow_t *sh, const void *lo, size_t size);
+void shadow_clear(shadow_t *sh, const void *lo, size_t size);
+
+/* Total bytes of the payloads currently marked live */
+size_t shadow_live_bytes(const shadow_t *sh);
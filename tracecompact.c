@@ -0,0 +1,385 @@
+/*
+ * tracecompact.c - Rewrite a .rep trace with recycled block ids and
+ * report what the trace asks of an allocator.
+ *
+ * Trace files give every allocation its own id, so the driver's block
+ * tables grow with the total number of allocations.  This tool hands
+ * out ids the way an allocator hands out memory: each allocation gets
+ * the lowest id that is not live, and the id is released when the block
+ * is freed (or reallocated to size 0).  The rewritten trace replays the
+ * same requests, but its num_ids is the peak number of live blocks.
+ *
+ * The report covers request sizes, block lifetimes (in requests), the
+ * length of realloc chains and the peak number of live bytes and
+ * blocks, which is what is needed to tune size classes.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <string.h>
+#include <getopt.h>
+
+/* Number of histogram buckets: 0, 1, 2, 3-4, 5-8, ... */
+#define NBUCKETS 48
+
+/* What we know about one id of the input trace */
+typedef struct {
+    int slot;                /* id in the output trace, -1 if not live */
+    long birth;              /* op that allocated the block */
+    size_t size;             /* current payload size */
+    int reallocs;            /* reallocs since the block was allocated */
+} block_t;
+
+/* Min-heap of released output ids, so the lowest is reused first */
+typedef struct {
+    int *ids;
+    int count;
+    int capacity;
+} slots_t;
+
+/* Everything gathered in one pass over the trace */
+typedef struct {
+    int weight;
+    long num_ops;            /* requests in the input */
+    long num_ids;            /* ids in the input */
+    long allocs, reallocs, frees, null_frees;
+    long live;               /* live blocks */
+    long max_live;
+    size_t live_bytes;
+    size_t max_bytes;
+    long max_live_at;        /* op at which max_bytes was reached */
+    int num_slots;           /* output ids handed out so far */
+    long size_hist[NBUCKETS];
+    long life_hist[NBUCKETS];
+    long chain_hist[NBUCKETS];
+    long leaked;             /* blocks never freed */
+    long grows, shrinks;     /* reallocs that grow or shrink the block */
+    int max_chain;
+} tstats_t;
+
+static void usage(char *prog);
+static void app_error(const char *fmt, ...)
+    __attribute__((format(printf, 1,2), noreturn));
+
+/*****************************************************************
+ * Helpers
+ ****************************************************************/
+
+/* bucket - Index of the histogram bucket holding v */
+static int bucket(size_t v) {
+    int b = 1;
+    if (v == 0)
+        return 0;
+    while (v > 1 && b < NBUCKETS - 1) {
+        v = (v + 1) >> 1;
+        b++;
+    }
+    return b;
+}
+
+static void slots_push(slots_t *s, int id) {
+    if (s->count == s->capacity) {
+        s->capacity = s->capacity ? 2 * s->capacity : 1024;
+        if ((s->ids = realloc(s->ids, s->capacity * sizeof(int))) == NULL)
+            app_error("realloc failed in slots_push\n");
+    }
+    int i = s->count++;
+    while (i > 0 && s->ids[(i - 1) / 2] > id) {
+        s->ids[i] = s->ids[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    s->ids[i] = id;
+}
+
+static int slots_pop(slots_t *s) {
+    int top = s->ids[0];
+    int last = s->ids[--s->count];
+    int i = 0;
+    for (;;) {
+        int c = 2 * i + 1;
+        if (c >= s->count)
+            break;
+        if (c + 1 < s->count && s->ids[c + 1] < s->ids[c])
+            c++;
+        if (last <= s->ids[c])
+            break;
+        s->ids[i] = s->ids[c];
+        i = c;
+    }
+    if (s->count > 0)
+        s->ids[i] = last;
+    return top;
+}
+
+/* lookup - Find the record for id, growing the table if needed */
+static block_t *lookup(block_t **blocks, long *capacity, long id) {
+    if (id < 0)
+        app_error("Bad id %ld in trace\n", id);
+    if (id >= *capacity) {
+        long n = *capacity ? *capacity : 1024;
+        while (n <= id)
+            n *= 2;
+        if ((*blocks = realloc(*blocks, n * sizeof(block_t))) == NULL)
+            app_error("realloc failed in lookup\n");
+        for (long i = *capacity; i < n; i++)
+            (*blocks)[i].slot = -1;
+        *capacity = n;
+    }
+    return &(*blocks)[id];
+}
+
+/*****************************************************************
+ * Rewriting
+ ****************************************************************/
+
+static int acquire(tstats_t *st, slots_t *free_slots, block_t *b, long opnum) {
+    b->slot = free_slots->count > 0 ? slots_pop(free_slots) : st->num_slots++;
+    b->birth = opnum;
+    b->size = 0;
+    b->reallocs = 0;
+    st->live++;
+    if (st->live > st->max_live)
+        st->max_live = st->live;
+    return b->slot;
+}
+
+static int release(tstats_t *st, slots_t *free_slots, block_t *b, long opnum) {
+    int slot = b->slot;
+    st->life_hist[bucket(opnum - b->birth)]++;
+    st->chain_hist[bucket(b->reallocs)]++;
+    if (b->reallocs > st->max_chain)
+        st->max_chain = b->reallocs;
+    st->live--;
+    st->live_bytes -= b->size;
+    slots_push(free_slots, slot);
+    b->slot = -1;
+    return slot;
+}
+
+static void resize(tstats_t *st, block_t *b, size_t size, long opnum) {
+    st->live_bytes += size - b->size;
+    b->size = size;
+    if (st->live_bytes > st->max_bytes) {
+        st->max_bytes = st->live_bytes;
+        st->max_live_at = opnum;
+    }
+}
+
+/*
+ * compact - Read the trace once, gathering statistics and writing the
+ *     requests with recycled ids to out (unless out is NULL).  out_ids
+ *     is the num_ids written to the header, found by an earlier pass.
+ */
+static void compact(FILE *in, FILE *out, int out_ids, tstats_t *st) {
+    block_t *blocks = NULL;
+    long capacity = 0;
+    slots_t free_slots = {NULL, 0, 0};
+    long hdr_ids, hdr_ops;
+    size_t hdr_bytes;
+    char type[2];
+    long id;
+    size_t size;
+    long opnum;
+
+    memset(st, 0, sizeof(*st));
+    rewind(in);
+    if (fscanf(in, "%d %ld %ld %zu", &st->weight, &hdr_ids, &hdr_ops, &hdr_bytes) != 4)
+        app_error("Bad trace header\n");
+    if (out)
+        fprintf(out, "%d\n%d\n%ld\n%zu\n", st->weight, out_ids, hdr_ops, hdr_bytes);
+
+    for (opnum = 0; opnum < hdr_ops && fscanf(in, "%1s", type) == 1; opnum++) {
+        block_t *b;
+        int slot;
+        switch (type[0]) {
+        case 'a':
+            if (fscanf(in, "%ld %zu", &id, &size) != 2)
+                app_error("Bad request at op %ld\n", opnum);
+            b = lookup(&blocks, &capacity, id);
+            if (b->slot != -1)
+                app_error("op %ld: id %ld allocated twice\n", opnum, id);
+            st->num_ids = (id >= st->num_ids) ? id + 1 : st->num_ids;
+            slot = acquire(st, &free_slots, b, opnum);
+            resize(st, b, size, opnum);
+            st->allocs++;
+            st->size_hist[bucket(size)]++;
+            if (out)
+                fprintf(out, "a %d %zu\n", slot, size);
+            break;
+
+        case 'r':
+            if (fscanf(in, "%ld %zu", &id, &size) != 2)
+                app_error("Bad request at op %ld\n", opnum);
+            b = lookup(&blocks, &capacity, id);
+            st->num_ids = (id >= st->num_ids) ? id + 1 : st->num_ids;
+            if (b->slot == -1)
+                /* realloc(NULL, size) is a malloc */
+                acquire(st, &free_slots, b, opnum);
+            else if (size > b->size)
+                st->grows++;
+            else if (size < b->size)
+                st->shrinks++;
+            slot = b->slot;
+            b->reallocs++;
+            resize(st, b, size, opnum);
+            st->reallocs++;
+            st->size_hist[bucket(size)]++;
+            if (out)
+                fprintf(out, "r %d %zu\n", slot, size);
+            /* realloc to 0 frees the block */
+            if (size == 0)
+                release(st, &free_slots, b, opnum);
+            break;
+
+        case 'f':
+            if (fscanf(in, "%ld", &id) != 1)
+                app_error("Bad request at op %ld\n", opnum);
+            st->frees++;
+            b = (id == -1) ? NULL : lookup(&blocks, &capacity, id);
+            if (b == NULL || b->slot == -1) {
+                /* Freeing NULL, or a block already released by realloc */
+                st->null_frees++;
+                if (out)
+                    fprintf(out, "f -1\n");
+                break;
+            }
+            slot = release(st, &free_slots, b, opnum);
+            if (out)
+                fprintf(out, "f %d\n", slot);
+            break;
+
+        default:
+            app_error("Bogus type character (%c) at op %ld\n", type[0], opnum);
+        }
+    }
+    st->num_ops = opnum;
+
+    /* Blocks that were never freed */
+    for (long i = 0; i < capacity; i++) {
+        if (blocks[i].slot != -1) {
+            st->leaked++;
+            st->chain_hist[bucket(blocks[i].reallocs)]++;
+        }
+    }
+    free(blocks);
+    free(free_slots.ids);
+}
+
+/*****************************************************************
+ * Reporting
+ ****************************************************************/
+
+static void print_hist(const char *title, const char *unit, const long *hist) {
+    long total = 0;
+    int lo = NBUCKETS, hi = -1;
+    for (int b = 0; b < NBUCKETS; b++) {
+        total += hist[b];
+        if (hist[b]) {
+            lo = (b < lo) ? b : lo;
+            hi = b;
+        }
+    }
+    printf("\n%s\n", title);
+    if (total == 0) {
+        printf("  (none)\n");
+        return;
+    }
+    printf("  %27s %10s %7s %7s\n", unit, "count", "pct", "cum");
+    long cum = 0;
+    for (int b = lo; b <= hi; b++) {
+        cum += hist[b];
+        unsigned long top = (b == 0) ? 0 : 1ul << (b - 1);
+        unsigned long bottom = (b < 2) ? top : (1ul << (b - 2)) + 1;
+        printf("  %12lu - %-12lu %10ld %6.1f%% %6.1f%%\n", bottom, top, hist[b],
+               100.0 * hist[b] / total, 100.0 * cum / total);
+    }
+}
+
+static void report(const char *name, const tstats_t *st) {
+    printf("%s: weight %d, %ld ops, %ld ids\n", name, st->weight, st->num_ops, st->num_ids);
+    printf("  %ld mallocs, %ld reallocs (%ld grow, %ld shrink), %ld frees (%ld of NULL)\n",
+           st->allocs, st->reallocs, st->grows, st->shrinks, st->frees, st->null_frees);
+    printf("  peak live: %ld blocks, %zu bytes (at op %ld); %ld blocks never freed\n",
+           st->max_live, st->max_bytes, st->max_live_at, st->leaked);
+    printf("  recycled ids: %d (%.1f%% of the original %ld)\n", st->num_slots,
+           st->num_ids ? 100.0 * st->num_slots / st->num_ids : 0.0, st->num_ids);
+
+    print_hist("Request sizes (malloc and realloc)", "bytes", st->size_hist);
+    print_hist("Block lifetimes (freed blocks only)", "ops", st->life_hist);
+    print_hist("Reallocs per block", "reallocs", st->chain_hist);
+    printf("  longest chain: %d\n", st->max_chain);
+}
+
+int main(int argc, char **argv)
+{
+    char *outname = NULL;
+    bool quiet = false;
+    tstats_t st;
+    int c;
+
+    while ((c = getopt(argc, argv, "o:qh")) != EOF) {
+        switch (c) {
+        case 'o':
+            outname = optarg;
+            break;
+        case 'q':
+            quiet = true;
+            break;
+        case 'h':
+            usage(argv[0]);
+            exit(0);
+        default:
+            usage(argv[0]);
+            exit(1);
+        }
+    }
+    if (optind != argc - 1) {
+        usage(argv[0]);
+        exit(1);
+    }
+
+    FILE *in = fopen(argv[optind], "r");
+    if (in == NULL)
+        app_error("Could not open %s\n", argv[optind]);
+
+    /* Pass 1: count the ids the output needs */
+    compact(in, NULL, 0, &st);
+
+    /* Pass 2: write the trace */
+    if (outname) {
+        FILE *out = fopen(outname, "w");
+        if (out == NULL)
+            app_error("Could not open %s for writing\n", outname);
+        compact(in, out, st.num_slots, &st);
+        fclose(out);
+    }
+    fclose(in);
+
+    if (!quiet)
+        report(argv[optind], &st);
+    return 0;
+}
+
+/*
+ * app_error - Report an arbitrary application error
+ */
+static void app_error(const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+    exit(1);
+}
+
+/*
+ * usage - Explain the command line arguments
+ */
+static void usage(char *prog)
+{
+    fprintf(stderr, "Usage: %s [-hq] [-o <file>] <trace>\n", prog);
+    fprintf(stderr, "Options\n");
+    fprintf(stderr, "\t-o <file>  Write the trace with recycled ids to <file>.\n");
+    fprintf(stderr, "\t-q         Do not print the report.\n");
+    fprintf(stderr, "\t-h         Print this message.\n");
+}
@@ -0,0 +1,384 @@
+/*
+ * tracerec.c - LD_PRELOAD library that records the allocation requests
+ * of a running program.
+ *
+ * Usage:
+ *     unix> LD_PRELOAD=./libtracerec.so TRACEREC_FILE=prog.raw ./prog
+ *     unix> ./rec2rep -o prog.rep prog.raw
+ *
+ * Every call to malloc, calloc, realloc and free (and the aligned
+ * variants, which are recorded as plain mallocs) is appended to a
+ * buffer owned by the calling thread, so the hot path takes no locks.
+ * A global sequence number, taken with a single atomic add, orders the
+ * requests across threads.  Full buffers are pushed onto a lock-free
+ * stack and written out by a background thread, so the program never
+ * waits on the disk.
+ *
+ * Buffers still partially filled are written out when their thread
+ * exits and, for the main thread, when the program exits.  Threads that
+ * are still running at exit lose their last partial buffer.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <dlfcn.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#include "tracerec.h"
+
+/* Number of records in each per-thread buffer */
+#define RBUF_RECS (1 << 14)
+
+/* Size of the static pool used while dlsym itself allocates */
+#define BOOT_BYTES (1 << 14)
+
+/* How long the writer thread sleeps when there is nothing to write */
+#define WRITER_NAP_NS 1000000
+
+/* A per-thread buffer of records */
+typedef struct rbuf {
+    struct rbuf *next;       /* link in the stack of full buffers */
+    size_t count;            /* number of records in use */
+    rec_t recs[RBUF_RECS];
+} rbuf_t;
+
+/* The real allocator */
+static void *(*real_malloc)(size_t);
+static void (*real_free)(void *);
+static void *(*real_realloc)(void *, size_t);
+static void *(*real_calloc)(size_t, size_t);
+static int (*real_posix_memalign)(void **, size_t, size_t);
+static void *(*real_aligned_alloc)(size_t, size_t);
+static void *(*real_memalign)(size_t, size_t);
+
+/* Bootstrap pool for allocations made while resolving the real allocator */
+static char boot_pool[BOOT_BYTES] __attribute__((aligned(16)));
+static size_t boot_used;
+
+static int out_fd = -1;                  /* raw recording */
+static atomic_bool recording;            /* set between constructor and destructor */
+static atomic_uint_fast64_t next_seq;    /* global request order */
+static _Atomic(rbuf_t *) full_bufs;      /* lock-free stack of full buffers */
+static atomic_bool writer_started;
+static atomic_bool writer_stop;
+static pthread_t writer_tid;
+static pthread_key_t rbuf_key;           /* flushes a thread's buffer at exit */
+
+/* Thread's current buffer, and a guard against recording our own calls */
+static __thread rbuf_t *tbuf __attribute__((tls_model("initial-exec")));
+static __thread int in_hook __attribute__((tls_model("initial-exec")));
+
+/*********************
+ * Writing the records
+ *********************/
+
+static void write_all(const void *buf, size_t len) {
+    const char *p = buf;
+    while (len > 0) {
+        ssize_t n = write(out_fd, p, len);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return;
+        p += n;
+        len -= n;
+    }
+}
+
+static void write_rbuf(rbuf_t *b) {
+    write_all(b->recs, b->count * sizeof(rec_t));
+    munmap(b, sizeof(rbuf_t));
+}
+
+/*
+ * write_full_bufs - Take the whole stack of full buffers at once and
+ *     write them out, oldest first.
+ */
+static void write_full_bufs(void) {
+    rbuf_t *b = atomic_exchange(&full_bufs, NULL);
+    rbuf_t *rev = NULL;
+    while (b) {
+        rbuf_t *next = b->next;
+        b->next = rev;
+        rev = b;
+        b = next;
+    }
+    while (rev) {
+        rbuf_t *next = rev->next;
+        write_rbuf(rev);
+        rev = next;
+    }
+}
+
+static void *writer_main(void *arg) {
+    struct timespec nap = {0, WRITER_NAP_NS};
+    in_hook = 1;
+    while (!atomic_load(&writer_stop)) {
+        if (atomic_load(&full_bufs) == NULL)
+            nanosleep(&nap, NULL);
+        else
+            write_full_bufs();
+    }
+    return NULL;
+}
+
+static void push_full(rbuf_t *b) {
+    rbuf_t *head = atomic_load(&full_bufs);
+    do {
+        b->next = head;
+    } while (!atomic_compare_exchange_weak(&full_bufs, &head, b));
+
+    if (!atomic_exchange(&writer_started, true))
+        pthread_create(&writer_tid, NULL, writer_main, NULL);
+}
+
+/* Key destructor: hand a thread's partial buffer to the writer */
+static void flush_thread_buf(void *arg) {
+    rbuf_t *b = arg;
+    if (b && b->count > 0 && atomic_load(&recording)) {
+        in_hook++;
+        push_full(b);
+        in_hook--;
+    }
+    tbuf = NULL;
+}
+
+/*
+ * record - Append a request to the calling thread's buffer.  seq must
+ *     have been taken before a block is released and after a block is
+ *     obtained, so that a block is never reused before it is freed.
+ */
+static void record(uint64_t seq, rec_op_t op, void *ptr, void *old, size_t size) {
+    rbuf_t *b = tbuf;
+    if (b == NULL) {
+        b = mmap(NULL, sizeof(rbuf_t), PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (b == MAP_FAILED)
+            return;
+        b->count = 0;
+        tbuf = b;
+        pthread_setspecific(rbuf_key, b);
+    }
+    rec_t *r = &b->recs[b->count++];
+    r->seq = seq;
+    r->op = op;
+    r->ptr = (uint64_t) ptr;
+    r->old = (uint64_t) old;
+    r->size = size;
+    r->pad = 0;
+
+    if (b->count == RBUF_RECS) {
+        tbuf = NULL;
+        pthread_setspecific(rbuf_key, NULL);
+        push_full(b);
+    }
+}
+
+static uint64_t take_seq(void) {
+    return atomic_fetch_add_explicit(&next_seq, 1, memory_order_relaxed);
+}
+
+/* Should this call be recorded?  Also enters the recursion guard. */
+static bool enter_hook(void) {
+    if (in_hook || !atomic_load_explicit(&recording, memory_order_relaxed))
+        return false;
+    in_hook++;
+    return true;
+}
+
+static void leave_hook(void) {
+    in_hook--;
+}
+
+/*******************************
+ * Finding the real allocator
+ ******************************/
+
+static void *boot_alloc(size_t size) {
+    size = (size + 15) & ~(size_t) 15;
+    if (boot_used + size > BOOT_BYTES)
+        return NULL;
+    void *p = boot_pool + boot_used;
+    boot_used += size;
+    return p;
+}
+
+static bool is_boot(void *p) {
+    return (char *) p >= boot_pool && (char *) p < boot_pool + BOOT_BYTES;
+}
+
+static void resolve_real(void) {
+    static bool resolving = false;
+    if (real_malloc || resolving)
+        return;
+    resolving = true;
+    in_hook++;
+    real_calloc = dlsym(RTLD_NEXT, "calloc");
+    real_realloc = dlsym(RTLD_NEXT, "realloc");
+    real_free = dlsym(RTLD_NEXT, "free");
+    real_posix_memalign = dlsym(RTLD_NEXT, "posix_memalign");
+    real_aligned_alloc = dlsym(RTLD_NEXT, "aligned_alloc");
+    real_memalign = dlsym(RTLD_NEXT, "memalign");
+    real_malloc = dlsym(RTLD_NEXT, "malloc");
+    in_hook--;
+    resolving = false;
+}
+
+__attribute__((constructor))
+static void tracerec_init(void) {
+    char name[256];
+    const char *env = getenv(REC_FILE_ENV);
+
+    resolve_real();
+    if (env)
+        snprintf(name, sizeof(name), "%s", env);
+    else
+        snprintf(name, sizeof(name), REC_DEFAULT_FILE, (int) getpid());
+
+    out_fd = open(name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (out_fd < 0) {
+        fprintf(stderr, "tracerec: could not open %s: %s\n", name, strerror(errno));
+        return;
+    }
+    write_all(REC_MAGIC, REC_MAGIC_LEN);
+    pthread_key_create(&rbuf_key, flush_thread_buf);
+    atomic_store(&recording, true);
+}
+
+__attribute__((destructor))
+static void tracerec_fini(void) {
+    if (!atomic_load(&recording))
+        return;
+    in_hook++;
+    if (tbuf && tbuf->count > 0) {
+        rbuf_t *b = tbuf;
+        tbuf = NULL;
+        push_full(b);
+    }
+    atomic_store(&recording, false);
+    if (atomic_load(&writer_started)) {
+        atomic_store(&writer_stop, true);
+        pthread_join(writer_tid, NULL);
+    }
+    write_full_bufs();
+    close(out_fd);
+    in_hook--;
+}
+
+/***************************
+ * The interposed functions
+ **************************/
+
+void *malloc(size_t size) {
+    if (real_malloc == NULL) {
+        resolve_real();
+        if (real_malloc == NULL)
+            return boot_alloc(size);
+    }
+    void *p = real_malloc(size);
+    if (p && enter_hook()) {
+        record(take_seq(), REC_MALLOC, p, NULL, size);
+        leave_hook();
+    }
+    return p;
+}
+
+void *calloc(size_t nmemb, size_t size) {
+    if (size != 0 && nmemb > SIZE_MAX / size) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    if (real_calloc == NULL) {
+        resolve_real();
+        if (real_calloc == NULL)
+            return boot_alloc(nmemb * size);  /* static pool is already zero */
+    }
+    void *p = real_calloc(nmemb, size);
+    if (p && enter_hook()) {
+        record(take_seq(), REC_CALLOC, p, NULL, nmemb * size);
+        leave_hook();
+    }
+    return p;
+}
+
+void free(void *ptr) {
+    if (ptr == NULL || is_boot(ptr))
+        return;
+    if (enter_hook()) {
+        record(take_seq(), REC_FREE, ptr, NULL, 0);
+        leave_hook();
+    }
+    real_free(ptr);
+}
+
+void *realloc(void *ptr, size_t size) {
+    if (real_realloc == NULL)
+        resolve_real();
+    if (is_boot(ptr)) {
+        /* The pool doesn't keep sizes, so copy no further than its end */
+        size_t avail = boot_pool + boot_used - (char *) ptr;
+        void *p = malloc(size);
+        if (p)
+            memcpy(p, ptr, size < avail ? size : avail);
+        return p;
+    }
+    if (ptr == NULL)
+        return malloc(size);
+
+    /* The real realloc may release ptr, so its seq is taken first */
+    bool hooked = enter_hook();
+    uint64_t seq = hooked ? take_seq() : 0;
+    void *p = real_realloc(ptr, size);
+    if (hooked) {
+        if (p) {
+            record(seq, REC_REALLOC, p, ptr, size);
+            if (p != ptr)
+                record(take_seq(), REC_MOVED, p, (void *) (uintptr_t) seq, size);
+        } else if (size == 0) {
+            record(seq, REC_FREE, ptr, NULL, 0);
+        }
+        leave_hook();
+    }
+    return p;
+}
+
+int posix_memalign(void **memptr, size_t alignment, size_t size) {
+    if (real_posix_memalign == NULL)
+        resolve_real();
+    int err = real_posix_memalign(memptr, alignment, size);
+    if (err == 0 && enter_hook()) {
+        record(take_seq(), REC_MALLOC, *memptr, NULL, size);
+        leave_hook();
+    }
+    return err;
+}
+
+void *aligned_alloc(size_t alignment, size_t size) {
+    if (real_aligned_alloc == NULL)
+        resolve_real();
+    void *p = real_aligned_alloc(alignment, size);
+    if (p && enter_hook()) {
+        record(take_seq(), REC_MALLOC, p, NULL, size);
+        leave_hook();
+    }
+    return p;
+}
+
+void *memalign(size_t alignment, size_t size) {
+    if (real_memalign == NULL)
+        resolve_real();
+    void *p = real_memalign(alignment, size);
+    if (p && enter_hook()) {
+        record(take_seq(), REC_MALLOC, p, NULL, size);
+        leave_hook();
+    }
+    return p;
+}
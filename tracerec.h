@@ -0,0 +1,39 @@
+/*
+ * tracerec.h - Raw record format shared by the allocation recorder
+ * (tracerec.c, built as libtracerec.so) and its post-processor
+ * (rec2rep.c), which turns a raw recording into a .rep trace file.
+ */
+#include <stdint.h>
+
+/* Magic string at the start of every raw recording */
+#define REC_MAGIC "MMREC002"
+#define REC_MAGIC_LEN 8
+
+/* Default name of the raw recording; %d is replaced by the pid */
+#define REC_DEFAULT_FILE "tracerec.%d.raw"
+
+/* Environment variable that overrides the recording file name */
+#define REC_FILE_ENV "TRACEREC_FILE"
+
+/*
+ * Kinds of recorded requests.  A realloc that moves its block may free
+ * the old one before it has the new one, so it is recorded twice: as a
+ * REC_REALLOC with a seq taken before the old block is released, and as
+ * a REC_MOVED with a seq taken after the new block is obtained.
+ */
+typedef enum { REC_MALLOC, REC_FREE, REC_REALLOC, REC_CALLOC, REC_MOVED } rec_op_t;
+
+/*
+ * One recorded request.  seq gives the global order of requests across
+ * all threads; records are written in per-thread batches, so they must
+ * be sorted by seq before being replayed.
+ */
+typedef struct {
+    uint64_t seq;       /* global sequence number */
+    uint64_t ptr;       /* block returned (malloc/calloc/realloc) or freed */
+    uint64_t old;       /* block passed to realloc; for REC_MOVED, the
+                           seq of its REC_REALLOC */
+    uint64_t size;      /* requested size in bytes */
+    uint32_t op;        /* a rec_op_t */
+    uint32_t pad;
+} rec_t;